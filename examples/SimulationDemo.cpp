@@ -4,6 +4,7 @@
 #include <vector>
 #include "BouncebackNodes.hpp"
 #include "CollisionCD.hpp"
+#include "CollisionKBC.hpp"
 #include "CollisionNS.hpp"
 #include "CollisionNSF.hpp"
 #include "ImmersedBoundaryMethod.hpp"
@@ -59,7 +60,7 @@ TEST(SimulateDiffusion)
     , sp);
   for (auto t = 0u; t < 501; ++t) {
     g.TakeStep();
-    WriteResultsCmgui(g.df, nx, ny, t);
+    WriteResultsCmgui(g.df.GetNodes(), nx, ny, t);
   }
 }
 
@@ -87,7 +88,7 @@ TEST(SimulateConvectionDiffusion)
     , sp);
   for (auto t = 0u; t < 501; ++t) {
     g.TakeStep();
-    WriteResultsCmgui(g.df, nx, ny, t);
+    WriteResultsCmgui(g.df.GetNodes(), nx, ny, t);
   }
 }
 
@@ -567,6 +568,62 @@ TEST(SimulateLidDrivenCavityFlow)
   myfile.close();
 }
 
+TEST(SimulateLidDrivenCavityFlowKBC)
+{
+  // Reynolds number = velocity * length / viscosity
+  std::size_t ny = 256;
+  std::size_t nx = 256;
+  auto dt = 0.0001;
+  auto dx = sqrt(dt);
+  std::vector<double> u0 = {0.0, 0.0};
+  // lid speed high for the viscosity, Re is about 4000 and CollisionNS
+  // diverges within 2000 steps
+  auto k_visco = 0.02;
+  auto u_lid = 31.6;
+  auto v_lid = 0.0;
+  LatticeD2Q9 lm(ny
+    , nx
+    , dx
+    , dt
+    , u0);
+  StreamD2Q9 sd(lm);
+  // the entropic stabilizer keeps the under-resolved cavity bounded
+  CollisionKBC kbc(lm
+    , k_visco
+    , g_rho0_f);
+  BouncebackNodes bbkbc(lm
+    , &kbc);
+  ZouHeNodes zhkbc(lm
+    , kbc);
+  LatticeBoltzmann f(lm
+    , kbc
+    , sd);
+  for (auto y = 0u; y < ny; ++y) {
+    bbkbc.AddNode(0, y);
+    bbkbc.AddNode(nx - 1, y);
+  }
+  for (auto x = 0u; x < nx; ++x) {
+    bbkbc.AddNode(x, 0);
+    zhkbc.AddNode(x, ny - 1, u_lid, v_lid);
+  }
+  f.AddBoundaryNodes(&bbkbc);
+  f.AddBoundaryNodes(&zhkbc);
+  for (auto t = 0u; t < 64001; ++t) {
+    f.TakeStep();
+    if (t % 128 == 0) WriteResultsCmgui(lm.u, nx, ny, t / 128);
+    std::cout << t << std::endl;
+  }
+  std::ofstream myfile;
+  myfile.open("velocities_kbc.csv");
+  myfile << "u_y,u_x" << std::endl;
+  for (auto i = 0u; i < 256; ++i) {
+    auto y = 128 * nx + i;
+    auto x = i * nx + 128;
+    myfile << lm.u[y][1] << "," << lm.u[x][0] << std::endl;
+  }
+  myfile.close();
+}
+
 TEST(SimulateKarmanVortex)
 {
   auto pi = 3.14159265;
@@ -0,0 +1,75 @@
+#ifndef ALIGNED_ALLOCATOR_HPP_
+#define ALIGNED_ALLOCATOR_HPP_
+#include <cstdlib>  // posix_memalign, free
+#include <cstddef>
+#include <new>  // std::bad_alloc
+
+/**
+ * Allocator which returns memory aligned to a given boundary, used so that the
+ * distribution function planes start on a cache line and can be loaded with
+ * aligned vector instructions
+ */
+template <typename T, std::size_t Alignment>
+class AlignedAllocator {
+ public:
+  typedef T value_type;
+
+  /**
+   * Allows std::vector to obtain the allocator for a different type, needed
+   * because of the non-type template parameter
+   */
+  template <typename U>
+  struct rebind {
+    typedef AlignedAllocator<U, Alignment> other;
+  };
+
+  /**
+   * Constructor
+   */
+  AlignedAllocator() = default;
+
+  /**
+   * Converting constructor, required by the allocator requirements
+   */
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+  /**
+   * Allocates aligned memory for n objects of type T
+   * \param n number of objects
+   * \return pointer to the allocated memory
+   */
+  T* allocate(std::size_t n)
+  {
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, Alignment, n * sizeof(T)) != 0) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T*>(ptr);
+  }
+
+  /**
+   * Frees memory obtained from allocate()
+   * \param ptr pointer to the memory
+   */
+  void deallocate(T *ptr
+    , std::size_t)
+  {
+    free(ptr);
+  }
+};
+
+template <typename T, typename U, std::size_t Alignment>
+bool operator== (const AlignedAllocator<T, Alignment>&
+  , const AlignedAllocator<U, Alignment>&)
+{
+  return true;
+}
+
+template <typename T, typename U, std::size_t Alignment>
+bool operator!= (const AlignedAllocator<T, Alignment>&
+  , const AlignedAllocator<U, Alignment>&)
+{
+  return false;
+}
+#endif  // ALIGNED_ALLOCATOR_HPP_
@@ -1,8 +1,10 @@
 #ifndef BOUNCE_BACK_NODES_HPP_
 #define BOUNCE_BACK_NODES_HPP_
+#include <cstddef>  // std::size_t
 #include <vector>
 #include "BoundaryNodes.hpp"
 #include "CollisionModel.hpp"
+#include "LatticeField.hpp"
 #include "Node.hpp"
 #include "StreamModel.hpp"
 
@@ -21,11 +23,12 @@ class BouncebackNodes: public BoundaryNodes {
 
   /**
    * Creates a half-way bounceback node according to "http://lbmworkshop.com/wp-
-   * content/uploads/2011/08/Straight_boundaries.pdf"
+   * content/uploads/2011/08/Straight_boundaries.pdf". The nodes are link_wise:
+   * a lattice which streams into a second buffer reflects the values across
+   * the wall links of a node while it streams, see UpdateLinks()
    * \param lm LatticeModel to provide information on number of rows, columns,
    *        dimensions, discrete directions and lattice velocity
-   * \param sm StreamModel to copy the prestream node distribution functions
-   *        so they can be bounced back in the same time step
+   * \param sm StreamModel which streams the lattice of the nodes
    */
   BouncebackNodes(LatticeModel &lm
     , StreamModel *sm);
@@ -46,7 +49,9 @@ class BouncebackNodes: public BoundaryNodes {
   ~BouncebackNodes() = default;
 
   /**
-   * Adds a bounceback node
+   * Adds a bounceback node. The wall links of a half-way bounceback node, the
+   * directions in which a value would stream into it from outside the
+   * lattice, are found once here
    * \param x x-coordinate of the node
    * \param y y-coordinate of the node
    */
@@ -57,16 +62,40 @@ class BouncebackNodes: public BoundaryNodes {
    * the type of bounceback nodes used.
    * Full-way bounceback: Reflects all the node distribution functions in the
    *     opposite direction (except center distribution function)
-   * Half-way bounceback: Copies the prestream node distribution functions
-   *    before streaming. Updates the post-stream unknown distribution functions
-   *    with the prestream distribution functions in the opposite directions
-   * \param df lattice distribution functions store row-wise in a 2D vector
+   * Half-way bounceback: Saves the prestream values which are reflected
+   *    across the wall links before streaming. Updates the post-stream unknown
+   *    distribution functions with the saved values afterwards, for lattices
+   *    which do not use UpdateLinks()
+   * D2Q5 lattices are handled the same way without the diagonal directions
+   * \param df lattice distribution functions
    * \param is_modify_stream Boolean toggle for half-way bounceback as it has
    *        both pre-stream and post-stream functions. Used to fit in with how
    *        all boundary conditions are called
+   * \param first_row first row of the band
+   * \param last_row one past the last row of the band
    */
-  void UpdateNodes(std::vector<std::vector<double>> &df
-    , bool is_modify_stream);
+  void UpdateNodes(LatticeField &df
+    , bool is_modify_stream
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  using BoundaryNodes::UpdateNodes;
+
+  /**
+   * Reflects the post-collision value of each half-way bounceback node in the
+   * band into the opposite direction of the same node in df_next, for every
+   * wall link of the node. Values are copied as stored, opposite directions
+   * share their shift in single precision
+   * \param df lattice distribution functions after collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param first_row first row of the band
+   * \param last_row one past the last row of the band
+   */
+  void UpdateLinks(const LatticeField &df
+    , LatticeField &df_next
+    , std::size_t first_row
+    , std::size_t last_row) const;
 
   /**
    * Vector used to store information about the boundary nodes such as their
@@ -86,5 +115,32 @@ class BouncebackNodes: public BoundaryNodes {
    * models and NULL references can't be declared
    */
   StreamModel* sm_ = nullptr;
+
+  /**
+   * Copies the values across the wall links of the nodes in a band of rows
+   * between the raw planes of df and df_next, see UpdateLinks()
+   * \tparam T storage type of df and df_next
+   */
+  template <typename T>
+  void UpdateLinksKernel(const LatticeField &df
+    , LatticeField &df_next
+    , std::size_t first_row
+    , std::size_t last_row) const;
+
+  /**
+   * Direction of each wall link of the half-way bounceback nodes, the links
+   * of node k are stored from link_offsets_[k] to link_offsets_[k + 1]
+   */
+  std::vector<std::size_t> link_directions_;
+
+  /**
+   * Start of the wall links of each node, one past the last link at the end
+   */
+  std::vector<std::size_t> link_offsets_;
+
+  /**
+   * Prestream value reflected across each wall link, saved by UpdateNodes()
+   */
+  std::vector<double> link_values_;
 };
 #endif  // BOUNCE_BACK_NODES_HPP_
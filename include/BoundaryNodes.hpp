@@ -1,6 +1,9 @@
 #ifndef BOUNDARY_NODES_HPP_
 #define BOUNDARY_NODES_HPP_
+#include <array>
+#include <cstddef>  // std::size_t
 #include <vector>
+#include "LatticeField.hpp"
 #include "LatticeModel.hpp"
 
 class BoundaryNodes {
@@ -27,15 +30,48 @@ class BoundaryNodes {
    */
   virtual ~BoundaryNodes() = default;
 
+  /**
+   * Updates all the boundary nodes
+   * \param df lattice distribution functions
+   * \param is_modify_stream Boolean toggle for half-way bounceback nodes to
+   *        perform functions after streaming
+   */
+  void UpdateNodes(LatticeField &df
+    , bool is_modify_stream);
+
   /**
    * Pure virtual function for the boundary conditions to implement on how the
-   * boundary nodes are updated
-   * \param df lattice distribution functions stored row-wise in a 2D vector
+   * boundary nodes in a band of rows are updated. Lets the lattice update the
+   * boundary nodes of a band as soon as the band is streamed, see
+   * LatticeBoltzmann::Advance()
+   * \param df lattice distribution functions
    * \param is_modify_stream Boolean toggle for half-way bounceback nodes to
    *        perform functions after streaming
+   * \param first_row first row of the band
+   * \param last_row one past the last row of the band
    */
-  virtual void UpdateNodes(std::vector<std::vector<double>> &df
-    , bool is_modify_stream) = 0;
+  virtual void UpdateNodes(LatticeField &df
+    , bool is_modify_stream
+    , std::size_t first_row
+    , std::size_t last_row) = 0;
+
+  /**
+   * Updates the values which stream into the boundary nodes of a band of rows
+   * across wall links while the lattice streams into a second buffer, for
+   * boundary conditions which are link_wise. Only the values of the nodes in
+   * the band are read from df and written to df_next, so the lattice calls it
+   * for each slab right after the slab is streamed, in place of the prestream
+   * and during stream updates. Does nothing by default
+   * \param df lattice distribution functions after collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param first_row first row of the band
+   * \param last_row one past the last row of the band
+   */
+  virtual void UpdateLinks(const LatticeField &df
+    , LatticeField &df_next
+    , std::size_t first_row
+    , std::size_t last_row) const;
 
   /**
    * Boolean toggle to indicate if boundary condition occurs before streaming
@@ -48,12 +84,74 @@ class BoundaryNodes {
    */
   bool during_stream;
 
+  /**
+   * Boolean toggle to indicate if the boundary condition can be applied while
+   * streaming into a second buffer with UpdateLinks()
+   */
+  bool link_wise;
+
   /**
    * Indicates boundary node positions, for outputting results
    */
   std::vector<std::size_t> position;
 
  protected:
+  /**
+   * Planes of a field stored in double precision in the plain layout,
+   * accessed like the field so boundary kernels written for LatticeField can
+   * skip the layout and precision checks of LatticeField::operator()
+   */
+  class Planes {
+   public:
+    /**
+     * Constructor
+     * \param df field stored in double precision in the plain layout
+     */
+    explicit Planes(LatticeField &df)
+      : planes_ {}
+    {
+      for (auto i = 0u; i < df.GetNumberOfDirections(); ++i) {
+        planes_[i] = df.Direction(i);
+      }  // i
+    }
+
+    /**
+     * Accesses the value of a node in a discrete direction
+     * \param n index of the node in the lattice
+     * \param i discrete direction
+     * \return reference to the value
+     */
+    double& operator()(std::size_t n
+      , std::size_t i)
+    {
+      return planes_[i][n];
+    }
+
+   private:
+    /**
+     * Plane of each discrete direction, up to D2Q9
+     */
+    std::array<double*, 9> planes_;
+  };
+
+  /**
+   * Records the row of a node added by the derived class, the node is
+   * expected to be appended to the nodes of the derived class
+   * \param y row of the node
+   */
+  void AddNodeToRow(std::size_t y);
+
+  /**
+   * Indices of the boundary nodes in each row in the order they were added,
+   * lets the nodes of a band of rows be updated without searching all of them
+   */
+  std::vector<std::vector<std::size_t>> row_nodes_;
+
+  /**
+   * Number of boundary nodes added so far
+   */
+  std::size_t num_nodes_;
+
   /**
    * Enumeration for discrete directions to be used with df
    */
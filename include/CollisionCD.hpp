@@ -1,7 +1,11 @@
 #ifndef COLLISION_CD_HPP_
 #define COLLISION_CD_HPP_
+#include <cmath>  // std::abs
 #include <vector>
 #include "CollisionModel.hpp"
+#include "LatticeField.hpp"
+#include "SparseSource.hpp"
+#include "StreamModel.hpp"
 
 class CollisionCD: public CollisionModel {
  public:
@@ -20,6 +24,26 @@ class CollisionCD: public CollisionModel {
     , double initial_density_g
     , bool is_instant);
 
+  /**
+   * Constructor: Creates collision model for CD equation advected by the
+   * velocity of another lattice, e.g., a D2Q5 lattice for the solute with the
+   * velocity of the D2Q9 lattice of the flow. The lattices have to be the same
+   * size
+   * \param lm lattice model used for simulation
+   * \param flow_lm lattice model which supplies the velocity
+   * \param source_position source positions
+   * \param source_strength source strengths
+   * \param diffusion_coefficient
+   * \param initial_density_g initial density of CD lattice
+   */
+  CollisionCD(LatticeModel &lm
+    , const LatticeModel &flow_lm
+    , const std::vector<std::vector<std::size_t>> &source_position
+    , const std::vector<double> &source_strength
+    , double diffusion_coefficient
+    , double initial_density_g
+    , bool is_instant);
+
   /**
    * Destructor
    */
@@ -34,39 +58,327 @@ class CollisionCD: public CollisionModel {
       const std::vector<std::vector<std::size_t>> &source_position
     , const std::vector<double> &source_strength);
 
+  using CollisionModel::ComputeEq;
+  using CollisionModel::ComputeMacroscopicProperties;
+  using CollisionModel::Collide;
+  using CollisionModel::CollideAndStream;
+
+  /**
+   * Calculates equilibrium distribution function of a slab of rows, from the
+   * factors of the frozen flow while it is frozen, see ToggleFrozenFlow()
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void ComputeEq(std::size_t first_row
+    , std::size_t last_row);
+
   /**
    * Computes the macroscopic properties based on the convection-diffusion
    * collision model, just lattice density in this case. Based on "A new scheme
    * for source term in LBGK model for convection–diffusion equation
    * This is used to unify function calling in the LatticeBoltzmann TakeStep()
    * method
-   * \param df lattice distribution functions stored row-wise in a 2D vector
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
    */
-  void ComputeMacroscopicProperties(
-      const std::vector<std::vector<double>> &df);
+  void ComputeMacroscopicProperties(const LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
 
   /**
    * Applies force/source term according to "A new scheme for source term in
-   * LBGK model for convection-diffusion equation"
-   * \param lattice 2D vector containing distribution functions
+   * LBGK model for convection-diffusion equation", with the vectorized kernel
+   * for double precision storage. An instantaneous source is cleared for the
+   * rows of the slab
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
    */
-  void Collide(std::vector<std::vector<double>> &df);
+  void Collide(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Computes density, collides with the source term and streams each node of
+   * a slab of rows in a single pass. Velocity is taken from the lattice model
+   * which supplies it as in Collide()
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void CollideAndStream(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm
+    , std::size_t first_row
+    , std::size_t last_row);
 
   /**
    * Sets source term to 0
    */
   void KillSource();
 
+  /**
+   * Toggles between adding the source term at every node and only at the
+   * nodes of a SparseSource. Nodes without a source are then collided with
+   * the plain BGK kernel, and InitSource(), KillSource() and the clearing of
+   * an instantaneous source only visit the source nodes, the result is
+   * unchanged. The nodes are collected from source when sparse sources are
+   * switched on
+   */
+  void ToggleSparseSource();
+
+  /**
+   * Collects the nodes with a nonzero source again, needed after source is
+   * written directly while sparse sources are on. Does nothing otherwise
+   */
+  void UpdateSourceNodes();
+
+  /**
+   * Gets the nodes at which the source term is added
+   * \return source nodes, nullptr if the source term is added at every node
+   */
+  const SparseSource* GetSourceNodes() const;
+
+  /**
+   * Checks if the source term is instantaneous, i.e., cleared once it has
+   * been added
+   * \return true if the source term is instantaneous
+   */
+  bool IsInstant() const;
+
+  /**
+   * Toggles between reading the velocity at every step and treating the flow
+   * as frozen, e.g., once the NS lattice of a coupled run has reached steady
+   * state and is no longer stepped. When the flow is frozen the velocity
+   * dependent factors of the equilibrium and of the source term are computed
+   * once per node and discrete direction, so a step of the CD lattice no
+   * longer reads the velocity and only scales and adds the stored factors.
+   * The factors are computed from the current velocity each time the flow is
+   * frozen, the result is unchanged as long as the velocity is
+   */
+  void ToggleFrozenFlow();
+
+  /**
+   * Compares the velocity with the velocity at the previous call and freezes
+   * the flow once it has settled, see CheckSteadyState() and
+   * ToggleFrozenFlow(). Meant to be called every few hundred steps of the NS
+   * lattice, which does not need to be stepped once this returns TRUE
+   * \param tolerance relative change of the velocity below which the flow is
+   *        steady
+   * \return TRUE if the flow is frozen
+   */
+  bool FreezeSteadyFlow(double tolerance);
+
+  /**
+   * Checks if the flow is frozen, see ToggleFrozenFlow()
+   * \return TRUE if the flow is frozen
+   */
+  bool IsFlowFrozen() const;
+
   /**
    * Source term for CD equation stored row-wise
    */
   std::vector<double> source;
 
+
+  /**
+   * Computes density of a node and collides it with the source term, the
+   * per-node kernel of the fused pass, see CollisionNS::CollideNode(). An
+   * instantaneous source is cleared once it has been read
+   * \param n index of the node in the lattice
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values unless the node is skipped
+   */
+  template <typename Lattice>
+  void CollideNode(std::size_t n
+    , double *node);
+
+  /**
+   * Per-node kernel with the velocity of the node given by the caller instead
+   * of read from the lattice model, e.g., straight from the collision of the
+   * coupled NS lattice, see CollideNode(). The factors of the frozen flow are
+   * used instead while the flow is frozen
+   * \param n index of the node in the lattice
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values unless the node is skipped
+   * \param u Lattice::nd components of the velocity of the node
+   */
+  template <typename Lattice>
+  void CollideNode(std::size_t n
+    , double *node
+    , const double *u);
+
  protected:
+  /**
+   * Collides with the source term for the velocity set described by Lattice
+   * through the accessor, used for single precision storage, see Collide()
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideKernel(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Fused collide and stream pass for the velocity set described by Lattice,
+   * see CollideAndStream()
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideAndStreamKernel(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Collides the nodes of a slab of rows for the velocity set described by
+   * Lattice, see Collide()
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideSlab(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Collides the nodes of a slab of rows with the factors of the frozen flow,
+   * see ToggleFrozenFlow()
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideFrozen(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Calculates equilibrium distribution function of a slab of rows from the
+   * factors of the frozen flow, see ComputeEq()
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void ComputeFrozenEq(std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Computes the factors of the frozen flow from the velocity
+   */
+  template <typename Lattice>
+  void ComputeFlowFactors();
+
+  /**
+   * Collides the nodes of a slab of rows with the plain BGK kernel and then
+   * the source nodes of the slab with the source term, see Collide()
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideSourceNodes(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
   /**
    * Boolean toggle to indicate if the source term in this collision model is an
    * instantaneous source, for use with diffusion analytical solution
    */
   bool is_instant_;
+
+  /**
+   * Boolean toggle to indicate if the source term is only added at the nodes
+   * of source_nodes_
+   */
+  bool is_sparse_source_;
+
+  /**
+   * Nodes with a source, kept up to date while sparse sources are on
+   */
+  SparseSource source_nodes_;
+
+  /**
+   * Boolean toggle to indicate if the flow is frozen
+   */
+  bool is_frozen_flow_;
+
+  /**
+   * Velocity dependent factor of the equilibrium of each node and discrete
+   * direction, 1 + c.u / cs^2 + (c.u)^2 / (2 cs^4) - u.u / (2 cs^2), filled
+   * while the flow is frozen
+   */
+  LatticeField edf_factor_;
+
+  /**
+   * Velocity dependent factor of the source term of each node and discrete
+   * direction, 1 + (1 - 1 / (2 tau)) c.u / cs^2, filled while the flow is
+   * frozen
+   */
+  LatticeField source_factor_;
+
+  /**
+   * Velocity at the previous call of FreezeSteadyFlow()
+   */
+  std::vector<std::vector<double>> u_prev_;
 };
+
+template <typename Lattice>
+void CollisionCD::CollideNode(std::size_t n
+  , double *node)
+{
+  CollideNode<Lattice>(n, node, u_[n].data());
+}
+
+template <typename Lattice>
+void CollisionCD::CollideNode(std::size_t n
+  , double *node
+  , const double *u)
+{
+  auto rho_node = 0.0;
+  for (auto i = 0u; i < Lattice::nq; ++i) rho_node += node[i];
+  rho[n] = rho_node;
+  const auto is_source_node = !is_sparse_source_ ||
+      source_nodes_.IsSourceNode(n);
+  const auto source_node = is_source_node ? source[n] : 0.0;
+  if (is_instant_ && is_source_node) source[n] = 0.0;
+  if (skip[n]) return;
+  if (is_frozen_flow_) {
+    // most nodes have no source, their source factors are not read
+    const auto is_source = std::abs(source_node) > 0.0;
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      const auto edf_i = Lattice::omega[i] * rho_node *
+          edf_factor_.Direction(i)[n];
+      const auto src_i = is_source ? Lattice::omega[i] * source_node *
+          source_factor_.Direction(i)[n] : 0.0;
+      node[i] += (edf_i - node[i]) / tau_ + dt_ * src_i;
+    }  // i
+    return;
+  }
+  auto u_sqr = 0.0;
+  for (auto d = 0u; d < Lattice::nd; ++d) u_sqr += u[d] * u[d];
+  u_sqr /= 2.0 * cs_sqr_;
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    const auto c_dot_u = DotVelocity<Lattice>(i, u, c_) / cs_sqr_;
+    const auto edf_i = Lattice::omega[i] * rho_node * (1.0 + c_dot_u *
+        (1.0 + c_dot_u / 2.0) - u_sqr);
+    // source term using forward scheme, theta = 0
+    const auto src_i = Lattice::omega[i] * source_node * (1.0 + (1.0 - 0.5 /
+        tau_) * c_dot_u);
+    node[i] += (edf_i - node[i]) / tau_ + dt_ * src_i;
+  }  // i
+}
 #endif  // COLLISION_CD_HPP_
@@ -0,0 +1,258 @@
+#ifndef COLLISION_KBC_HPP_
+#define COLLISION_KBC_HPP_
+#include <vector>
+#include "CollisionNSF.hpp"
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
+#include "LatticeModel.hpp"
+#include "StreamModel.hpp"
+
+class CollisionKBC: public CollisionNSF {
+ public:
+  /**
+   * Constructor: Creates entropic collision model for NS equation without body
+   * force and the same density at each node, see the constructor with body
+   * force
+   * \param lm lattice model used for simulation
+   * \param kinematic_viscosity kinematic viscosity
+   * \param initial_density_f initial density of NS lattice
+   */
+  CollisionKBC(LatticeModel &lm
+    , double kinematic_viscosity
+    , double initial_density_f);
+
+  /**
+   * Constructor: Creates entropic collision model for NS equation with body
+   * force and the same density at each node, based on "Entropic multi-
+   * relaxation lattice Boltzmann models for turbulent flows" Bosch2015 (the
+   * KBC model of Karlin2014). The non-equilibrium part of a node is split
+   * into the part of the conserved moments, the shear part made of the
+   * deviatoric stress, which relaxes with the BGK relaxation time and sets the
+   * viscosity, and the higher order part. The relaxation of the higher order
+   * part is chosen at each node in closed form so the entropy production is
+   * maximal, which damps under-resolved modes and keeps runs with a relaxation
+   * time close to 0.5 stable. The stabilizer reduces to BGK where the flow is
+   * resolved. The body force is applied with the Guo forcing term
+   * \param lm lattice model used for simulation
+   * \param source_position source positions
+   * \param source_strength source strengths
+   * \param kinematic_viscosity kinematic viscosity
+   * \param initial_density_f initial density of NS lattice
+   */
+  CollisionKBC(LatticeModel &lm
+    , const std::vector<std::vector<std::size_t>> &source_position
+    , const std::vector<std::vector<double>> &source_strength
+    , double kinematic_viscosity
+    , double initial_density_f);
+
+  /**
+   * Destructor
+   */
+  ~CollisionKBC() = default;
+
+  using CollisionNSF::Collide;
+  using CollisionNSF::CollideAndStream;
+
+  /**
+   * Collides the shear and higher order parts of each node with their own
+   * relaxation and applies force according to Guo2002
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void Collide(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Computes density and velocity with the force correction, collides with the
+   * entropic stabilizer and streams each node of a slab of rows in a single
+   * pass
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void CollideAndStream(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Computes density and velocity with the force correction of a node and
+   * collides it with the entropic stabilizer, the per-node kernel of the fused
+   * pass, see CollisionNSF::CollideNode()
+   * \param n index of the node in the lattice
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values unless the node is skipped
+   */
+  template <typename Lattice>
+  void CollideNode(std::size_t n
+    , double *node);
+
+  /**
+   * Per-node kernel which also hands the velocity of the node to the caller,
+   * see CollisionNSF::CollideNode()
+   * \param n index of the node in the lattice
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values unless the node is skipped
+   * \param u receives the Lattice::nd components of the velocity of the node,
+   *        which is also stored in the lattice model
+   */
+  template <typename Lattice>
+  void CollideNode(std::size_t n
+    , double *node
+    , double *u);
+
+ protected:
+  /**
+   * Collides the nodes of a slab of rows through the accessor, see Collide()
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideKernel(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Fused collide and stream pass for the velocity set described by Lattice,
+   * see CollideAndStream()
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideAndStreamKernel(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Splits the non-equilibrium part of a node into the parts of the natural
+   * moments of D2Q9, relaxes them and adds the forcing term. The stabilizer
+   * gamma = 2 tau - (2 - 2 tau) <ds|dh> / <dh|dh>, with the entropic scalar
+   * product <x|y> = sum_i x_i y_i / edf_i, is 2 for BGK
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values
+   * \param neq non-equilibrium part of each distribution function
+   * \param edf_node equilibrium distribution functions of the node
+   * \param src Guo forcing term of each discrete direction before it is
+   *        scaled by the relaxation
+   */
+  template <typename Lattice>
+  void RelaxNode(double *node
+    , const double *neq
+    , const double *edf_node
+    , const double *src) const;
+};
+
+template <typename Lattice>
+void CollisionKBC::CollideNode(std::size_t n
+  , double *node)
+{
+  double u[Lattice::nd];
+  CollideNode<Lattice>(n, node, u);
+}
+
+template <typename Lattice>
+void CollisionKBC::CollideNode(std::size_t n
+  , double *node
+  , double *u)
+{
+  auto rho_node = 0.0;
+  for (auto i = 0u; i < Lattice::nq; ++i) rho_node += node[i];
+  for (auto d = 0u; d < Lattice::nd; ++d) {
+    u[d] = FirstMoment<Lattice>(node, d, c_);
+    u[d] += 0.5 * dt_ * source[n][d] * rho_node;
+    u[d] /= rho_node;
+  }  // d
+  rho[n] = rho_node;
+  for (auto d = 0u; d < Lattice::nd; ++d) lm_.u[n][d] = u[d];
+  if (skip[n]) return;
+  auto u_sqr = 0.0;
+  for (auto d = 0u; d < Lattice::nd; ++d) u_sqr += u[d] * u[d];
+  u_sqr /= 2.0 * cs_sqr_;
+  double edf_node[Lattice::nq];
+  double neq[Lattice::nq];
+  double src[Lattice::nq];
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    const auto c_dot_u = DotVelocity<Lattice>(i, u, c_) / cs_sqr_;
+    edf_node[i] = Lattice::omega[i] * rho_node * (1.0 + c_dot_u * (1.0 +
+        c_dot_u / 2.0) - u_sqr);
+    auto src_dot_product = 0.0;
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      const auto e_id = Lattice::e[i][d] * c_;
+      src_dot_product += (e_id - u[d] + c_dot_u * e_id) * source[n][d];
+    }  // d
+    src_dot_product /= cs_sqr_ / rho_node;
+    neq[i] = node[i] - edf_node[i];
+    src[i] = Lattice::omega[i] * src_dot_product;
+  }  // i
+  RelaxNode<Lattice>(node, neq, edf_node, src);
+}
+
+template <typename Lattice>
+void CollisionKBC::RelaxNode(double *node
+  , const double *neq
+  , const double *edf_node
+  , const double *src) const
+{
+  static_assert(Lattice::nd == 2, "KBC collision is written for D2Q9");
+  // density, momentum and stress of the non-equilibrium part in lattice
+  // units, the momentum is nonzero only through the force correction
+  auto d_rho = 0.0;
+  auto j_x = 0.0;
+  auto j_y = 0.0;
+  auto p_xx = 0.0;
+  auto p_yy = 0.0;
+  auto p_xy = 0.0;
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    const auto e_x = Lattice::e[i][0];
+    const auto e_y = Lattice::e[i][1];
+    d_rho += neq[i];
+    j_x += e_x * neq[i];
+    j_y += e_y * neq[i];
+    p_xx += e_x * e_x * neq[i];
+    p_yy += e_y * e_y * neq[i];
+    p_xy += e_x * e_y * neq[i];
+  }  // i
+  const auto p_normal = p_xx - p_yy;
+  double delta_h[Lattice::nq];
+  auto ds_dh = 0.0;
+  auto dh_dh = 0.0;
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    const auto e_x = Lattice::e[i][0];
+    const auto e_y = Lattice::e[i][1];
+    // conserved part sits on the rest and axis directions, shear part on the
+    // axis and diagonal directions
+    auto delta_k = 0.0;
+    if (e_x == 0 && e_y == 0) {
+      delta_k = d_rho;
+    }
+    else if (e_x * e_y == 0) {
+      delta_k = 0.5 * (e_x * j_x + e_y * j_y);
+    }
+    const auto delta_s = 0.25 * ((e_x * e_x - e_y * e_y) * p_normal + e_x *
+        e_y * p_xy);
+    delta_h[i] = neq[i] - delta_k - delta_s;
+    ds_dh += delta_s * delta_h[i] / edf_node[i];
+    dh_dh += delta_h[i] * delta_h[i] / edf_node[i];
+  }  // i
+  const auto beta = 0.5 / tau_;
+  auto gamma = 2.0;
+  if (dh_dh > 0.0) gamma = 1.0 / beta - (2.0 - 1.0 / beta) * ds_dh / dh_dh;
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    node[i] -= beta * (2.0 * (neq[i] - delta_h[i]) + gamma * delta_h[i]);
+    node[i] += dt_ * (1.0 - beta) * src[i];
+  }  // i
+}
+#endif  // COLLISION_KBC_HPP_
@@ -0,0 +1,231 @@
+#ifndef COLLISION_LES_HPP_
+#define COLLISION_LES_HPP_
+#include <cmath>  // std::sqrt
+#include <vector>
+#include "CollisionNSF.hpp"
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
+#include "LatticeModel.hpp"
+#include "StreamModel.hpp"
+
+class CollisionLES: public CollisionNSF {
+ public:
+  /**
+   * Constructor: Creates large eddy simulation collision model for NS equation
+   * without body force and the same density at each node, see the constructor
+   * with body force
+   * \param lm lattice model used for simulation
+   * \param kinematic_viscosity molecular kinematic viscosity
+   * \param smagorinsky_constant Smagorinsky constant, 0.1 to 0.2 is typical,
+   *        0 gives back the BGK collision
+   * \param initial_density_f initial density of NS lattice
+   */
+  CollisionLES(LatticeModel &lm
+    , double kinematic_viscosity
+    , double smagorinsky_constant
+    , double initial_density_f);
+
+  /**
+   * Constructor: Creates large eddy simulation collision model for NS equation
+   * with body force and the same density at each node, based on "A lattice
+   * Boltzmann subgrid model for high Reynolds number flows" Hou1996. The
+   * Smagorinsky eddy viscosity is added to the molecular viscosity through a
+   * relaxation time of each node, which is computed from the magnitude of the
+   * non-equilibrium stress of the node, so the strain rate comes from the
+   * distribution functions being collided and needs no finite differences or
+   * extra pass over the lattice. The filter width is the lattice spacing
+   * \param lm lattice model used for simulation
+   * \param source_position source positions
+   * \param source_strength source strengths
+   * \param kinematic_viscosity molecular kinematic viscosity
+   * \param smagorinsky_constant Smagorinsky constant, 0.1 to 0.2 is typical,
+   *        0 gives back the BGK collision
+   * \param initial_density_f initial density of NS lattice
+   */
+  CollisionLES(LatticeModel &lm
+    , const std::vector<std::vector<std::size_t>> &source_position
+    , const std::vector<std::vector<double>> &source_strength
+    , double kinematic_viscosity
+    , double smagorinsky_constant
+    , double initial_density_f);
+
+  /**
+   * Destructor
+   */
+  ~CollisionLES() = default;
+
+  using CollisionNSF::Collide;
+  using CollisionNSF::CollideAndStream;
+
+  /**
+   * Collides with the relaxation time of each node and applies force
+   * according to Guo2002, with the vectorized kernel for double precision
+   * storage
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void Collide(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Computes density and velocity with the force correction, collides with
+   * the relaxation time of each node and streams each node of a slab of rows
+   * in a single pass
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void CollideAndStream(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Gets the Smagorinsky constant
+   * \return Smagorinsky constant
+   */
+  double GetSmagorinskyConstant() const;
+
+  /**
+   * Computes density and velocity with the force correction of a node and
+   * collides it with its own relaxation time, the per-node kernel of the
+   * fused pass, see CollisionNSF::CollideNode()
+   * \param n index of the node in the lattice
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values unless the node is skipped
+   */
+  template <typename Lattice>
+  void CollideNode(std::size_t n
+    , double *node);
+
+  /**
+   * Per-node kernel which also hands the velocity of the node to the caller,
+   * see CollisionNSF::CollideNode()
+   * \param n index of the node in the lattice
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values unless the node is skipped
+   * \param u receives the Lattice::nd components of the velocity of the node,
+   *        which is also stored in the lattice model
+   */
+  template <typename Lattice>
+  void CollideNode(std::size_t n
+    , double *node
+    , double *u);
+
+ protected:
+  /**
+   * Collides through the accessor, used for single precision storage, see
+   * Collide()
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideKernel(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Fused collide and stream pass for the velocity set described by Lattice,
+   * see CollideAndStream()
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideAndStreamKernel(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Computes the relaxation time of a node from its non-equilibrium part,
+   * the positive root of tau_node^2 - tau * tau_node - 9 / sqrt(2) * C^2 * Q
+   * / rho = 0 where Q is the norm of the non-equilibrium stress in lattice
+   * units
+   * \param neq non-equilibrium part of each distribution function of the node
+   * \param rho_node density of the node
+   * \return relaxation time of the node
+   */
+  template <typename Lattice>
+  double ComputeNodeRelaxationTime(const double *neq
+    , double rho_node) const;
+
+  /**
+   * Smagorinsky constant
+   */
+  double smagorinsky_constant_;
+
+  /**
+   * 18 * sqrt(2) * C^2 for the Smagorinsky constant C, the factor of the
+   * stress norm in the relaxation time of a node
+   */
+  double smagorinsky_factor_;
+};
+
+template <typename Lattice>
+void CollisionLES::CollideNode(std::size_t n
+  , double *node)
+{
+  double u[Lattice::nd];
+  CollideNode<Lattice>(n, node, u);
+}
+
+template <typename Lattice>
+void CollisionLES::CollideNode(std::size_t n
+  , double *node
+  , double *u)
+{
+  auto rho_node = 0.0;
+  for (auto i = 0u; i < Lattice::nq; ++i) rho_node += node[i];
+  for (auto d = 0u; d < Lattice::nd; ++d) {
+    u[d] = FirstMoment<Lattice>(node, d, c_);
+    u[d] += 0.5 * dt_ * source[n][d] * rho_node;
+    u[d] /= rho_node;
+  }  // d
+  rho[n] = rho_node;
+  for (auto d = 0u; d < Lattice::nd; ++d) lm_.u[n][d] = u[d];
+  if (skip[n]) return;
+  auto u_sqr = 0.0;
+  for (auto d = 0u; d < Lattice::nd; ++d) u_sqr += u[d] * u[d];
+  u_sqr /= 2.0 * cs_sqr_;
+  double neq[Lattice::nq];
+  double src[Lattice::nq];
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    const auto c_dot_u = DotVelocity<Lattice>(i, u, c_) / cs_sqr_;
+    const auto edf_i = Lattice::omega[i] * rho_node * (1.0 + c_dot_u *
+        (1.0 + c_dot_u / 2.0) - u_sqr);
+    auto src_dot_product = 0.0;
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      const auto e_id = Lattice::e[i][d] * c_;
+      src_dot_product += (e_id - u[d] + c_dot_u * e_id) * source[n][d];
+    }  // d
+    src_dot_product /= cs_sqr_ / rho_node;
+    neq[i] = node[i] - edf_i;
+    src[i] = src_dot_product;
+  }  // i
+  const auto tau_node = ComputeNodeRelaxationTime<Lattice>(neq, rho_node);
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    const auto src_i = (1.0 - 0.5 / tau_node) * Lattice::omega[i] * src[i];
+    node[i] += -neq[i] / tau_node + dt_ * src_i;
+  }  // i
+}
+
+template <typename Lattice>
+double CollisionLES::ComputeNodeRelaxationTime(const double *neq
+  , double rho_node) const
+{
+  return 0.5 * (tau_ + std::sqrt(tau_ * tau_ + smagorinsky_factor_ *
+      SecondMomentNorm<Lattice>(neq) / rho_node));
+}
+#endif  // COLLISION_LES_HPP_
@@ -0,0 +1,243 @@
+#ifndef COLLISION_MRT_HPP_
+#define COLLISION_MRT_HPP_
+#include <vector>
+#include "CollisionNSF.hpp"
+#include "LatticeField.hpp"
+#include "LatticeModel.hpp"
+#include "StreamModel.hpp"
+
+class CollisionMRT: public CollisionNSF {
+ public:
+  /**
+   * Constructor: Creates multiple-relaxation-time collision model for NS
+   * equation with body force and the same density at each node, based on
+   * Lallemand2000 with the forcing term of Guo2002 transformed into moment
+   * space. The stresses relax with the BGK relaxation time, which sets the
+   * viscosity, the other moments relax at their own rates so the
+   * non-hydrodynamic modes are damped as the relaxation time approaches 0.5
+   * and the same Reynolds number runs on a coarser lattice than with BGK.
+   * Density and momentum relax with the BGK rate as well, which has no effect
+   * since they are conserved
+   * \param lm lattice model used for simulation
+   * \param source_position source positions
+   * \param source_strength source strengths
+   * \param kinematic_viscosity kinematic viscosity
+   * \param initial_density_f initial density of NS lattice
+   */
+  CollisionMRT(LatticeModel &lm
+    , const std::vector<std::vector<std::size_t>> &source_position
+    , const std::vector<std::vector<double>> &source_strength
+    , double kinematic_viscosity
+    , double initial_density_f);
+
+  /**
+   * Destructor
+   */
+  ~CollisionMRT() = default;
+
+  using CollisionNSF::Collide;
+  using CollisionNSF::CollideAndStream;
+
+  /**
+   * Sets the relaxation rates of the moments which do not affect the
+   * viscosity. The defaults are 1.64 and 1.54 for the energy and its square
+   * from Lallemand2000 and 8 * (2 - s) / (8 - s) for the heat flux, where s
+   * is the rate of the stresses, which puts the wall of halfway bounceback
+   * exactly halfway between the nodes. Setting all three to 1 / tau gives
+   * back the BGK collision
+   * \param energy relaxation rate of the energy
+   * \param energy_square relaxation rate of the energy square
+   * \param heat_flux relaxation rate of the heat flux
+   */
+  void SetRelaxationRates(double energy
+    , double energy_square
+    , double heat_flux);
+
+  /**
+   * Transforms the non-equilibrium part of the distribution functions into
+   * moments, relaxes each moment at its own rate, applies the Guo forcing term
+   * in moment space and transforms back, with the vectorized kernel for
+   * double precision storage
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void Collide(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Computes density and velocity with the force correction, collides in
+   * moment space and streams each node of a slab of rows in a single pass
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void CollideAndStream(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Computes density and velocity with the force correction of a node and
+   * collides it in moment space, the per-node kernel of the fused pass, see
+   * CollisionNSF::CollideNode()
+   * \param n index of the node in the lattice
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values unless the node is skipped
+   */
+  template <typename Lattice>
+  void CollideNode(std::size_t n
+    , double *node);
+
+  /**
+   * Per-node kernel which also hands the velocity of the node to the caller,
+   * see CollisionNSF::CollideNode()
+   * \param n index of the node in the lattice
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values unless the node is skipped
+   * \param u receives the Lattice::nd components of the velocity of the node,
+   *        which is also stored in the lattice model
+   */
+  template <typename Lattice>
+  void CollideNode(std::size_t n
+    , double *node
+    , double *u);
+
+ protected:
+  /**
+   * Collides through the accessor, used for single precision storage, see
+   * Collide()
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideKernel(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Fused collide and stream pass for the velocity set described by Lattice,
+   * see CollideAndStream()
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideAndStreamKernel(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Relaxes the moments of the non-equilibrium part of a node and adds the
+   * forcing term
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values
+   * \param neq non-equilibrium part of each distribution function
+   * \param src Guo forcing term of each discrete direction before it is
+   *        scaled by the relaxation
+   */
+  template <typename Lattice>
+  void RelaxNode(double *node
+    , const double *neq
+    , const double *src) const;
+
+  /**
+   * Relaxation rate of each moment of the moment basis
+   */
+  std::vector<double> rates_;
+
+  /**
+   * Relaxation rate of each moment divided by the squared norm of its row of
+   * the moment basis, used by the per-node kernel
+   */
+  std::vector<double> relax_;
+
+  /**
+   * Forcing factor dt * (1 - rate / 2) of each moment divided by the squared
+   * norm of its row of the moment basis, used by the per-node kernel
+   */
+  std::vector<double> force_;
+};
+
+template <typename Lattice>
+void CollisionMRT::CollideNode(std::size_t n
+  , double *node)
+{
+  double u[Lattice::nd];
+  CollideNode<Lattice>(n, node, u);
+}
+
+template <typename Lattice>
+void CollisionMRT::CollideNode(std::size_t n
+  , double *node
+  , double *u)
+{
+  auto rho_node = 0.0;
+  for (auto i = 0u; i < Lattice::nq; ++i) rho_node += node[i];
+  for (auto d = 0u; d < Lattice::nd; ++d) {
+    u[d] = FirstMoment<Lattice>(node, d, c_);
+    u[d] += 0.5 * dt_ * source[n][d] * rho_node;
+    u[d] /= rho_node;
+  }  // d
+  rho[n] = rho_node;
+  for (auto d = 0u; d < Lattice::nd; ++d) lm_.u[n][d] = u[d];
+  if (skip[n]) return;
+  auto u_sqr = 0.0;
+  for (auto d = 0u; d < Lattice::nd; ++d) u_sqr += u[d] * u[d];
+  u_sqr /= 2.0 * cs_sqr_;
+  double neq[Lattice::nq];
+  double src[Lattice::nq];
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    const auto c_dot_u = DotVelocity<Lattice>(i, u, c_) / cs_sqr_;
+    const auto edf_i = Lattice::omega[i] * rho_node * (1.0 + c_dot_u *
+        (1.0 + c_dot_u / 2.0) - u_sqr);
+    auto src_dot_product = 0.0;
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      const auto e_id = Lattice::e[i][d] * c_;
+      src_dot_product += (e_id - u[d] + c_dot_u * e_id) * source[n][d];
+    }  // d
+    src_dot_product /= cs_sqr_ / rho_node;
+    neq[i] = node[i] - edf_i;
+    src[i] = Lattice::omega[i] * src_dot_product;
+  }  // i
+  RelaxNode<Lattice>(node, neq, src);
+}
+
+template <typename Lattice>
+void CollisionMRT::RelaxNode(double *node
+  , const double *neq
+  , const double *src) const
+{
+  double m[Lattice::nq];
+  for (auto k = 0u; k < Lattice::nq; ++k) {
+    auto m_neq = 0.0;
+    auto m_src = 0.0;
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      if (Lattice::moment[k][i] == 0) continue;
+      m_neq += Lattice::moment[k][i] * neq[i];
+      m_src += Lattice::moment[k][i] * src[i];
+    }  // i
+    m[k] = relax_[k] * m_neq - force_[k] * m_src;
+  }  // k
+  // back to the distribution functions with the transpose of the basis, the
+  // norms are already folded into m
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    auto delta = 0.0;
+    for (auto k = 0u; k < Lattice::nq; ++k) {
+      if (Lattice::moment[k][i] != 0) delta += Lattice::moment[k][i] * m[k];
+    }  // k
+    node[i] -= delta;
+  }  // i
+}
+#endif  // COLLISION_MRT_HPP_
@@ -1,7 +1,12 @@
 #ifndef COLLISION_MODEL_HPP_
 #define COLLISION_MODEL_HPP_
+#include <memory>  // std::shared_ptr
 #include <vector>
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
 #include "LatticeModel.hpp"
+#include "SparseLattice.hpp"
+#include "StreamModel.hpp"
 
 class CollisionModel {
  public:
@@ -21,6 +26,18 @@ class CollisionModel {
   CollisionModel(LatticeModel &lm
     , const std::vector<double> &initial_density);
 
+  /**
+   * Constructor: Creates collision model with the same density at each node
+   * whose equilibrium is computed with the velocity of another lattice, e.g.,
+   * a D2Q5 convection-diffusion lattice advected by a D2Q9 NS lattice
+   * \param lm lattice model used for simulation
+   * \param velocity velocity of each node, has to outlive the collision model
+   * \param initial_density initial density of the lattice
+   */
+  CollisionModel(LatticeModel &lm
+    , const std::vector<std::vector<double>> &velocity
+    , double initial_density);
+
   // https://stackoverflow.com/questions/353817/should-every-class-have-a-
   // virtual-destructor
   /**
@@ -29,36 +46,139 @@ class CollisionModel {
   virtual ~CollisionModel()= default;
 
   /**
-   * Calculates equilibrium distribution function according to LBIntro
+   * Calculates equilibrium distribution function according to LBIntro, see
+   * ComputeEqKernel(). Allocates edf the first time it is called
    */
   void ComputeEq();
 
+  /**
+   * Calculates equilibrium distribution function of a slab of rows, virtual
+   * so a collision model can compute it from precomputed factors, see
+   * CollisionCD::ToggleFrozenFlow()
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  virtual void ComputeEq(std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Calculates the equilibrium distribution function of the density and
+   * velocity into a new field and leaves edf alone, so a lattice can start
+   * from it without the collision model keeping a copy
+   * \return equilibrium distribution function of each node
+   */
+  LatticeField ComputeEqField() const;
+
+  /**
+   * Allocates edf if it has not been allocated yet. Only the separate collide
+   * sweep reads it, the fused kernels never store the equilibrium so lattices
+   * which only use them run without it. Has to be called before
+   * ComputeEq(first_row, last_row) runs on slabs of rows concurrently
+   */
+  void AllocateEq();
+
   /**
    * Compute density at each node by summing up its distribution functions
-   * \param lattice 2D vector containing distribution functions
+   * \param df lattice distribution functions
    * \return density of lattice stored row-wise in a 1D vector
    */
-  std::vector<double> ComputeRho(const std::vector<std::vector<double>> &df);
+  std::vector<double> ComputeRho(const LatticeField &df);
+
+  /**
+   * Compute density at each node by summing up its distribution functions,
+   * writes into an existing vector so stepping does not allocate
+   * \param df lattice distribution functions
+   * \param result density of lattice stored row-wise in a 1D vector, must
+   *        have one value per node
+   */
+  void ComputeRho(const LatticeField &df
+    , std::vector<double> &result);
+
+  /**
+   * Compute density at each node of a slab of rows, the other values of
+   * result are not touched
+   * \param df lattice distribution functions
+   * \param result density of lattice stored row-wise in a 1D vector, must
+   *        have one value per node
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void ComputeRho(const LatticeField &df
+    , std::vector<double> &result
+    , std::size_t first_row
+    , std::size_t last_row);
 
   /**
-   * Pure virtual function to compute the macroscopic properties of the lattice
+   * Computes the macroscopic properties of the lattice
    * depending on the equation, density and velocity for Navier-Stokes, only
    * density for Convection-diffusion equation
    * This is used to unify function calling in LatticeBoltzmann TakeStep()
    * method
-   * \param df Particle distribution functions of the lattice stored row-wise
-   *        in a 2D vector
+   * \param df Particle distribution functions of the lattice
    */
-  virtual void ComputeMacroscopicProperties(
-      const std::vector<std::vector<double>> &df) = 0;
+  void ComputeMacroscopicProperties(const LatticeField &df);
 
   /**
-   * Pure virtual function to compute collision step and apply force step
+   * Pure virtual function to compute the macroscopic properties of a slab of
+   * rows, see ComputeMacroscopicProperties()
+   * \param df Particle distribution functions of the lattice
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  virtual void ComputeMacroscopicProperties(const LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row) = 0;
+
+  /**
+   * Computes collision step and applies force step
    * according to "A new scheme for source term in LBGK model for
-   * convectiondiffusion equation" and Guo2002
-   * \param lattice 2D vector containing distribution functions
+   * convectiondiffusion equation" and Guo2002. Calculates edf first if it
+   * has not been calculated yet
+   * \param df lattice distribution functions
+   */
+  void Collide(LatticeField &df);
+
+  /**
+   * Pure virtual function to compute the collision step of a slab of rows, see
+   * Collide()
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  virtual void Collide(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row) = 0;
+
+  /**
+   * Performs the collision and streaming steps in a single pass. Density and
+   * velocity are computed from the values of each node as it is read and the
+   * equilibrium is never stored, so rho and u describe the lattice at the
+   * start of the step once the pass is done
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
    */
-  virtual void Collide(std::vector<std::vector<double>> &df) = 0;
+  void CollideAndStream(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm);
+
+  /**
+   * Pure virtual function to collide and stream the nodes of a slab of rows,
+   * see CollideAndStream(). Slabs can run concurrently, once all of them are
+   * done StreamModel::FinishCollideAndStream() completes the pass
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  virtual void CollideAndStream(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm
+    , std::size_t first_row
+    , std::size_t last_row) = 0;
 
   /**
    * Adds a node to exclude it from the collision step
@@ -67,9 +187,39 @@ class CollisionModel {
   void AddNodeToSkip(std::size_t n);
 
   /**
-   * Equilibrium distribution function stored row-wise in a 2D vector
+   * Toggles between colliding every node and only the nodes of a
+   * SparseLattice built from the skipped nodes in CollideAndStream(), so
+   * obstacles made of full-way bounceback nodes cost next to nothing. The
+   * density and velocity of the solid nodes inside the obstacles are no longer
+   * updated. The nodes are collected when sparse collision is switched on,
+   * nodes skipped afterwards are still collided until it is toggled again
    */
-  std::vector<std::vector<double>> edf;
+  void ToggleSparseLattice();
+
+  /**
+   * Gets the nodes which are collided in CollideAndStream()
+   * \return sparse lattice, nullptr if every node is collided
+   */
+  const SparseLattice* GetSparseLattice() const;
+
+  /**
+   * Gets the relaxation time of the collision model
+   * \return relaxation time
+   */
+  double GetRelaxationTime() const;
+
+  /**
+   * Gets the velocity field the collision model reads, which is the velocity
+   * of its own lattice model unless it is advected by another one
+   * \return velocity of each node
+   */
+  const std::vector<std::vector<double>>& GetAdvectingVelocity() const;
+
+  /**
+   * Equilibrium distribution function, empty until the separate collide sweep
+   * needs it, see AllocateEq()
+   */
+  LatticeField edf;
 
   /**
    * Density stored row-wise in a 1D vector.
@@ -77,17 +227,67 @@ class CollisionModel {
   std::vector<double> rho;
 
   /**
-   * Skips the collision step for the node if it is a full-way bounceback node
+   * Skips the collision step for the node if it is a full-way bounceback node,
+   * one byte per node so the vectorized kernels can load the flags directly
    */
-  std::vector<bool> skip;
+  std::vector<char> skip;
 
  protected:
+  /**
+   * Calculates equilibrium distribution function for the velocity set
+   * described by Lattice, the loop over the discrete directions has a
+   * constant trip count and the velocities and weights are constants
+   * \param result field which receives the equilibrium distribution function
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void ComputeEqKernel(LatticeField &result
+    , std::size_t first_row
+    , std::size_t last_row) const;
+
+  /**
+   * Sums the raw planes of a field in the plain layout, adding back the shift
+   * of each plane so the density is accumulated in double precision
+   * \tparam T storage type of df
+   * \param df lattice distribution functions
+   * \param result vector which receives the density of each node
+   * \param first_node index of the first node to sum
+   * \param last_node one past the index of the last node to sum
+   */
+  template <typename T>
+  void ComputeRhoKernel(const LatticeField &df
+    , std::vector<double> &result
+    , std::size_t first_node
+    , std::size_t last_node);
+
+  /**
+   * Checks once that the velocity has a value per node and dimension, the
+   * kernels index it without checks
+   */
+  void CheckVelocity();
+
+  /**
+   * Copies the velocity u_ of a slab of rows into velocity_planes_, one
+   * contiguous plane per dimension, for the vectorized collision kernels
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void GatherVelocity(std::size_t first_row
+    , std::size_t last_row);
+
   /**
    * Lattice model to handle number of rows, columns, dimensions, directions,
    * velocity
    */
   LatticeModel &lm_;
 
+  /**
+   * Velocity the equilibrium is computed with, the velocity of lm_ unless the
+   * collision model is advected by another lattice
+   */
+  const std::vector<std::vector<double>> &u_;
+
   /**
    * Relaxation time
    */
@@ -98,10 +298,27 @@ class CollisionModel {
    */
   double c_;
 
+  /**
+   * Time step of the lattice model, kept here so the per-node kernels do not
+   * have to ask the lattice model for it at every node
+   */
+  double dt_;
+
   /**
    * Square of speed of sound in lattice, used to simplify computations in the
    * collision step
    */
   double cs_sqr_ = c_ * c_ / 3.0;
+
+  /**
+   * Lattice velocity stored as one plane per dimension, filled by
+   * GatherVelocity(). Sized once so slabs can fill it concurrently
+   */
+  std::vector<double> velocity_planes_;
+
+  /**
+   * Nodes collided by CollideAndStream(), nullptr if every node is collided
+   */
+  std::shared_ptr<const SparseLattice> sparse_;
 };
 #endif  // COLLISION_MODEL_HPP_
@@ -2,7 +2,9 @@
 #define COLLISION_NS_HPP_
 #include <vector>
 #include "CollisionModel.hpp"
+#include "LatticeField.hpp"
 #include "LatticeModel.hpp"
+#include "StreamModel.hpp"
 
 class CollisionNS: public CollisionModel {
  public:
@@ -36,27 +38,183 @@ class CollisionNS: public CollisionModel {
   /**
    * Calculated velocity for NS equation without body force based on formula in
    * Guo2002
-   * \param df 2D vector containing distribution functions of the NS
-   *        equation
+   * \param df distribution functions of the NS equation
    * \return 2D vector containing velocity at each node of lattice
    */
-  virtual std::vector<std::vector<double>> ComputeU(
-      const std::vector<std::vector<double>> &df);
+  std::vector<std::vector<double>> ComputeU(const LatticeField &df);
+
+  /**
+   * Calculated velocity for NS equation without body force based on formula in
+   * Guo2002, writes into an existing vector so stepping does not allocate
+   * \param df distribution functions of the NS equation
+   * \param result 2D vector which receives the velocity at each node of
+   *        lattice, must have one value per node and dimension
+   */
+  void ComputeU(const LatticeField &df
+    , std::vector<std::vector<double>> &result);
+
+  /**
+   * Calculated velocity for the nodes of a slab of rows, see ComputeU()
+   * \param df distribution functions of the NS equation
+   * \param result 2D vector which receives the velocity at each node of
+   *        lattice, only the nodes of the slab are written
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  virtual void ComputeU(const LatticeField &df
+    , std::vector<std::vector<double>> &result
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  using CollisionModel::ComputeMacroscopicProperties;
+  using CollisionModel::Collide;
+  using CollisionModel::CollideAndStream;
 
   /**
    * Computes the macroscopic properties based on the collision model used, both
    * velocity and density in this case. Based on "Discrete lattice effects on
    * the forcing term in the lattice Boltzmann method"
-   * \param df lattice distribution functions stored row-wise in a 2D vector
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void ComputeMacroscopicProperties(const LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Collides according to Guo2002, with the vectorized kernel for double
+   * precision storage
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  virtual void Collide(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Computes density and velocity, collides according to Guo2002 and streams
+   * each node of a slab of rows in a single pass
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
    */
-  void ComputeMacroscopicProperties(
-      const std::vector<std::vector<double>> &df);
+  virtual void CollideAndStream(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm
+    , std::size_t first_row
+    , std::size_t last_row);
 
+
+  /**
+   * Computes density and velocity of a node from its distribution functions
+   * and relaxes them towards their equilibrium, the per-node kernel of the
+   * fused pass. Defined in the header so CollideAndStream() and
+   * LatticeBoltzmannEngine inline it into the streaming loop
+   * \param n index of the node in the lattice
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values unless the node is skipped
+   */
+  template <typename Lattice>
+  void CollideNode(std::size_t n
+    , double *node);
+
+  /**
+   * Per-node kernel which also hands the velocity of the node to the caller,
+   * see CollideNode()
+   * \param n index of the node in the lattice
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values unless the node is skipped
+   * \param u receives the Lattice::nd components of the velocity of the node,
+   *        which is also stored in the lattice model
+   */
+  template <typename Lattice>
+  void CollideNode(std::size_t n
+    , double *node
+    , double *u);
+
+ protected:
   /**
-   * Collides according to Guo2002
-   * \param lattice 2D vector containing distribution functions
+   * Computes the velocity for the velocity set described by Lattice, see
+   * ComputeU()
+   * \param df distribution functions of the NS equation
+   * \param result 2D vector which receives the velocity at each node
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
    */
-  virtual void Collide(std::vector<std::vector<double>> &lattice);
+  template <typename Lattice>
+  void ComputeUKernel(const LatticeField &df
+    , std::vector<std::vector<double>> &result
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Fused collide and stream pass for the velocity set described by Lattice,
+   * see CollideAndStream()
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideAndStreamKernel(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Relaxes the raw planes of a field in the plain layout towards the
+   * equilibrium, the shift of each plane is added back so the relaxation is
+   * done in double precision. Double precision storage goes through the
+   * vectorized SimdCollideNS() instead
+   * \tparam T storage type of df
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename T>
+  void RelaxKernel(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
 };
 
+template <typename Lattice>
+void CollisionNS::CollideNode(std::size_t n
+  , double *node)
+{
+  double u[Lattice::nd];
+  CollideNode<Lattice>(n, node, u);
+}
+
+template <typename Lattice>
+void CollisionNS::CollideNode(std::size_t n
+  , double *node
+  , double *u)
+{
+  auto rho_node = 0.0;
+  for (auto i = 0u; i < Lattice::nq; ++i) rho_node += node[i];
+  for (auto d = 0u; d < Lattice::nd; ++d) {
+    u[d] = FirstMoment<Lattice>(node, d, c_);
+    u[d] /= rho_node;
+  }  // d
+  rho[n] = rho_node;
+  for (auto d = 0u; d < Lattice::nd; ++d) lm_.u[n][d] = u[d];
+  if (skip[n]) return;
+  auto u_sqr = 0.0;
+  for (auto d = 0u; d < Lattice::nd; ++d) u_sqr += u[d] * u[d];
+  u_sqr /= 2.0 * cs_sqr_;
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    const auto c_dot_u = DotVelocity<Lattice>(i, u, c_) / cs_sqr_;
+    const auto edf_i = Lattice::omega[i] * rho_node * (1.0 + c_dot_u *
+        (1.0 + c_dot_u / 2.0) - u_sqr);
+    node[i] += (edf_i - node[i]) / tau_;
+  }  // i
+}
 #endif  // COLLISION_NS_HPP_
@@ -2,6 +2,9 @@
 #define COLLISION_NSF_HPP_
 #include <vector>
 #include "CollisionNS.hpp"
+#include "LatticeField.hpp"
+#include "SparseSource.hpp"
+#include "StreamModel.hpp"
 
 class CollisionNSF: public CollisionNS {
  public:
@@ -36,32 +39,235 @@ class CollisionNSF: public CollisionNS {
 
   /**
    * Calculated velocity for NS equation based on formula in
-   * Guo2002
-   * \param df 2D vector containing distribution functions of the NS
-   *        equation
-   * \return 2D vector containing velocity at each node of lattice
+   * Guo2002 for the nodes of a slab of rows
+   * \param df distribution functions of the NS equation
+   * \param result 2D vector which receives the velocity at each node of
+   *        lattice, only the nodes of the slab are written
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
    */
-  std::vector<std::vector<double>> ComputeU(
-      const std::vector<std::vector<double>> &df);
+  void ComputeU(const LatticeField &df
+    , std::vector<std::vector<double>> &result
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  using CollisionNS::ComputeU;
+  using CollisionNS::ComputeMacroscopicProperties;
+  using CollisionNS::Collide;
+  using CollisionNS::CollideAndStream;
 
   /**
    * Computes the macroscopic properties based on the collision model used, both
    * velocity and density in this case. Based on "Discrete lattice effects on
    * the forcing term in the lattice Boltzmann method"
-   * \param df lattice distribution functions stored row-wise in a 2D vector
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void ComputeMacroscopicProperties(const LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Collides and applies force according to Guo2002, with the vectorized
+   * kernel for double precision storage
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void Collide(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Computes density and velocity with the force correction, collides and
+   * applies force according to Guo2002 and streams each node of a slab of rows
+   * in a single pass
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void CollideAndStream(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Toggles between adding the forcing term at every node and only at the
+   * nodes of a SparseSource. Unforced nodes are then collided with the plain
+   * BGK kernel and InitSource() only visits the old and the new source nodes,
+   * the result is unchanged. The nodes are collected from source when sparse
+   * sources are switched on. Derived collision models keep applying the
+   * forcing term at every node
+   */
+  void ToggleSparseSource();
+
+  /**
+   * Collects the nodes with a nonzero source again, needed after source is
+   * written directly while sparse sources are on, e.g., by
+   * ImmersedBoundaryMethod::SpreadForce(). Does nothing otherwise
    */
-  void ComputeMacroscopicProperties(
-      const std::vector<std::vector<double>> &df);
+  void UpdateSourceNodes();
 
   /**
-   * Collides and applies force according to Guo2002
-   * \param lattice 2D vector containing distribution functions
+   * Gets the nodes at which the forcing term is added
+   * \return source nodes, nullptr if the forcing term is added at every node
    */
-  void Collide(std::vector<std::vector<double>> &lattice);
+  const SparseSource* GetSourceNodes() const;
 
   /**
    * Source term for NS equation stored row-wise
    */
   std::vector<std::vector<double>> source;
+
+
+  /**
+   * Computes density and velocity with the force correction of a node,
+   * collides and applies force according to Guo2002, the per-node kernel of
+   * the fused pass, see CollisionNS::CollideNode()
+   * \param n index of the node in the lattice
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values unless the node is skipped
+   */
+  template <typename Lattice>
+  void CollideNode(std::size_t n
+    , double *node);
+
+  /**
+   * Per-node kernel which also hands the velocity of the node to the caller,
+   * so a coupled lattice can collide the same node with it straight away, see
+   * CollideNode()
+   * \param n index of the node in the lattice
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values unless the node is skipped
+   * \param u receives the Lattice::nd components of the velocity of the node,
+   *        which is also stored in the lattice model
+   */
+  template <typename Lattice>
+  void CollideNode(std::size_t n
+    , double *node
+    , double *u);
+
+ protected:
+  /**
+   * Computes the velocity with the force correction for the velocity set
+   * described by Lattice, see ComputeU()
+   * \param df distribution functions of the NS equation
+   * \param result 2D vector which receives the velocity at each node
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void ComputeUKernel(const LatticeField &df
+    , std::vector<std::vector<double>> &result
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Collides and applies force for the velocity set described by Lattice
+   * through the accessor, used for single precision storage, see Collide()
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideKernel(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Fused collide and stream pass for the velocity set described by Lattice,
+   * see CollideAndStream()
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideAndStreamKernel(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Collides the nodes of a slab of rows with the plain BGK kernel and then
+   * the source nodes of the slab with the forcing term, see Collide()
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void CollideSourceNodes(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Source term stored as one plane per dimension for the vectorized
+   * collision kernel, gathered from source before each collision
+   */
+  std::vector<double> source_planes_;
+
+  /**
+   * Boolean toggle to indicate if the forcing term is only added at the nodes
+   * of source_nodes_
+   */
+  bool is_sparse_source_;
+
+  /**
+   * Nodes with a source, kept up to date while sparse sources are on
+   */
+  SparseSource source_nodes_;
 };
+
+template <typename Lattice>
+void CollisionNSF::CollideNode(std::size_t n
+  , double *node)
+{
+  double u[Lattice::nd];
+  CollideNode<Lattice>(n, node, u);
+}
+
+template <typename Lattice>
+void CollisionNSF::CollideNode(std::size_t n
+  , double *node
+  , double *u)
+{
+  if (is_sparse_source_ && !source_nodes_.IsSourceNode(n)) {
+    CollisionNS::CollideNode<Lattice>(n, node, u);
+    return;
+  }
+  auto rho_node = 0.0;
+  for (auto i = 0u; i < Lattice::nq; ++i) rho_node += node[i];
+  for (auto d = 0u; d < Lattice::nd; ++d) {
+    u[d] = FirstMoment<Lattice>(node, d, c_);
+    u[d] += 0.5 * dt_ * source[n][d] * rho_node;
+    u[d] /= rho_node;
+  }  // d
+  rho[n] = rho_node;
+  for (auto d = 0u; d < Lattice::nd; ++d) lm_.u[n][d] = u[d];
+  if (skip[n]) return;
+  auto u_sqr = 0.0;
+  for (auto d = 0u; d < Lattice::nd; ++d) u_sqr += u[d] * u[d];
+  u_sqr /= 2.0 * cs_sqr_;
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    const auto c_dot_u = DotVelocity<Lattice>(i, u, c_) / cs_sqr_;
+    const auto edf_i = Lattice::omega[i] * rho_node * (1.0 + c_dot_u *
+        (1.0 + c_dot_u / 2.0) - u_sqr);
+    auto src_dot_product = 0.0;
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      const auto e_id = Lattice::e[i][d] * c_;
+      src_dot_product += (e_id - u[d] + c_dot_u * e_id) * source[n][d];
+    }  // d
+    src_dot_product /= cs_sqr_ / rho_node;
+    const auto src_i = (1.0 - 0.5 / tau_) * Lattice::omega[i] *
+        src_dot_product;
+    node[i] += (edf_i - node[i]) / tau_ + dt_ * src_i;
+  }  // i
+}
 #endif  // COLLISION_NSF_HPP_
@@ -0,0 +1,219 @@
+#ifndef COLLISION_TRT_HPP_
+#define COLLISION_TRT_HPP_
+#include <vector>
+#include "CollisionNSF.hpp"
+#include "LatticeField.hpp"
+#include "LatticeModel.hpp"
+#include "StreamModel.hpp"
+
+class CollisionTRT: public CollisionNSF {
+ public:
+  /**
+   * Constructor: Creates two-relaxation-time collision model for NS equation
+   * with body force and the same density at each node, based on "Two-
+   * relaxation-time Lattice Boltzmann scheme: About parametrization, velocity,
+   * pressure and mixed boundary conditions" Ginzburg2008. The symmetric part
+   * of the distribution functions relaxes with the BGK relaxation time, which
+   * sets the viscosity. The antisymmetric part relaxes with a second
+   * relaxation time chosen through the magic parameter, which keeps the
+   * scheme stable as the first one approaches 0.5, so the same Reynolds number
+   * runs on a coarser lattice than with BGK
+   * \param lm lattice model used for simulation
+   * \param source_position source positions
+   * \param source_strength source strengths
+   * \param kinematic_viscosity kinematic viscosity
+   * \param magic_parameter (tau_plus - 0.5) * (tau_minus - 0.5), 1/4 for best
+   *        stability, 3/16 puts the wall of halfway bounceback exactly halfway
+   *        between the nodes
+   * \param initial_density_f initial density of NS lattice
+   */
+  CollisionTRT(LatticeModel &lm
+    , const std::vector<std::vector<std::size_t>> &source_position
+    , const std::vector<std::vector<double>> &source_strength
+    , double kinematic_viscosity
+    , double magic_parameter
+    , double initial_density_f);
+
+  /**
+   * Destructor
+   */
+  ~CollisionTRT() = default;
+
+  using CollisionNSF::Collide;
+  using CollisionNSF::CollideAndStream;
+
+  /**
+   * Collides the symmetric and antisymmetric parts of the distribution
+   * functions with their own relaxation times and applies the Guo forcing
+   * term split the same way, with the vectorized kernel for double precision
+   * storage
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void Collide(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Computes density and velocity with the force correction, collides with
+   * two relaxation times and streams each node of a slab of rows in a single
+   * pass
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void CollideAndStream(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Gets the relaxation time of the antisymmetric part, GetRelaxationTime()
+   * is the one of the symmetric part
+   * \return relaxation time of the antisymmetric part
+   */
+  double GetAntisymmetricRelaxationTime() const;
+
+  /**
+   * Computes density and velocity with the force correction of a node and
+   * collides it with two relaxation times, the per-node kernel of the fused
+   * pass, see CollisionNSF::CollideNode()
+   * \param n index of the node in the lattice
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values unless the node is skipped
+   */
+  template <typename Lattice>
+  void CollideNode(std::size_t n
+    , double *node);
+
+  /**
+   * Per-node kernel which also hands the velocity of the node to the caller,
+   * see CollisionNSF::CollideNode()
+   * \param n index of the node in the lattice
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values unless the node is skipped
+   * \param u receives the Lattice::nd components of the velocity of the node,
+   *        which is also stored in the lattice model
+   */
+  template <typename Lattice>
+  void CollideNode(std::size_t n
+    , double *node
+    , double *u);
+
+ protected:
+  /**
+   * Collides through the accessor, used for single precision storage, see
+   * Collide()
+   * \param df lattice distribution functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideKernel(LatticeField &df
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Fused collide and stream pass for the velocity set described by Lattice,
+   * see CollideAndStream()
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param sm stream model which pushes the post-collision values
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice>
+  void CollideAndStreamKernel(LatticeField &df
+    , LatticeField &df_next
+    , const StreamModel &sm
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  /**
+   * Relaxes the non-equilibrium part of a node with two relaxation times and
+   * adds the forcing term
+   * \param node Lattice::nq distribution functions of the node, replaced by
+   *        their post-collision values
+   * \param neq non-equilibrium part of each distribution function
+   * \param src Guo forcing term of each discrete direction before it is
+   *        scaled by the relaxation
+   */
+  template <typename Lattice>
+  void RelaxNode(double *node
+    , const double *neq
+    , const double *src) const;
+
+  /**
+   * Relaxation time of the antisymmetric part of the distribution functions
+   */
+  double tau_minus_;
+};
+
+template <typename Lattice>
+void CollisionTRT::CollideNode(std::size_t n
+  , double *node)
+{
+  double u[Lattice::nd];
+  CollideNode<Lattice>(n, node, u);
+}
+
+template <typename Lattice>
+void CollisionTRT::CollideNode(std::size_t n
+  , double *node
+  , double *u)
+{
+  auto rho_node = 0.0;
+  for (auto i = 0u; i < Lattice::nq; ++i) rho_node += node[i];
+  for (auto d = 0u; d < Lattice::nd; ++d) {
+    u[d] = FirstMoment<Lattice>(node, d, c_);
+    u[d] += 0.5 * dt_ * source[n][d] * rho_node;
+    u[d] /= rho_node;
+  }  // d
+  rho[n] = rho_node;
+  for (auto d = 0u; d < Lattice::nd; ++d) lm_.u[n][d] = u[d];
+  if (skip[n]) return;
+  auto u_sqr = 0.0;
+  for (auto d = 0u; d < Lattice::nd; ++d) u_sqr += u[d] * u[d];
+  u_sqr /= 2.0 * cs_sqr_;
+  double neq[Lattice::nq];
+  double src[Lattice::nq];
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    const auto c_dot_u = DotVelocity<Lattice>(i, u, c_) / cs_sqr_;
+    const auto edf_i = Lattice::omega[i] * rho_node * (1.0 + c_dot_u *
+        (1.0 + c_dot_u / 2.0) - u_sqr);
+    auto src_dot_product = 0.0;
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      const auto e_id = Lattice::e[i][d] * c_;
+      src_dot_product += (e_id - u[d] + c_dot_u * e_id) * source[n][d];
+    }  // d
+    src_dot_product /= cs_sqr_ / rho_node;
+    neq[i] = node[i] - edf_i;
+    src[i] = Lattice::omega[i] * src_dot_product;
+  }  // i
+  RelaxNode<Lattice>(node, neq, src);
+}
+
+template <typename Lattice>
+void CollisionTRT::RelaxNode(double *node
+  , const double *neq
+  , const double *src) const
+{
+  const auto factor_plus = 1.0 - 0.5 / tau_;
+  const auto factor_minus = 1.0 - 0.5 / tau_minus_;
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    const auto j = Lattice::opposite[i];
+    const auto neq_plus = 0.5 * (neq[i] + neq[j]);
+    const auto neq_minus = 0.5 * (neq[i] - neq[j]);
+    const auto src_plus = 0.5 * (src[i] + src[j]);
+    const auto src_minus = 0.5 * (src[i] - src[j]);
+    node[i] += dt_ * (factor_plus * src_plus + factor_minus * src_minus) -
+        (neq_plus / tau_ + neq_minus / tau_minus_);
+  }  // i
+}
+#endif  // COLLISION_TRT_HPP_
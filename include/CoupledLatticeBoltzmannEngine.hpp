@@ -0,0 +1,132 @@
+#ifndef COUPLED_LATTICE_BOLTZMANN_ENGINE_HPP_
+#define COUPLED_LATTICE_BOLTZMANN_ENGINE_HPP_
+#include <cstddef>  // std::size_t
+#include <stdexcept>  // std::runtime_error
+#include <type_traits>  // std::is_same
+#include <utility>  // std::swap
+#include "LatticeBoltzmannEngine.hpp"
+
+/**
+ * Time stepping of an NS lattice and the CD lattice it carries, e.g., the
+ * lattices of SimulateNSCDCoupling, with a single collide and stream pass over
+ * both instead of one pass per lattice. Each node of the NS lattice is
+ * collided and its velocity is handed straight to the collision of the same
+ * node of the CD lattice instead of being read back from LatticeModel::u, so
+ * both lattices are read and written in the same sweep over memory. Steps are
+ * identical to calling TakeStep() of the NS lattice and then of the CD
+ * lattice, as long as no boundary condition of the CD lattice reads the
+ * velocity before collision. Every node is collided, a sparse lattice of
+ * either collision model is not used
+ * \tparam Flow LatticeBoltzmannEngine of the NS lattice, its collision model
+ *         provides CollideNode<Lattice>(n, node, u) which returns the velocity
+ *         in u
+ * \tparam Scalar LatticeBoltzmannEngine of the CD lattice, its collision model
+ *         provides CollideNode<Lattice>(n, node, u) which takes the velocity
+ *         from u and IsFlowFrozen()
+ */
+template <typename Flow
+  , typename Scalar>
+class CoupledLatticeBoltzmannEngine {
+ public:
+  /**
+   * Constructor: Couples two lattices which share the lattice model and
+   * stream the same way. The collide and stream pass runs on the thread pool
+   * of the NS lattice, if it has one
+   * \param f lattice of the NS equation
+   * \param g lattice of the CD equation, has to have the same storage
+   *        precision as f
+   */
+  CoupledLatticeBoltzmannEngine(Flow &f
+    , Scalar &g)
+    : f_ (f),
+      g_ (g)
+  {
+    static_assert(std::is_same<typename Flow::LatticeType,
+        typename Scalar::LatticeType>::value, "Velocity sets differ");
+    if (&f.lm_ != &g.lm_) throw std::runtime_error("Lattice model mismatch");
+    if (f.sm_.periodic_x != g.sm_.periodic_x ||
+        f.sm_.periodic_y != g.sm_.periodic_y ||
+        f.sm_.in_place != g.sm_.in_place) {
+      throw std::runtime_error("Stream model mismatch");
+    }
+  }
+
+  /**
+   * Copy constructor, the copy steps the same lattices
+   */
+  CoupledLatticeBoltzmannEngine(const CoupledLatticeBoltzmannEngine&) =
+      default;
+
+  /**
+   * The lattices are held by reference so the coupling cannot be reassigned
+   */
+  CoupledLatticeBoltzmannEngine& operator=(
+      const CoupledLatticeBoltzmannEngine&) = delete;
+
+  /**
+   * Performs one cycle of the evolution equation of both lattices with a
+   * single collide and stream pass. The boundary conditions of the NS lattice
+   * are updated before those of the CD lattice at each point of the step.
+   * Once the collision model of the CD lattice has frozen the flow, see
+   * CollisionCD::ToggleFrozenFlow(), only the CD lattice is stepped
+   */
+  void TakeStep()
+  {
+    if (g_.cm_.IsFlowFrozen()) {
+      g_.TakeStep();
+      return;
+    }
+    typedef typename Flow::LatticeType Lattice;
+    using Phase = typename Flow::Phase;
+    using ScalarPhase = typename Scalar::Phase;
+    const auto ny = f_.lm_.GetNumberOfRows();
+    const auto is_in_place = f_.sm_.in_place;
+    f_.template UpdateBoundaries<0>(Phase::BeforeCollision);
+    g_.template UpdateBoundaries<0>(ScalarPhase::BeforeCollision);
+    const auto pass = [this](std::size_t first_row, std::size_t last_row) {
+      f_.sm_.template CollideAndStream<Lattice>(f_.df, f_.df_next_, g_.df,
+          g_.df_next_, first_row, last_row, nullptr,
+          [this](std::size_t n, double *node_f, double *node_g) {
+        double u[Lattice::nd];
+        f_.cm_.template CollideNode<Lattice>(n, node_f, u);
+        g_.cm_.template CollideNode<Lattice>(n, node_g, u);
+      });
+    };
+    if (f_.pool_) {
+      f_.pool_->ParallelFor(ny, pass);
+    }
+    else {
+      pass(0, ny);
+    }
+    f_.sm_.FinishCollideAndStream(f_.df);
+    g_.sm_.FinishCollideAndStream(g_.df);
+    if (is_in_place) {
+      f_.df.SetPostCollisionView(true);
+      g_.df.SetPostCollisionView(true);
+    }
+    f_.template UpdateBoundaries<0>(Phase::AfterCollision);
+    g_.template UpdateBoundaries<0>(ScalarPhase::AfterCollision);
+    if (is_in_place) {
+      f_.df.SetPostCollisionView(false);
+      g_.df.SetPostCollisionView(false);
+    }
+    else {
+      std::swap(f_.df, f_.df_next_);
+      std::swap(g_.df, g_.df_next_);
+    }
+    f_.template UpdateBoundaries<0>(Phase::AfterStream);
+    g_.template UpdateBoundaries<0>(ScalarPhase::AfterStream);
+  }
+
+ private:
+  /**
+   * Lattice of the NS equation
+   */
+  Flow &f_;
+
+  /**
+   * Lattice of the CD equation
+   */
+  Scalar &g_;
+};
+#endif  // COUPLED_LATTICE_BOLTZMANN_ENGINE_HPP_
@@ -1,10 +1,15 @@
 #ifndef LATTICE_BOLTZMANN_HPP_
 #define LATTICE_BOLTZMANN_HPP_
+#include <cstddef>  // std::size_t
+#include <functional>
+#include <memory>  // std::shared_ptr
 #include <vector>
 #include "BoundaryNodes.hpp"
 #include "CollisionModel.hpp"
+#include "LatticeField.hpp"
 #include "LatticeModel.hpp"
 #include "StreamModel.hpp"
+#include "ThreadPool.hpp"
 
 class LatticeBoltzmann {
  public:
@@ -21,6 +26,37 @@ class LatticeBoltzmann {
     , CollisionModel &cm
     , StreamModel &sm);
 
+  /**
+   * Constructor: Creates a LatticeBoltzmann object which splits the lattice
+   * into contiguous slabs of rows, one per thread, and performs the
+   * collision, streaming and macroscopic property updates of each slab on its
+   * own thread. The results are identical to the single-threaded ones
+   * \param lm lattice model which contains information on the number of rows,
+   *        columns, dimensions, discrete directions and lattice velocity
+   * \param cm collision model used by the lattice
+   * \param sm stream model used by the lattice
+   * \param num_threads number of threads, at least 1
+   */
+  LatticeBoltzmann(LatticeModel &lm
+    , CollisionModel &cm
+    , StreamModel &sm
+    , std::size_t num_threads);
+
+  /**
+   * Constructor: Creates a LatticeBoltzmann object which runs its slabs on an
+   * existing thread pool, so that several lattices, e.g., the NS and CD
+   * lattices of a coupled simulation, can share the same threads
+   * \param lm lattice model which contains information on the number of rows,
+   *        columns, dimensions, discrete directions and lattice velocity
+   * \param cm collision model used by the lattice
+   * \param sm stream model used by the lattice
+   * \param pool thread pool, has to outlive the LatticeBoltzmann object
+   */
+  LatticeBoltzmann(LatticeModel &lm
+    , CollisionModel &cm
+    , StreamModel &sm
+    , ThreadPool &pool);
+
   /**
    * Destructor
    */
@@ -39,16 +75,138 @@ class LatticeBoltzmann {
 
   /**
    * Performs one cycle of evolution equation, computes the relevant macroscopic
-   * properties such as velocity and density
+   * properties such as velocity and density. The sweeps over the lattice are
+   * split across the threads, boundary conditions only touch the edges of the
+   * lattice and are updated by the calling thread in between the sweeps
    */
   void TakeStep();
 
   /**
-   * Lattice distribution function stored row-wise in a 2D vector.
+   * Performs num_steps cycles of the evolution equation with the same results
+   * as calling TakeStep() num_steps times. With the fused kernel and a
+   * stream model which does not stream in place and is not periodic in y,
+   * the lattice is cut into bands of rows and several time steps are
+   * performed as a wavefront: step s collides and streams a band three bands
+   * behind step s - 1, so the bands stay in cache between the steps of a
+   * block instead of the whole lattice passing through memory once per step.
+   * Boundary nodes are updated band by band as soon as the streamed values of
+   * their band are final. With a thread pool the steps of a block work on
+   * their bands concurrently. Streaming which is periodic in y couples the
+   * first and last rows, so it falls back to TakeStep() like streaming in
+   * place and the separate sweeps
+   * \param num_steps number of time steps
+   */
+  void Advance(std::size_t num_steps);
+
+  /**
+   * Sets the shape of the wavefront used by Advance()
+   * \param depth number of time steps per block, 1 to disable temporal
+   *        blocking, 0 for at least 4 and one step per thread
+   * \param band_rows number of rows per band, 0 to fit the bands of a block
+   *        in cache based on the number of columns
+   */
+  void SetTemporalBlocking(std::size_t depth
+    , std::size_t band_rows);
+
+  /**
+   * Toggles between the separate collide and stream sweeps and the fused
+   * kernel, which collides and streams each node in a single pass without
+   * storing the equilibrium distribution function. With the fused kernel the
+   * density and velocity of the collision model describe the lattice at the
+   * start of the last step, a coupled lattice which reads the velocity after
+   * this step therefore sees it one step behind. Stream models which stream
+   * in place always use the fused kernel
+   */
+  void ToggleFusedKernel();
+
+  /**
+   * Toggles between storing the distribution functions in double and single
+   * precision. Single precision halves the memory traffic of the kernels,
+   * which pays off most with the fused kernel. The stored values are shifted
+   * by the rest equilibrium of the current mean density so only their
+   * deviation from it is rounded, density and velocity are still accumulated
+   * in double precision
+   */
+  void ToggleSinglePrecision();
+
+  /**
+   * Toggles between visiting every node with the fused kernel and visiting
+   * only the fluid nodes and the skipped nodes next to them, see
+   * CollisionModel::ToggleSparseLattice(). Time then scales with the fluid
+   * volume instead of the size of the lattice. The separate sweeps still visit
+   * every node
+   */
+  void ToggleSparseLattice();
+
+  /**
+   * Gets the lattice model of the lattice
+   * \return lattice model
+   */
+  LatticeModel& GetLatticeModel();
+
+  /**
+   * Gets the lattice model of the lattice
+   * \return lattice model
    */
-  std::vector<std::vector<double>> df;
+  const LatticeModel& GetLatticeModel() const;
+
+  /**
+   * Gets the collision model of the lattice
+   * \return collision model
+   */
+  const CollisionModel& GetCollisionModel() const;
+
+  /**
+   * Gets the stream model of the lattice
+   * \return stream model
+   */
+  const StreamModel& GetStreamModel() const;
+
+  /**
+   * Gets the boundary conditions added to the lattice, in the order they are
+   * updated
+   * \return pointers to the boundary conditions
+   */
+  const std::vector<BoundaryNodes*>& GetBoundaryNodes() const;
+
+  /**
+   * Gets the threads which share the sweeps over the lattice
+   * \return thread pool, nullptr for a single-threaded lattice
+   */
+  const ThreadPool* GetThreadPool() const;
+
+  /**
+   * Gets the memory held for the distribution functions of the lattice: df,
+   * the buffer it streams into and the equilibrium distribution function of
+   * its collision model. Streaming in place needs no buffer and only the
+   * separate sweeps store the equilibrium
+   * \return number of bytes
+   */
+  std::size_t GetNumberOfBytes() const;
+
+  /**
+   * Lattice distribution function stored as one contiguous plane per
+   * discrete direction
+   */
+  LatticeField df;
 
  private:
+  /**
+   * Calls task once for each slab of rows, on the thread pool if there is one
+   * and for the whole lattice otherwise
+   * \param task called as task(first_row, last_row)
+   */
+  void ForEachSlab(const std::function<void(std::size_t, std::size_t)> &task);
+
+  /**
+   * Performs depth time steps as a wavefront over bands of rows, see
+   * Advance()
+   * \param depth number of time steps
+   * \param band_rows number of rows per band
+   */
+  void AdvanceBlock(std::size_t depth
+    , std::size_t band_rows);
+
   // 6  2  5  ^
   //  \ | /   |
   // 3--0--1  |
@@ -94,5 +252,35 @@ class LatticeBoltzmann {
    * references
    */
   std::vector<BoundaryNodes*> bn_;
+
+  /**
+   * Buffer which receives the streamed distribution functions, swapped with
+   * df after every step so the two buffers ping-pong without allocating.
+   * Left empty when the stream model streams in place
+   */
+  LatticeField df_next_;
+
+  /**
+   * Boolean toggle to indicate if the fused collide and stream kernel is used
+   */
+  bool is_fused_;
+
+  /**
+   * Threads which share the sweeps over the lattice, empty for a
+   * single-threaded lattice. Shared so copies of the lattice use the same
+   * threads, a pool passed in by the caller is not owned
+   */
+  std::shared_ptr<ThreadPool> pool_;
+
+  /**
+   * Number of time steps per wavefront block of Advance(), 0 to pick it based
+   * on the number of threads
+   */
+  std::size_t block_depth_;
+
+  /**
+   * Number of rows per band of Advance(), 0 to pick it based on the cache size
+   */
+  std::size_t band_rows_;
 };
 #endif  // LATTICE_BOLTZMANN_HPP_
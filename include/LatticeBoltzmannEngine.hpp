@@ -0,0 +1,225 @@
+#ifndef LATTICE_BOLTZMANN_ENGINE_HPP_
+#define LATTICE_BOLTZMANN_ENGINE_HPP_
+#include <cstddef>  // std::size_t
+#include <tuple>
+#include <type_traits>  // std::enable_if
+#include <utility>  // std::swap
+#include "LatticeField.hpp"
+#include "LatticeModel.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ * Time stepping of a lattice whose collision model, stream model and
+ * boundary conditions are fixed at compile time. The per-node kernel of the
+ * collision model is inlined into the streaming loop and the boundary
+ * conditions are called through their concrete types, so a step makes no
+ * virtual calls. Steps are identical to the fused kernel of LatticeBoltzmann,
+ * which keeps choosing the models at run time through their base classes
+ * \tparam Lattice velocity set, see LatticeDescriptor.hpp
+ * \tparam Collision collision model, provides CollideNode<Lattice>()
+ * \tparam Stream stream model
+ * \tparam Boundaries boundary conditions, updated in the order given
+ */
+template <typename Lattice
+  , typename Collision
+  , typename Stream
+  , typename... Boundaries>
+class LatticeBoltzmannEngine {
+ public:
+  /**
+   * Constructor: Creates a lattice which starts from the equilibrium
+   * distribution functions of the collision model
+   * \param lm lattice model which contains information on the number of rows,
+   *        columns, dimensions, discrete directions and lattice velocity
+   * \param cm collision model used by the lattice
+   * \param sm stream model used by the lattice
+   * \param bn boundary conditions of the lattice
+   */
+  LatticeBoltzmannEngine(LatticeModel &lm
+    , Collision &cm
+    , Stream &sm
+    , Boundaries&... bn)
+    : df (cm.ComputeEqField()),
+      lm_ (lm),
+      cm_ (cm),
+      sm_ (sm),
+      bn_ {&bn...},
+      df_next_ (sm.in_place ? 0 : df.GetNumberOfNodes(),
+          df.GetNumberOfDirections()),
+      pool_ {nullptr}
+  {}
+
+  /**
+   * Constructor: Creates a lattice which runs its slabs on a thread pool,
+   * see LatticeBoltzmann
+   * \param lm lattice model which contains information on the number of rows,
+   *        columns, dimensions, discrete directions and lattice velocity
+   * \param cm collision model used by the lattice
+   * \param sm stream model used by the lattice
+   * \param pool thread pool, has to outlive the lattice
+   * \param bn boundary conditions of the lattice
+   */
+  LatticeBoltzmannEngine(LatticeModel &lm
+    , Collision &cm
+    , Stream &sm
+    , ThreadPool &pool
+    , Boundaries&... bn)
+    : LatticeBoltzmannEngine(lm, cm, sm, bn...)
+  {
+    pool_ = &pool;
+  }
+
+  /**
+   * Copy constructor, the copy shares the models and the thread pool
+   */
+  LatticeBoltzmannEngine(const LatticeBoltzmannEngine&) = default;
+
+  /**
+   * The models are held by reference so the lattice cannot be reassigned
+   */
+  LatticeBoltzmannEngine& operator=(const LatticeBoltzmannEngine&) = delete;
+
+  /**
+   * Performs one cycle of the evolution equation with a single collide and
+   * stream pass, see LatticeBoltzmann::TakeStep() with the fused kernel
+   */
+  void TakeStep()
+  {
+    const auto ny = lm_.GetNumberOfRows();
+    UpdateBoundaries<0>(Phase::BeforeCollision);
+    const auto pass = [this](std::size_t first_row, std::size_t last_row) {
+      sm_.template CollideAndStream<Lattice>(df, df_next_, first_row,
+          last_row, cm_.GetSparseLattice(),
+          [this](std::size_t n, double *node) {
+        cm_.template CollideNode<Lattice>(n, node);
+      });
+    };
+    if (pool_) {
+      pool_->ParallelFor(ny, pass);
+    }
+    else {
+      pass(0, ny);
+    }
+    sm_.FinishCollideAndStream(df);
+    if (sm_.in_place) df.SetPostCollisionView(true);
+    UpdateBoundaries<0>(Phase::AfterCollision);
+    if (sm_.in_place) {
+      df.SetPostCollisionView(false);
+    }
+    else {
+      std::swap(df, df_next_);
+    }
+    UpdateBoundaries<0>(Phase::AfterStream);
+  }
+
+  /**
+   * Lattice distribution function stored as one contiguous plane per
+   * discrete direction
+   */
+  LatticeField df;
+
+ private:
+  /**
+   * Steps a pair of lattices with a single pass, see
+   * CoupledLatticeBoltzmannEngine
+   */
+  template <typename Flow, typename Scalar>
+  friend class CoupledLatticeBoltzmannEngine;
+
+  /**
+   * Velocity set of the lattice
+   */
+  typedef Lattice LatticeType;
+
+  /**
+   * Points of the step at which boundary conditions are updated
+   */
+  enum class Phase {
+    BeforeCollision,
+    AfterCollision,
+    AfterStream
+  };
+
+  /**
+   * Updates the boundary conditions from the I-th on which belong to a phase
+   * of the step, the same as the boundary updates of
+   * LatticeBoltzmann::TakeStep()
+   * \tparam I index of the first boundary condition to update
+   * \param phase point of the step
+   */
+  template <std::size_t I>
+  typename std::enable_if<I < sizeof...(Boundaries)>::type
+  UpdateBoundaries(Phase phase)
+  {
+    using Boundary = typename std::tuple_element<I,
+        std::tuple<Boundaries...>>::type;
+    auto &bdr = *std::get<I>(bn_);
+    const auto ny = lm_.GetNumberOfRows();
+    // qualified calls skip the virtual dispatch
+    switch (phase) {
+      case Phase::BeforeCollision: {
+        if (bdr.prestream && !bdr.during_stream) {
+          bdr.Boundary::UpdateNodes(df, false, 0, ny);
+        }
+        break;
+      }
+      case Phase::AfterCollision: {
+        if (bdr.prestream && bdr.during_stream) {
+          bdr.Boundary::UpdateNodes(df, false, 0, ny);
+        }
+        break;
+      }
+      case Phase::AfterStream: {
+        if (bdr.during_stream) bdr.Boundary::UpdateNodes(df, true, 0, ny);
+        if (!bdr.prestream) bdr.Boundary::UpdateNodes(df, false, 0, ny);
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+    UpdateBoundaries<I + 1>(phase);
+  }
+
+  /**
+   * Ends the recursion over the boundary conditions
+   */
+  template <std::size_t I>
+  typename std::enable_if<I == sizeof...(Boundaries)>::type
+  UpdateBoundaries(Phase)
+  {}
+
+  /**
+   * Lattice model which contains information on the number of rows, columns,
+   * dimensions, discrete directions and lattice velocity
+   */
+  LatticeModel &lm_;
+
+  /**
+   * Collision model
+   */
+  Collision &cm_;
+
+  /**
+   * Stream model
+   */
+  Stream &sm_;
+
+  /**
+   * Pointers to the boundary conditions
+   */
+  std::tuple<Boundaries*...> bn_;
+
+  /**
+   * Buffer which receives the streamed distribution functions, left empty
+   * when the stream model streams in place
+   */
+  LatticeField df_next_;
+
+  /**
+   * Threads which share the collide and stream pass, nullptr for a
+   * single-threaded lattice. Not owned
+   */
+  ThreadPool *pool_;
+};
+#endif  // LATTICE_BOLTZMANN_ENGINE_HPP_
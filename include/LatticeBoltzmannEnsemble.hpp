@@ -0,0 +1,224 @@
+#ifndef LATTICE_BOLTZMANN_ENSEMBLE_HPP_
+#define LATTICE_BOLTZMANN_ENSEMBLE_HPP_
+#include <cstddef>  // std::size_t
+#include <vector>
+#include "CollisionNS.hpp"
+#include "CollisionNSF.hpp"
+#include "LatticeBoltzmann.hpp"
+#include "LatticeField.hpp"
+
+class LatticeBoltzmannEnsemble {
+ public:
+  /**
+   * Constructor: Creates an empty ensemble of independent lattices of the same
+   * geometry, e.g., the runs of a parameter sweep. Each member is set up as an
+   * ordinary LatticeBoltzmann object with its own lattice model, collision
+   * model and boundary conditions, so members can differ in relaxation time,
+   * source strength or inlet velocity. The ensemble stores the distribution
+   * functions of all members interleaved, the values of the members at a node
+   * in a discrete direction are contiguous, so the collision kernel runs
+   * across the members and one vector instruction updates several members at
+   * once. A step of the ensemble is identical to TakeStep() of each member
+   * with the fused kernel
+   */
+  LatticeBoltzmannEnsemble();
+
+  /**
+   * Adds a member which solves the NS equation, its current distribution
+   * functions are the starting point of the member
+   * \param f lattice of the member, the distribution functions have to be
+   *        stored in double precision and the stream model cannot stream in
+   *        place
+   * \param ns collision model of f, models derived from CollisionNS collide
+   *        differently and are rejected
+   */
+  void AddMember(LatticeBoltzmann &f
+    , CollisionNS &ns);
+
+  /**
+   * Adds a member which solves the NS equation with a body force, the source
+   * term is read when the member is added
+   * \param f lattice of the member, the distribution functions have to be
+   *        stored in double precision and the stream model cannot stream in
+   *        place
+   * \param nsf collision model of f, models derived from CollisionNSF
+   *        collide differently and are rejected
+   */
+  void AddMember(LatticeBoltzmann &f
+    , CollisionNSF &nsf);
+
+  /**
+   * Performs one cycle of the evolution equation of every member: collides
+   * all members in a single pass, then streams them. The boundary conditions
+   * of each member update its own lattice. Only the values they can touch are
+   * copied over, the skipped nodes before collision and the nodes of the two
+   * outermost rows and columns afterwards, which covers the boundary
+   * conditions in this library
+   */
+  void TakeStep();
+
+  /**
+   * Copies the distribution functions, density and velocity of every member
+   * back to its lattice, collision model and lattice model, so the results of
+   * a member can be written with the Results registered for it. As with the
+   * fused kernel, density and velocity describe the lattice at the start of
+   * the last step
+   */
+  void UpdateMembers();
+
+  /**
+   * Gets the number of members
+   * \return number of members
+   */
+  std::size_t GetNumberOfMembers() const;
+
+ private:
+  /**
+   * Points of the step at which boundary conditions are updated
+   */
+  enum class Phase {
+    BeforeCollision,
+    AfterCollision,
+    AfterStream
+  };
+
+  /**
+   * Checks that a new member fits the ensemble and repacks the values of all
+   * members
+   * \param f lattice of the member
+   * \param ns collision model of f
+   * \param source body force of each node, nullptr without body force
+   */
+  void AddMember(LatticeBoltzmann &f
+    , CollisionNS &ns
+    , const std::vector<std::vector<double>> *source);
+
+  /**
+   * Updates the boundary conditions of every member which belong to a phase
+   * of the step, the same as the boundary updates of
+   * LatticeBoltzmann::TakeStep() with the fused kernel
+   * \param phase point of the step
+   */
+  void UpdateBoundaries(Phase phase);
+
+  /**
+   * Collides each node of every member, computing density and velocity from
+   * the values of the node first, see CollisionNS::CollideNode() and
+   * CollisionNSF::CollideNode()
+   * \tparam IsForced Boolean toggle to apply the body force
+   */
+  template <typename Lattice, bool IsForced>
+  void CollideKernel();
+
+  /**
+   * Lattices of the members
+   */
+  std::vector<LatticeBoltzmann*> members_;
+
+  /**
+   * Collision models of the members
+   */
+  std::vector<CollisionNS*> collisions_;
+
+  /**
+   * Body force of each member, nullptr for a member without body force
+   */
+  std::vector<const std::vector<std::vector<double>>*> sources_;
+
+  /**
+   * Number of columns of the lattice of each member
+   */
+  std::size_t nx_;
+
+  /**
+   * Number of rows of the lattice of each member
+   */
+  std::size_t ny_;
+
+  /**
+   * Lattice speed, shared by the members
+   */
+  double c_;
+
+  /**
+   * Square of the speed of sound in the lattice
+   */
+  double cs_sqr_;
+
+  /**
+   * Time step, shared by the members
+   */
+  double dt_;
+
+  /**
+   * Boolean toggle to indicate if streaming is periodic across the left and
+   * right edges, shared by the members
+   */
+  bool periodic_x_;
+
+  /**
+   * Boolean toggle to indicate if streaming is periodic across the bottom and
+   * top edges, shared by the members
+   */
+  bool periodic_y_;
+
+  /**
+   * Boolean toggle to indicate if any member has a body force
+   */
+  bool is_forced_;
+
+  /**
+   * Distribution functions of all members, node n of member k is stored at
+   * n * K + k of each plane for K members
+   */
+  LatticeField df_;
+
+  /**
+   * Buffer which receives the streamed distribution functions
+   */
+  LatticeField df_next_;
+
+  /**
+   * Density of all members, interleaved like df_
+   */
+  std::vector<double> rho_;
+
+  /**
+   * Velocity of all members, one plane per dimension interleaved like df_
+   */
+  std::vector<double> velocity_;
+
+  /**
+   * Body force of all members, one plane per dimension interleaved like df_,
+   * empty if no member has a body force
+   */
+  std::vector<double> source_;
+
+  /**
+   * Relaxation time of each member
+   */
+  std::vector<double> tau_;
+
+  /**
+   * Square of the velocity of each member at the node being collided
+   */
+  std::vector<double> u_sqr_;
+
+  /**
+   * Skips the collision of a node, the same for every member
+   */
+  std::vector<char> skip_;
+
+  /**
+   * Nodes which are not collided, copied to the members for the boundary
+   * conditions updated before collision
+   */
+  std::vector<std::size_t> skipped_nodes_;
+
+  /**
+   * Nodes of the two outermost rows and columns, copied to the members for
+   * the boundary conditions updated after collision and after streaming
+   */
+  std::vector<std::size_t> edge_nodes_;
+};
+#endif  // LATTICE_BOLTZMANN_ENSEMBLE_HPP_
@@ -0,0 +1,123 @@
+#ifndef LATTICE_BOLTZMANN_MULTI_RATE_HPP_
+#define LATTICE_BOLTZMANN_MULTI_RATE_HPP_
+#include <cstddef>  // std::size_t
+#include <vector>
+#include "LatticeBoltzmann.hpp"
+
+class LatticeBoltzmannMultiRate {
+ public:
+  /**
+   * Constructor: Couples an NS lattice and the CD lattice it advects when the
+   * two equations are stepped at different rates. Each lattice keeps its own
+   * lattice model, so the CD lattice can have its own time step and its own
+   * space step. One time step has to be an integer multiple of the other: the
+   * CD lattice takes k steps per NS step, or one step per k NS steps, and
+   * the slower equation only costs as much as its own steps. The CD lattice
+   * reads its velocity from its own lattice model, which is filled from the
+   * velocity of the NS lattice before every CD step: interpolated linearly in
+   * time between the NS steps when the CD lattice is faster, averaged over
+   * the NS steps when it is slower, and interpolated bilinearly in space when
+   * the space steps differ. With the same time and space steps a step is
+   * identical to TakeStep() of the NS lattice and then of the CD lattice
+   * advected by the velocity of the NS lattice
+   * \param f lattice of the NS equation, its lattice model supplies the
+   *        velocity
+   * \param g lattice of the CD equation, its collision model has to read the
+   *        velocity of the lattice model of g and the nodes of g have to lie
+   *        within the extent of f
+   */
+  LatticeBoltzmannMultiRate(LatticeBoltzmann &f
+    , LatticeBoltzmann &g);
+
+  /**
+   * Advances both lattices by the longer of their time steps
+   */
+  void TakeStep();
+
+  /**
+   * Gets the time covered by TakeStep()
+   * \return longer of the two time steps
+   */
+  double GetTimeStep() const;
+
+  /**
+   * Gets the number of steps of the NS lattice per TakeStep()
+   * \return number of NS steps
+   */
+  std::size_t GetNumberOfFlowSteps() const;
+
+  /**
+   * Gets the number of steps of the CD lattice per TakeStep()
+   * \return number of CD steps
+   */
+  std::size_t GetNumberOfScalarSteps() const;
+
+ private:
+  /**
+   * Interpolates a velocity field of the NS lattice to the nodes of the CD
+   * lattice
+   * \param u_f velocity of the NS lattice, one value per node and dimension
+   * \param u_g receives the velocity of the CD lattice, one plane per
+   *        dimension
+   */
+  void Interpolate(const std::vector<std::vector<double>> &u_f
+    , std::vector<double> &u_g) const;
+
+  /**
+   * Sets the velocity of the CD lattice to a point in time between
+   * u_start_ and u_end_
+   * \param weight weight of u_end_, 0 at the start and 1 at the end
+   */
+  void SetScalarVelocity(double weight);
+
+  /**
+   * Lattice of the NS equation
+   */
+  LatticeBoltzmann &f_;
+
+  /**
+   * Lattice of the CD equation
+   */
+  LatticeBoltzmann &g_;
+
+  /**
+   * Number of NS steps per TakeStep()
+   */
+  std::size_t flow_steps_;
+
+  /**
+   * Number of CD steps per TakeStep()
+   */
+  std::size_t scalar_steps_;
+
+  /**
+   * Four nodes of the NS lattice around each node of the CD lattice, lower
+   * left, lower right, upper left and upper right
+   */
+  std::vector<std::size_t> stencil_;
+
+  /**
+   * Bilinear interpolation weights of each node of the CD lattice, the
+   * weight of the right and of the upper nodes of its stencil
+   */
+  std::vector<double> stencil_weights_;
+
+  /**
+   * Velocity of the NS lattice on the CD lattice at the start of TakeStep(),
+   * one plane per dimension
+   */
+  std::vector<double> u_start_;
+
+  /**
+   * Velocity of the NS lattice on the CD lattice at the end of TakeStep(), or
+   * its average over the NS steps when the CD lattice is slower
+   */
+  std::vector<double> u_end_;
+
+  /**
+   * Sum of the velocity of the NS lattice over its steps, used when the CD
+   * lattice is slower
+   */
+  std::vector<std::vector<double>> u_sum_;
+};
+#endif  // LATTICE_BOLTZMANN_MULTI_RATE_HPP_
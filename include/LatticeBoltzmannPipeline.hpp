@@ -0,0 +1,66 @@
+#ifndef LATTICE_BOLTZMANN_PIPELINE_HPP_
+#define LATTICE_BOLTZMANN_PIPELINE_HPP_
+#include <cstddef>  // std::size_t
+#include "LatticeBoltzmann.hpp"
+#include "ThreadPool.hpp"
+
+class LatticeBoltzmannPipeline {
+ public:
+  /**
+   * Constructor: Couples an NS lattice and the CD lattice it advects so the
+   * two lattices are stepped on separate threads. Step t of the CD lattice
+   * only needs the velocity of step t of the NS lattice, so it overlaps with
+   * step t + 1 of the NS lattice. The velocity is double-buffered: the NS
+   * lattice writes the velocity of its own lattice model while the CD
+   * lattice reads a snapshot held in its lattice model, and the snapshot is
+   * refreshed between two stages of the pipeline. The results are identical
+   * to TakeStep() of the NS lattice and then of the CD lattice advected by
+   * the velocity of the NS lattice
+   * \param f lattice of the NS equation, its lattice model supplies the
+   *        velocity
+   * \param g lattice of the CD equation, has its own lattice model with the
+   *        size of the lattice model of f and its collision model has to read
+   *        the velocity of that lattice model. Both lattices can have thread
+   *        pools of their own but cannot share one
+   */
+  LatticeBoltzmannPipeline(LatticeBoltzmann &f
+    , LatticeBoltzmann &g);
+
+  /**
+   * Performs one time step of both lattices, there is nothing to overlap
+   * with so the lattices are stepped one after the other
+   */
+  void TakeStep();
+
+  /**
+   * Performs num_steps time steps of both lattices. Step t + 1 of the NS
+   * lattice runs on a second thread while step t of the CD lattice runs on
+   * the calling thread, so the pipeline is filled by the first NS step and
+   * drained by the last CD step and both lattices are in step on return
+   * \param num_steps number of time steps
+   */
+  void Advance(std::size_t num_steps);
+
+ private:
+  /**
+   * Copies the velocity of the NS lattice to the lattice model of the CD
+   * lattice
+   */
+  void UpdateVelocity();
+
+  /**
+   * Lattice of the NS equation
+   */
+  LatticeBoltzmann &f_;
+
+  /**
+   * Lattice of the CD equation
+   */
+  LatticeBoltzmann &g_;
+
+  /**
+   * Two threads, one for each stage of the pipeline
+   */
+  ThreadPool pool_;
+};
+#endif  // LATTICE_BOLTZMANN_PIPELINE_HPP_
@@ -0,0 +1,203 @@
+#ifndef LATTICE_BOLTZMANN_SPECIES_HPP_
+#define LATTICE_BOLTZMANN_SPECIES_HPP_
+#include <cstddef>  // std::size_t
+#include <vector>
+#include "CollisionCD.hpp"
+#include "LatticeBoltzmann.hpp"
+#include "LatticeField.hpp"
+#include "SparseSource.hpp"
+
+class LatticeBoltzmannSpecies {
+ public:
+  /**
+   * Constructor: Creates an empty set of solutes which are advected by the
+   * same velocity field, e.g., the species of a multi-species convection-
+   * diffusion run coupled to one NS lattice. Each species is set up as an
+   * ordinary LatticeBoltzmann object with its own lattice model, CD collision
+   * model and boundary conditions, so species can differ in diffusion
+   * coefficient and sources. The distribution functions of all species are
+   * stored interleaved like LatticeBoltzmannEnsemble, the velocity dependent
+   * factors of the equilibrium and the source term are computed once per node
+   * and the collision runs across the species, then all species are streamed
+   * in one pass. A step is identical to TakeStep() of each species with the
+   * fused kernel
+   */
+  LatticeBoltzmannSpecies();
+
+  /**
+   * Adds a species, its current distribution functions are the starting point
+   * of the species. The source term is read from cd every step, so sources
+   * can be changed between steps as with a single CD lattice
+   * \param g lattice of the species, the distribution functions have to be
+   *        stored in double precision and the stream model cannot stream in
+   *        place
+   * \param cd collision model of g, has to be advected by the same velocity
+   *        field as the other species
+   */
+  void AddSpecies(LatticeBoltzmann &g
+    , CollisionCD &cd);
+
+  /**
+   * Performs one cycle of the evolution equation of every species: collides
+   * all species in a single pass, then streams them. The boundary conditions
+   * of each species update its own lattice. Only the values they can touch are
+   * copied over, the skipped nodes before collision and the nodes of the two
+   * outermost rows and columns afterwards, see
+   * LatticeBoltzmannEnsemble::TakeStep()
+   */
+  void TakeStep();
+
+  /**
+   * Copies the distribution functions and density of every species back to
+   * its lattice and collision model, so the results of a species can be
+   * written with the Results registered for it. As with the fused kernel,
+   * density describes the lattice at the start of the last step
+   */
+  void UpdateSpecies();
+
+  /**
+   * Gets the number of species
+   * \return number of species
+   */
+  std::size_t GetNumberOfSpecies() const;
+
+ private:
+  /**
+   * Points of the step at which boundary conditions are updated
+   */
+  enum class Phase {
+    BeforeCollision,
+    AfterCollision,
+    AfterStream
+  };
+
+  /**
+   * Updates the boundary conditions of every species which belong to a phase
+   * of the step, the same as the boundary updates of
+   * LatticeBoltzmann::TakeStep() with the fused kernel
+   * \param phase point of the step
+   */
+  void UpdateBoundaries(Phase phase);
+
+  /**
+   * Collides each node of every species, computing density from the values
+   * of the node first, see CollisionCD::CollideNode()
+   */
+  template <typename Lattice>
+  void CollideKernel();
+
+  /**
+   * Lattices of the species
+   */
+  std::vector<LatticeBoltzmann*> species_;
+
+  /**
+   * Collision models of the species, the velocity of the first one advects
+   * every species
+   */
+  std::vector<CollisionCD*> collisions_;
+
+  /**
+   * Number of columns of the lattice of each species
+   */
+  std::size_t nx_;
+
+  /**
+   * Number of rows of the lattice of each species
+   */
+  std::size_t ny_;
+
+  /**
+   * Number of discrete directions of the lattice of each species
+   */
+  std::size_t nq_;
+
+  /**
+   * Lattice speed, shared by the species
+   */
+  double c_;
+
+  /**
+   * Square of the speed of sound in the lattice
+   */
+  double cs_sqr_;
+
+  /**
+   * Time step, shared by the species
+   */
+  double dt_;
+
+  /**
+   * Boolean toggle to indicate if streaming is periodic across the left and
+   * right edges, shared by the species
+   */
+  bool periodic_x_;
+
+  /**
+   * Boolean toggle to indicate if streaming is periodic across the bottom and
+   * top edges, shared by the species
+   */
+  bool periodic_y_;
+
+  /**
+   * Distribution functions of all species, node n of species k is stored at
+   * n * K + k of each plane for K species
+   */
+  LatticeField df_;
+
+  /**
+   * Buffer which receives the streamed distribution functions
+   */
+  LatticeField df_next_;
+
+  /**
+   * Density of all species, interleaved like df_
+   */
+  std::vector<double> rho_;
+
+  /**
+   * Relaxation time of each species
+   */
+  std::vector<double> tau_;
+
+  /**
+   * Weight of the velocity term of the source, 1 - 1 / (2 tau), of each
+   * species
+   */
+  std::vector<double> source_weight_;
+
+  /**
+   * Source of each species at the node being collided
+   */
+  std::vector<double> source_;
+
+  /**
+   * Nodes at which the source of each species is added, nullptr for every
+   * node, read at the start of each collision pass
+   */
+  std::vector<const SparseSource*> source_nodes_;
+
+  /**
+   * Boolean toggle of each species to indicate if its source is cleared once
+   * it has been added, read at the start of each collision pass
+   */
+  std::vector<char> is_instant_;
+
+  /**
+   * Skips the collision of a node, the same for every species
+   */
+  std::vector<char> skip_;
+
+  /**
+   * Nodes which are not collided, copied to the species for the boundary
+   * conditions updated before collision
+   */
+  std::vector<std::size_t> skipped_nodes_;
+
+  /**
+   * Nodes of the two outermost rows and columns, copied to the species for
+   * the boundary conditions updated after collision and after streaming
+   */
+  std::vector<std::size_t> edge_nodes_;
+};
+#endif  // LATTICE_BOLTZMANN_SPECIES_HPP_
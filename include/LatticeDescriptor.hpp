@@ -0,0 +1,212 @@
+#ifndef LATTICE_DESCRIPTOR_HPP_
+#define LATTICE_DESCRIPTOR_HPP_
+#include <cmath>  // std::sqrt
+#include <cstddef>  // std::size_t
+
+/**
+ * Compile-time descriptors of the discrete velocity sets. Kernels take the
+ * descriptor as a template parameter so the loops over the discrete
+ * directions have a constant trip count and fully unroll, and the velocity
+ * and weight lookups fold into constants. Velocities are in lattice units,
+ * multiply by the lattice speed to obtain the values stored in
+ * LatticeModel::e. The arrays are defined in LatticeDescriptor.cpp since they
+ * are odr-used when indexed at run time
+ */
+
+/**
+ * D2Q9 velocity set with the ordering used throughout the code: rest, the
+ * four axis directions E, N, W, S, then the diagonals NE, NW, SW, SE
+ */
+struct D2Q9 {
+  /**
+   * Number of dimensions
+   */
+  static constexpr std::size_t nd = 2;
+
+  /**
+   * Number of discrete directions
+   */
+  static constexpr std::size_t nq = 9;
+
+  /**
+   * Discrete velocities in lattice units
+   */
+  static constexpr int e[nq][nd] = {{0, 0},
+      {1, 0}, {0, 1}, {-1, 0}, {0, -1},
+      {1, 1}, {-1, 1}, {-1, -1}, {1, -1}};
+
+  /**
+   * Weights of the equilibrium distribution function
+   */
+  static constexpr double omega[nq] = {16.0 / 36.0,
+      4.0 / 36.0, 4.0 / 36.0, 4.0 / 36.0, 4.0 / 36.0,
+      1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0};
+
+  /**
+   * Index of the discrete direction opposite to each direction
+   */
+  static constexpr std::size_t opposite[nq] = {0, 3, 4, 1, 2, 7, 8, 5, 6};
+
+  /**
+   * Orthogonal moment basis of "Theory of the lattice Boltzmann method:
+   * Dispersion, dissipation, isotropy, Galilean invariance, and stability"
+   * Lallemand2000, one row per moment: density, energy, energy square,
+   * x-momentum, x-heat flux, y-momentum, y-heat flux and the two stresses
+   */
+  static constexpr int moment[nq][nq] = {
+      {1, 1, 1, 1, 1, 1, 1, 1, 1},
+      {-4, -1, -1, -1, -1, 2, 2, 2, 2},
+      {4, -2, -2, -2, -2, 1, 1, 1, 1},
+      {0, 1, 0, -1, 0, 1, -1, -1, 1},
+      {0, -2, 0, 2, 0, 1, -1, -1, 1},
+      {0, 0, 1, 0, -1, 1, 1, -1, -1},
+      {0, 0, -2, 0, 2, 1, 1, -1, -1},
+      {0, 1, -1, 1, -1, 0, 0, 0, 0},
+      {0, 0, 0, 0, 0, 1, -1, 1, -1}};
+
+  /**
+   * Squared norm of each row of the moment basis, the inverse of the basis is
+   * its transpose with each column divided by the norm of its row
+   */
+  static constexpr double moment_norm[nq] = {9.0, 36.0, 36.0, 6.0, 12.0, 6.0,
+      12.0, 4.0, 4.0};
+};
+
+/**
+ * D2Q5 velocity set: rest, then the four axis directions E, N, W, S. Enough
+ * for the convection-diffusion equation. The directions are the first five
+ * directions of D2Q9 in the same order
+ */
+struct D2Q5 {
+  /**
+   * Number of dimensions
+   */
+  static constexpr std::size_t nd = 2;
+
+  /**
+   * Number of discrete directions
+   */
+  static constexpr std::size_t nq = 5;
+
+  /**
+   * Discrete velocities in lattice units
+   */
+  static constexpr int e[nq][nd] = {{0, 0},
+      {1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+
+  /**
+   * Weights of the equilibrium distribution function
+   */
+  static constexpr double omega[nq] = {1.0 / 3.0,
+      1.0 / 6.0, 1.0 / 6.0, 1.0 / 6.0, 1.0 / 6.0};
+
+  /**
+   * Index of the discrete direction opposite to each direction
+   */
+  static constexpr std::size_t opposite[nq] = {0, 3, 4, 1, 2};
+};
+
+/**
+ * D3Q19 velocity set: rest, the six axis directions, then the twelve edge
+ * diagonals. Each direction is directly followed by its opposite
+ */
+struct D3Q19 {
+  /**
+   * Number of dimensions
+   */
+  static constexpr std::size_t nd = 3;
+
+  /**
+   * Number of discrete directions
+   */
+  static constexpr std::size_t nq = 19;
+
+  /**
+   * Discrete velocities in lattice units
+   */
+  static constexpr int e[nq][nd] = {{0, 0, 0},
+      {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1},
+      {1, 1, 0}, {-1, -1, 0}, {1, 0, 1}, {-1, 0, -1}, {0, 1, 1}, {0, -1, -1},
+      {1, -1, 0}, {-1, 1, 0}, {1, 0, -1}, {-1, 0, 1}, {0, 1, -1}, {0, -1, 1}};
+
+  /**
+   * Weights of the equilibrium distribution function
+   */
+  static constexpr double omega[nq] = {1.0 / 3.0,
+      1.0 / 18.0, 1.0 / 18.0, 1.0 / 18.0, 1.0 / 18.0, 1.0 / 18.0, 1.0 / 18.0,
+      1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0,
+      1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0};
+
+  /**
+   * Index of the discrete direction opposite to each direction
+   */
+  static constexpr std::size_t opposite[nq] = {0, 2, 1, 4, 3, 6, 5, 8, 7, 10,
+      9, 12, 11, 14, 13, 16, 15, 18, 17};
+};
+
+/**
+ * Dot product of a scaled discrete velocity with a vector. Components of the
+ * discrete velocity which are zero are skipped, the check is on a constant
+ * once the loop over the directions is unrolled so it costs nothing
+ * \param i discrete direction
+ * \param u vector with Lattice::nd components
+ * \param c lattice speed which scales the discrete velocity
+ * \return dot product of c * Lattice::e[i] and u
+ */
+template <typename Lattice>
+inline double DotVelocity(std::size_t i
+  , const double *u
+  , double c)
+{
+  auto result = 0.0;
+  for (auto d = 0u; d < Lattice::nd; ++d) {
+    if (Lattice::e[i][d] != 0) result += Lattice::e[i][d] * c * u[d];
+  }  // d
+  return result;
+}
+
+/**
+ * Sums the values of a node weighted by a component of the scaled discrete
+ * velocities, i.e., the first moment of the node in dimension d
+ * \param node values of the node in each of the Lattice::nq directions
+ * \param d dimension
+ * \param c lattice speed which scales the discrete velocity
+ * \return first moment of node in dimension d
+ */
+template <typename Lattice>
+inline double FirstMoment(const double *node
+  , std::size_t d
+  , double c)
+{
+  auto result = 0.0;
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    if (Lattice::e[i][d] != 0) result += node[i] * (Lattice::e[i][d] * c);
+  }  // i
+  return result;
+}
+/**
+ * Frobenius norm of the second moment of a node built from the unscaled
+ * discrete velocities, sqrt(sum_ab P_ab * P_ab) with P_ab = sum_i e_ia * e_ib
+ * * node[i]. Applied to the non-equilibrium part of a node it is the magnitude
+ * of the non-equilibrium stress in lattice units
+ * \param node values of the node in each of the Lattice::nq directions
+ * \return norm of the second moment of node
+ */
+template <typename Lattice>
+inline double SecondMomentNorm(const double *node)
+{
+  auto result = 0.0;
+  for (auto a = 0u; a < Lattice::nd; ++a) {
+    for (auto b = a; b < Lattice::nd; ++b) {
+      auto moment = 0.0;
+      for (auto i = 0u; i < Lattice::nq; ++i) {
+        const auto e_iab = Lattice::e[i][a] * Lattice::e[i][b];
+        if (e_iab != 0) moment += e_iab * node[i];
+      }  // i
+      // the off-diagonal components appear twice in the sum
+      result += (a == b ? 1.0 : 2.0) * moment * moment;
+    }  // b
+  }  // a
+  return std::sqrt(result);
+}
+#endif  // LATTICE_DESCRIPTOR_HPP_
@@ -0,0 +1,497 @@
+#ifndef LATTICE_FIELD_HPP_
+#define LATTICE_FIELD_HPP_
+#include <vector>
+#include "AlignedAllocator.hpp"
+
+class StreamModel;
+
+class LatticeField {
+ public:
+  /**
+   * Proxy returned by the non-const operator() so the values can be read and
+   * written as double regardless of the storage precision
+   */
+  class Reference {
+   public:
+    /**
+     * Constructor
+     * \param field field which stores the value
+     * \param n index of the node in the plane which stores the value
+     * \param i plane which stores the value
+     */
+    Reference(LatticeField &field
+      , std::size_t n
+      , std::size_t i)
+      : field_ (field),
+        n_ {n},
+        i_ {i}
+    {}
+
+    /**
+     * Reads the value
+     * \return value in double precision
+     */
+    operator double() const
+    {
+      return field_.Load(n_, i_);
+    }
+
+    /**
+     * Writes the value
+     * \param value new value
+     * \return reference to the value
+     */
+    Reference& operator=(double value)
+    {
+      field_.Store(n_, i_, value);
+      return *this;
+    }
+
+    /**
+     * Writes the value of another reference, assigns the value and not the
+     * reference
+     * \param other reference to the new value
+     * \return reference to the value
+     */
+    Reference& operator=(const Reference &other)
+    {
+      return *this = static_cast<double>(other);
+    }
+
+    /**
+     * Adds to the value
+     * \param value value to add
+     * \return reference to the value
+     */
+    Reference& operator+=(double value)
+    {
+      return *this = static_cast<double>(*this) + value;
+    }
+
+    /**
+     * Subtracts from the value
+     * \param value value to subtract
+     * \return reference to the value
+     */
+    Reference& operator-=(double value)
+    {
+      return *this = static_cast<double>(*this) - value;
+    }
+
+    /**
+     * Swaps the values of two references, found through argument-dependent
+     * lookup since std::swap() needs lvalues
+     * \param a first value
+     * \param b second value
+     */
+    friend void swap(Reference a
+      , Reference b)
+    {
+      const double temp = a;
+      a = static_cast<double>(b);
+      b = temp;
+    }
+
+   private:
+    /**
+     * Field which stores the value
+     */
+    LatticeField &field_;
+
+    /**
+     * Index of the node in the plane which stores the value
+     */
+    std::size_t n_;
+
+    /**
+     * Plane which stores the value
+     */
+    std::size_t i_;
+  };
+
+  /**
+   * Constructor: Creates a lattice field with every value set to zero. Values
+   * are stored as structure-of-arrays, i.e., one plane per discrete direction
+   * with the nodes stored row-wise in each plane. All planes are kept in a
+   * single allocation and each plane starts on a cache line boundary. Values
+   * are stored in double precision until SetSinglePrecision() is called
+   * \param num_nodes number of nodes in the lattice
+   * \param num_dirs number of discrete directions of the lattice model
+   */
+  LatticeField(std::size_t num_nodes
+    , std::size_t num_dirs);
+
+  /**
+   * Constructor: Creates a lattice field from node values stored row-wise in
+   * a 2D vector
+   * \param nodes values of each node stored row-wise in a 2D vector
+   */
+  LatticeField(const std::vector<std::vector<double>> &nodes);
+
+  /**
+   * Destructor
+   */
+  ~LatticeField() = default;
+
+  /**
+   * Copy constructor
+   */
+  LatticeField(const LatticeField&) = default;
+
+  /**
+   * Move constructor, takes over the storage so std::swap() of two fields does
+   * not copy any values
+   */
+  LatticeField(LatticeField&&) = default;
+
+  /**
+   * Copy assignment
+   */
+  LatticeField& operator=(const LatticeField&) = default;
+
+  /**
+   * Move assignment
+   */
+  LatticeField& operator=(LatticeField&&) = default;
+
+  /**
+   * Accesses the value of a node in a discrete direction
+   * \param n index of the node in the lattice
+   * \param i discrete direction
+   * \return reference to the value
+   */
+  Reference operator()(std::size_t n
+    , std::size_t i)
+  {
+    Remap(n, i);
+    return Reference(*this, n, i);
+  }
+
+  /**
+   * Accesses the value of a node in a discrete direction
+   * \param n index of the node in the lattice
+   * \param i discrete direction
+   * \return value
+   */
+  double operator()(std::size_t n
+    , std::size_t i) const
+  {
+    Remap(n, i);
+    return Load(n, i);
+  }
+
+  /**
+   * Gets the plane of a discrete direction, the values of all the nodes are
+   * contiguous in memory so kernels can loop over them without indirection.
+   * The plane is raw storage and does not account for the layout set with
+   * SetLayout(). Only valid with double precision storage, kernels which
+   * support both precisions use Plane() instead
+   * \param i discrete direction
+   * \return pointer to the value of the first node in direction i
+   */
+  double* Direction(std::size_t i)
+  {
+    return data_.data() + i * stride_;
+  }
+
+  /**
+   * Gets the plane of a discrete direction
+   * \param i discrete direction
+   * \return pointer to the value of the first node in direction i
+   */
+  const double* Direction(std::size_t i) const
+  {
+    return data_.data() + i * stride_;
+  }
+
+  /**
+   * Gets the raw storage of the plane of a discrete direction
+   * \tparam T storage type, double or float, must match the precision of the
+   *         field
+   * \param i discrete direction
+   * \return pointer to the stored value of the first node in direction i,
+   *         add Shift(i) to obtain the value
+   */
+  template <typename T>
+  T* Plane(std::size_t i);
+
+  /**
+   * Gets the raw storage of the plane of a discrete direction
+   * \tparam T storage type, double or float, must match the precision of the
+   *         field
+   * \param i discrete direction
+   * \return pointer to the stored value of the first node in direction i
+   */
+  template <typename T>
+  const T* Plane(std::size_t i) const;
+
+  /**
+   * Gets the amount the values of a plane are shifted by before they are
+   * stored, zero with double precision storage
+   * \param i discrete direction
+   * \return shift of the plane
+   */
+  double Shift(std::size_t i) const
+  {
+    return is_single_ ? shift_[i] : 0.0;
+  }
+
+  /**
+   * Switches the storage precision, keeping the values. Single precision
+   * halves the memory traffic of the kernels. The values of plane i are then
+   * stored as float after subtracting shift[i], normally the rest
+   * equilibrium omega[i] * rho, so only the small deviation from it is
+   * rounded to single precision. Since in-place streaming may store a
+   * direction in the plane of its opposite direction, opposite directions
+   * need the same shift. Density and velocity are still accumulated in
+   * double precision
+   * \param is_single Boolean toggle to store the values in single precision
+   * \param shift amount subtracted from the values of each plane before they
+   *        are stored in single precision, ignored otherwise
+   */
+  void SetSinglePrecision(bool is_single
+    , const std::vector<double> &shift);
+
+  /**
+   * Checks if the values are stored in single precision
+   * \return TRUE: values are stored as float
+   *         FALSE: values are stored as double
+   */
+  bool IsSinglePrecision() const;
+
+  /**
+   * Gathers the values of a single node
+   * \param n index of the node in the lattice
+   * \return values of the node in each discrete direction
+   */
+  std::vector<double> GetNode(std::size_t n) const;
+
+  /**
+   * Gathers the values of a single node into an existing vector, does not
+   * allocate once node has the right size
+   * \param n index of the node in the lattice
+   * \param node vector which receives the values of the node in each discrete
+   *        direction
+   */
+  void GetNode(std::size_t n
+    , std::vector<double> &node) const;
+
+  /**
+   * Scatters values to a single node
+   * \param n index of the node in the lattice
+   * \param node values of the node in each discrete direction
+   */
+  void SetNode(std::size_t n
+    , const std::vector<double> &node);
+
+  /**
+   * Sets every node to the same values
+   * \param node values of the node in each discrete direction
+   */
+  void Assign(const std::vector<double> &node);
+
+  /**
+   * Gathers the values of all nodes, for output and printing
+   * \return values of each node stored row-wise in a 2D vector
+   */
+  std::vector<std::vector<double>> GetNodes() const;
+
+  /**
+   * Get the number of nodes stored in the field
+   * \return number of nodes
+   */
+  std::size_t GetNumberOfNodes() const;
+
+  /**
+   * Get the number of discrete directions stored in the field
+   * \return number of discrete directions
+   */
+  std::size_t GetNumberOfDirections() const;
+
+  /**
+   * Get the memory held by the values of the field, including the padding
+   * which aligns the planes
+   * \return number of bytes
+   */
+  std::size_t GetNumberOfBytes() const;
+
+  /**
+   * Sets the layout left behind by in-place streaming so that operator(),
+   * GetNode() and SetNode() keep returning the streamed values of each node
+   * \param sm stream model which streamed the field in place, nullptr for the
+   *        plain layout
+   * \param is_swapped Boolean toggle to indicate if the field holds the
+   *        values of an even step, i.e., the post-collision values of each
+   *        node stored at the same node in the opposite direction
+   */
+  void SetLayout(const StreamModel *sm
+    , bool is_swapped);
+
+  /**
+   * Toggles between accessing the streamed values and the post-collision
+   * values of each node, only valid directly after an in-place step. Used by
+   * boundary conditions which copy post-collision values
+   * \param is_post_collision Boolean toggle to access the post-collision
+   *        values
+   */
+  void SetPostCollisionView(bool is_post_collision);
+
+  /**
+   * Checks if the field holds the values of an even in-place streaming step
+   * \return TRUE: values are stored in the swapped layout
+   *         FALSE: values are stored in the plain layout
+   */
+  bool IsSwapped() const;
+
+  /**
+   * Checks if plane i holds the values of direction i of every node, i.e.,
+   * the field was not streamed in place, so kernels can use Direction() or
+   * Plane() in place of operator()
+   * \return TRUE: values are stored in the plain layout
+   *         FALSE: values are stored in the layout left behind by in-place
+   *         streaming
+   */
+  bool IsPlainLayout() const;
+
+ private:
+  /**
+   * Finds the plane and node which store a value, only differs from n and i
+   * for the layout left behind by in-place streaming
+   * \param n index of the node in the lattice, replaced by the index of the
+   *        node which stores the value
+   * \param i discrete direction, replaced by the plane which stores the value
+   */
+  void Remap(std::size_t &n
+    , std::size_t &i) const
+  {
+    if (stream_) RemapInPlace(n, i);
+  }
+
+  /**
+   * Finds the plane and node which store a value for the layout left behind
+   * by in-place streaming
+   * \param n index of the node in the lattice, replaced by the index of the
+   *        node which stores the value
+   * \param i discrete direction, replaced by the plane which stores the value
+   */
+  void RemapInPlace(std::size_t &n
+    , std::size_t &i) const;
+
+  /**
+   * Reads a stored value
+   * \param n index of the node in the plane
+   * \param i plane
+   * \return value in double precision
+   */
+  double Load(std::size_t n
+    , std::size_t i) const
+  {
+    const auto pos = i * stride_ + n;
+    return is_single_ ? shift_[i] + single_data_[pos] : data_[pos];
+  }
+
+  /**
+   * Stores a value
+   * \param n index of the node in the plane
+   * \param i plane
+   * \param value value in double precision
+   */
+  void Store(std::size_t n
+    , std::size_t i
+    , double value)
+  {
+    const auto pos = i * stride_ + n;
+    if (is_single_) {
+      single_data_[pos] = static_cast<float>(value - shift_[i]);
+    }
+    else {
+      data_[pos] = value;
+    }
+  }
+
+  /**
+   * Alignment of each plane in bytes, one cache line
+   */
+  static const std::size_t alignment_ = 64;
+
+  /**
+   * Number of nodes in the field
+   */
+  std::size_t number_of_nodes_;
+
+  /**
+   * Number of discrete directions in the field
+   */
+  std::size_t number_of_directions_;
+
+  /**
+   * Distance between the start of two consecutive planes, number of nodes
+   * rounded up to a whole number of cache lines
+   */
+  std::size_t stride_;
+
+  /**
+   * Values of all planes in a single aligned allocation, empty with single
+   * precision storage
+   */
+  std::vector<double, AlignedAllocator<double, alignment_>> data_;
+
+  /**
+   * Shifted values of all planes in single precision, empty with double
+   * precision storage
+   */
+  std::vector<float, AlignedAllocator<float, alignment_>> single_data_;
+
+  /**
+   * Amount subtracted from the values of each plane before they are stored
+   * in single precision
+   */
+  std::vector<double> shift_;
+
+  /**
+   * Boolean toggle to indicate if the values are stored in single precision
+   */
+  bool is_single_;
+
+  /**
+   * Stream model which streamed the field in place, nullptr for the plain
+   * layout
+   */
+  const StreamModel *stream_;
+
+  /**
+   * Boolean toggle to indicate if the field holds the values of an even
+   * in-place streaming step
+   */
+  bool is_swapped_;
+
+  /**
+   * Boolean toggle to indicate if the post-collision values are accessed
+   */
+  bool is_post_collision_;
+};
+
+template <>
+inline double* LatticeField::Plane<double>(std::size_t i)
+{
+  return data_.data() + i * stride_;
+}
+
+template <>
+inline const double* LatticeField::Plane<double>(std::size_t i) const
+{
+  return data_.data() + i * stride_;
+}
+
+template <>
+inline float* LatticeField::Plane<float>(std::size_t i)
+{
+  return single_data_.data() + i * stride_;
+}
+
+template <>
+inline const float* LatticeField::Plane<float>(std::size_t i) const
+{
+  return single_data_.data() + i * stride_;
+}
+#endif  // LATTICE_FIELD_HPP_
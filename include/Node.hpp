@@ -1,6 +1,6 @@
 #ifndef NODE_HPP_
 #define NODE_HPP_
-#include <vector>
+#include <cstddef>  // std::size_t
 class Node {
  public:
   /**
@@ -34,10 +34,5 @@ class Node {
    * Index in distribution function vector
    */
   std::size_t n;
-
-  /**
-   * Distribution functions of a single node, used by half-way bounceback nodes
-   */
-  std::vector<double> df_node;
 };
 #endif  // NODE_HPP_
@@ -0,0 +1,213 @@
+#ifndef SIMD_KERNELS_HPP_
+#define SIMD_KERNELS_HPP_
+#include <cstddef>  // std::size_t
+
+/**
+ * Vectorized collision kernels of the collision models. The kernels work
+ * on the raw double precision planes of a field in the plain layout and
+ * process 4 (AVX2) or 8 (AVX-512) nodes per instruction, the post-collision
+ * values of skipped nodes are masked out of the stores. The instruction set is
+ * picked at run time based on what the processor supports and falls back to
+ * scalar code, the remaining nodes of a plane are also handled by the scalar
+ * code. Every level performs the same operations in the same order as the
+ * scalar collision models so the results are identical
+ */
+
+/**
+ * Instruction set levels of the collision kernels, ordered from least to most
+ * capable
+ */
+enum class SimdLevel {
+  Scalar,
+  Avx2,
+  Avx512
+};
+
+/**
+ * Gets the most capable instruction set level supported by the processor
+ * \return supported instruction set level
+ */
+SimdLevel GetSupportedSimdLevel();
+
+/**
+ * Gets the instruction set level used by the collision kernels, the
+ * supported level unless it was lowered with SetSimdLevel()
+ * \return active instruction set level
+ */
+SimdLevel GetSimdLevel();
+
+/**
+ * Sets the instruction set level used by the collision kernels, mainly to
+ * compare the levels against each other
+ * \param level instruction set level, throws if the processor does not
+ *        support it
+ */
+void SetSimdLevel(SimdLevel level);
+
+/**
+ * Gets the name of an instruction set level for printing
+ * \param level instruction set level
+ * \return name of the level
+ */
+const char* GetSimdLevelName(SimdLevel level);
+
+/**
+ * Relaxes the distribution functions of the NS equation towards their
+ * equilibrium, see CollisionNS::Collide()
+ * \param num_nodes number of nodes in each plane
+ * \param df planes of the distribution functions, one per discrete direction
+ * \param edf planes of the equilibrium distribution functions
+ * \param skip nonzero for nodes which are not collided
+ * \param tau relaxation time
+ */
+template <typename Lattice>
+void SimdCollideNS(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , double tau);
+
+/**
+ * Relaxes the distribution functions of the NS equation with the Guo forcing
+ * term, see CollisionNSF::Collide()
+ * \param num_nodes number of nodes in each plane
+ * \param df planes of the distribution functions, one per discrete direction
+ * \param edf planes of the equilibrium distribution functions
+ * \param skip nonzero for nodes which are not collided
+ * \param u planes of the fluid velocity, one per dimension
+ * \param source planes of the body force, one per dimension
+ * \param rho density of each node
+ * \param tau relaxation time
+ * \param c lattice speed
+ * \param cs_sqr square of the speed of sound
+ * \param dt time step
+ */
+template <typename Lattice>
+void SimdCollideNSF(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , double tau
+  , double c
+  , double cs_sqr
+  , double dt);
+
+/**
+ * Relaxes the distribution functions of the CD equation and adds the source
+ * term, see CollisionCD::Collide()
+ * \param num_nodes number of nodes in each plane
+ * \param df planes of the distribution functions, one per discrete direction
+ * \param edf planes of the equilibrium distribution functions
+ * \param skip nonzero for nodes which are not collided
+ * \param u planes of the fluid velocity, one per dimension
+ * \param source source strength of each node
+ * \param tau relaxation time
+ * \param c lattice speed
+ * \param cs_sqr square of the speed of sound
+ * \param dt time step
+ */
+template <typename Lattice>
+void SimdCollideCD(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *source
+  , double tau
+  , double c
+  , double cs_sqr
+  , double dt);
+
+/**
+ * Relaxes the symmetric and antisymmetric parts of the distribution functions
+ * of the NS equation with separate relaxation times and splits the Guo
+ * forcing term the same way, see CollisionTRT::Collide()
+ * \param num_nodes number of nodes in each plane
+ * \param df planes of the distribution functions, one per discrete direction
+ * \param edf planes of the equilibrium distribution functions
+ * \param skip nonzero for nodes which are not collided
+ * \param u planes of the fluid velocity, one per dimension
+ * \param source planes of the body force, one per dimension
+ * \param rho density of each node
+ * \param tau_plus relaxation time of the symmetric part
+ * \param tau_minus relaxation time of the antisymmetric part
+ * \param c lattice speed
+ * \param cs_sqr square of the speed of sound
+ * \param dt time step
+ */
+template <typename Lattice>
+void SimdCollideTRT(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , double tau_plus
+  , double tau_minus
+  , double c
+  , double cs_sqr
+  , double dt);
+
+/**
+ * Relaxes the moments of the distribution functions of the NS equation, each
+ * at its own rate, and applies the Guo forcing term in moment space, see
+ * CollisionMRT::Collide()
+ * \param num_nodes number of nodes in each plane
+ * \param df planes of the distribution functions, one per discrete direction
+ * \param edf planes of the equilibrium distribution functions
+ * \param skip nonzero for nodes which are not collided
+ * \param u planes of the fluid velocity, one per dimension
+ * \param source planes of the body force, one per dimension
+ * \param rho density of each node
+ * \param rates relaxation rate of each moment of Lattice::moment
+ * \param c lattice speed
+ * \param cs_sqr square of the speed of sound
+ * \param dt time step
+ */
+template <typename Lattice>
+void SimdCollideMRT(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , const double *rates
+  , double c
+  , double cs_sqr
+  , double dt);
+/**
+ * Relaxes the distribution functions of the NS equation with the Guo forcing
+ * term and a relaxation time of each node enlarged by the Smagorinsky eddy
+ * viscosity, see CollisionLES::Collide()
+ * \param num_nodes number of nodes in each plane
+ * \param df planes of the distribution functions, one per discrete direction
+ * \param edf planes of the equilibrium distribution functions
+ * \param skip nonzero for nodes which are not collided
+ * \param u planes of the fluid velocity, one per dimension
+ * \param source planes of the body force, one per dimension
+ * \param rho density of each node
+ * \param tau relaxation time set by the molecular viscosity
+ * \param smagorinsky_factor 18 * sqrt(2) * C^2 for the Smagorinsky constant C
+ * \param c lattice speed
+ * \param cs_sqr square of the speed of sound
+ * \param dt time step
+ */
+template <typename Lattice>
+void SimdCollideLES(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , double tau
+  , double smagorinsky_factor
+  , double c
+  , double cs_sqr
+  , double dt);
+#endif  // SIMD_KERNELS_HPP_
@@ -0,0 +1,63 @@
+#ifndef SPARSE_LATTICE_HPP_
+#define SPARSE_LATTICE_HPP_
+#include <cstddef>  // std::size_t
+#include <vector>
+#include "LatticeModel.hpp"
+
+class SparseLattice {
+ public:
+  /**
+   * Constructor: Collects the nodes which take part in a time step when the
+   * skipped nodes are solid, i.e., the fluid nodes and the skipped nodes next
+   * to a fluid node. A skipped node surrounded by skipped nodes only exchanges
+   * values with other skipped nodes so nothing it sends ever reaches a fluid
+   * node. Neighbours are looked up across the lattice edges as if streaming
+   * were periodic so the nodes work for every stream model. The nodes of each
+   * row are stored as runs of consecutive columns, the storage of the lattice
+   * stays dense so the neighbours of a node are found with the usual offsets
+   * \param lm lattice model which contains information on the number of rows
+   *        and columns
+   * \param skip nonzero for the solid nodes, one value per node
+   */
+  SparseLattice(const LatticeModel &lm
+    , const std::vector<char> &skip);
+
+  /**
+   * Gets the runs of nodes in a row
+   * \param row row of the lattice
+   * \return GetNumberOfRuns(row) pairs of columns, the first column of a run
+   *         followed by one past its last column
+   */
+  const std::size_t* GetRuns(std::size_t row) const;
+
+  /**
+   * Gets the number of runs of nodes in a row
+   * \param row row of the lattice
+   * \return number of runs
+   */
+  std::size_t GetNumberOfRuns(std::size_t row) const;
+
+  /**
+   * Gets the number of nodes which take part in a time step
+   * \return number of nodes in all runs
+   */
+  std::size_t GetNumberOfNodes() const;
+
+ private:
+  /**
+   * Pairs of columns of all runs, row by row
+   */
+  std::vector<std::size_t> runs_;
+
+  /**
+   * Index of the first run of each row in runs_, one past the last row holds
+   * the total number of runs
+   */
+  std::vector<std::size_t> row_runs_;
+
+  /**
+   * Number of nodes in all runs
+   */
+  std::size_t num_nodes_;
+};
+#endif  // SPARSE_LATTICE_HPP_
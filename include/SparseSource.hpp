@@ -0,0 +1,68 @@
+#ifndef SPARSE_SOURCE_HPP_
+#define SPARSE_SOURCE_HPP_
+#include <cstddef>  // std::size_t
+#include <vector>
+
+class SparseSource {
+ public:
+  /**
+   * Constructor: Creates an empty set of source nodes. The collision models
+   * with a source term keep the source strengths in a dense vector, the set
+   * records which nodes carry a source so the collision only adds the source
+   * term at those nodes and clearing the sources only visits them
+   * \param num_nodes number of nodes in the lattice
+   */
+  explicit SparseSource(std::size_t num_nodes);
+
+  /**
+   * Replaces the nodes of the set, visits only the nodes of the old and the
+   * new set
+   * \param nodes indices of the nodes which carry a source, in any order and
+   *        possibly repeated
+   */
+  void Assign(std::vector<std::size_t> nodes);
+
+  /**
+   * Removes every node from the set, visits only the nodes of the set
+   */
+  void Clear();
+
+  /**
+   * Checks if a node carries a source
+   * \param n index of the node in the lattice
+   * \return TRUE if the node is in the set
+   */
+  bool IsSourceNode(std::size_t n) const;
+
+  /**
+   * Gets the nodes of the set
+   * \return indices of the nodes in ascending order
+   */
+  const std::vector<std::size_t>& GetNodes() const;
+
+  /**
+   * Finds the first node of the set which is not before a node, so the nodes
+   * of a slab of rows are GetNodes()[LowerBound(first_node)] up to
+   * GetNodes()[LowerBound(last_node)]
+   * \param n index of the node in the lattice
+   * \return position of the node in GetNodes()
+   */
+  std::size_t LowerBound(std::size_t n) const;
+
+ private:
+  /**
+   * Indices of the nodes of the set in ascending order
+   */
+  std::vector<std::size_t> nodes_;
+
+  /**
+   * Nonzero for the nodes of the set, one byte per node of the lattice
+   */
+  std::vector<char> is_source_node_;
+};
+
+inline bool SparseSource::IsSourceNode(std::size_t n) const
+{
+  return is_source_node_[n] != 0;
+}
+#endif  // SPARSE_SOURCE_HPP_
@@ -0,0 +1,64 @@
+#ifndef STREAM_AA_HPP_
+#define STREAM_AA_HPP_
+#include <vector>
+#include "LatticeField.hpp"
+#include "LatticeModel.hpp"
+#include "StreamModel.hpp"
+
+class StreamAA: public StreamModel {
+ public:
+  /**
+   * Constructor: Creates an in-place streaming model for the D2Q9 or D2Q5
+   * lattice model based on the AA access pattern. The lattice only keeps a
+   * single copy of the distribution functions, alternating between the plain
+   * and swapped layouts every time step, see StreamModel::CollideInPlace()
+   * \param lm lattice model which contains information on the number of rows,
+   *        columns, dimensions, discrete directions and lattice velocity
+   * \param is_periodic Boolean toggle to indicate if there are periodic
+   *        boundary conditions on all edges and corners. Otherwise
+   *        distribution functions which stream off the lattice bounce back
+   *        into the same node
+   */
+  StreamAA(LatticeModel &lm
+    , bool is_periodic);
+
+  /**
+   * Constructor: Creates an in-place streaming model for the D2Q9 or D2Q5
+   * lattice model which is periodic along the chosen axes. Distribution
+   * functions which stream off the lattice across the other edges bounce back
+   * into the same node
+   * \param lm lattice model which contains information on the number of rows,
+   *        columns, dimensions, discrete directions and lattice velocity
+   * \param is_periodic_x Boolean toggle to indicate if there are periodic
+   *        boundary conditions on the left and right edges
+   * \param is_periodic_y Boolean toggle to indicate if there are periodic
+   *        boundary conditions on the bottom and top edges
+   */
+  StreamAA(LatticeModel &lm
+    , bool is_periodic_x
+    , bool is_periodic_y);
+
+  /**
+   * Destructor
+   */
+  ~StreamAA() = default;
+
+  /**
+   * Performs the streaming step out of place with the same treatment of the
+   * lattice edges as the in-place streaming, used when the collision and
+   * streaming steps are performed separately
+   * \param df lattice distribution functions
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void Stream(const LatticeField &df
+    , LatticeField &df_next
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  using StreamModel::Stream;
+};
+
+#endif  // STREAM_AA_HPP_
@@ -0,0 +1,40 @@
+#ifndef STREAM_D2Q5_HPP_
+#define STREAM_D2Q5_HPP_
+#include <vector>
+#include "LatticeField.hpp"
+#include "LatticeModel.hpp"
+#include "StreamModel.hpp"
+
+class StreamD2Q5: public StreamModel {
+ public:
+  /**
+   * Constructor: Creates a non-periodic streaming model for D2Q5 lattice model
+   * \param lm Lattice model which contains information on the number of rows,
+   *        columns, dimensions, discrete directions and lattice velocity
+   */
+  StreamD2Q5(LatticeModel &lm);
+
+  /**
+   * Destructor
+   */
+  ~StreamD2Q5() = default;
+
+  /**
+   * Performs the streaming function along the four axis directions.
+   * Distribution functions which require off-lattice streaming are unchanged,
+   * see StreamModel::StreamRows()
+   * \param df lattice distribution functions
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void Stream(const LatticeField &df
+    , LatticeField &df_next
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  using StreamModel::Stream;
+};
+
+#endif  // STREAM_D2Q5_HPP_
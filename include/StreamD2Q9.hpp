@@ -1,6 +1,7 @@
 #ifndef STREAM_D2Q9_HPP_
 #define STREAM_D2Q9_HPP_
 #include <vector>
+#include "LatticeField.hpp"
 #include "LatticeModel.hpp"
 #include "StreamModel.hpp"
 
@@ -21,11 +22,19 @@ class StreamD2Q9: public StreamModel {
   /**
    * Performs the streaming function based on "Introduction to Lattice Boltzmann
    * Methods". Distribution functions which require off-lattice streaming are
-   * unchanged
-   * \param df lattice distribution functions stored row-wise in a 2D vector
+   * unchanged, see StreamModel::StreamRows()
+   * \param df lattice distribution functions
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
    */
-  std::vector<std::vector<double>> Stream(
-      const std::vector<std::vector<double>> &df);
+  void Stream(const LatticeField &df
+    , LatticeField &df_next
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  using StreamModel::Stream;
 };
 
 #endif  // STREAM_D2Q9_HPP_
@@ -1,7 +1,12 @@
 #ifndef STREAM_MODEL_CPP_
 #define STREAM_MODEL_CPP_
+#include <cstddef>  // std::ptrdiff_t
+#include <stdexcept>  // std::runtime_error
 #include <vector>
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
 #include "LatticeModel.hpp"
+#include "SparseLattice.hpp"
 
 class StreamModel {
  public:
@@ -9,8 +14,19 @@ class StreamModel {
    * Constructor: Base class for stream models
    * \param lm lattice model which contains information on the number of rows,
    *        columns, dimensions, discrete directions and lattice velocity
+   * \param is_periodic_x Boolean toggle to indicate if distribution functions
+   *        leaving the lattice through the left or right edge re-enter on the
+   *        opposite edge
+   * \param is_periodic_y Boolean toggle to indicate if distribution functions
+   *        leaving the lattice through the bottom or top edge re-enter on the
+   *        opposite edge
+   * \param is_in_place Boolean toggle to indicate if the stream model streams
+   *        the lattice distribution functions in place
    */
-  StreamModel(LatticeModel &lm);
+  StreamModel(LatticeModel &lm
+    , bool is_periodic_x
+    , bool is_periodic_y
+    , bool is_in_place);
 
   /**
    * Virtual destruction since we are deriving from this class
@@ -18,11 +34,161 @@ class StreamModel {
   virtual ~StreamModel() = default;
 
   /**
-   * Pure virtual function for the streaming function
-   * \param df lattice distribution function stored row-wise in a 2D vector
+   * Streams the lattice distribution functions into a new field, allocates
+   * the result so it is meant for testing and one-off use. Time stepping uses
+   * the two buffer overload instead
+   * \param df lattice distribution functions
+   * \return streamed lattice distribution functions
    */
-  virtual std::vector<std::vector<double>> Stream(
-      const std::vector<std::vector<double>> &df) = 0;
+  LatticeField Stream(const LatticeField &df);
+
+  /**
+   * Streams from df into df_next without allocating, every value of df_next
+   * is overwritten so the two buffers can simply be swapped afterwards
+   * \param df lattice distribution functions
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions, must have the same size, storage precision and shifts
+   *        as df
+   */
+  void Stream(const LatticeField &df
+    , LatticeField &df_next);
+
+  /**
+   * Pure virtual function for the streaming function. Streams the values
+   * arriving at the nodes of a slab of rows, only the nodes of the slab are
+   * written in df_next so slabs can run concurrently, see Stream()
+   * \param df lattice distribution functions
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  virtual void Stream(const LatticeField &df
+    , LatticeField &df_next
+    , std::size_t first_row
+    , std::size_t last_row) = 0;
+
+  /**
+   * Collides and streams in a single pass over the lattice. The values of each
+   * node are read once, handed to the collision kernel, and the
+   * post-collision values are written directly to their destination. Streams
+   * in place with CollideInPlace() if the stream model is in place, pushes
+   * into df_next with CollideAndPush() otherwise. The loops over the discrete
+   * directions are specialized on the two-dimensional velocity set Lattice.
+   * Only the nodes of a slab of rows are collided. Every value is read and
+   * written by exactly one node so slabs can run concurrently, once all of
+   * them are done FinishCollideAndStream() has to be called. With a sparse
+   * lattice only the nodes in its runs are collided, the values of the other
+   * nodes are neither read nor written
+   * \param df lattice distribution functions before collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions, unused when streaming in place
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   * \param sparse nodes to collide, every node when nullptr
+   * \param collide kernel called as collide(n, node) which replaces the
+   *        Lattice::nq values of node n in node with their post-collision
+   *        values
+   */
+  template <typename Lattice, typename Kernel>
+  void CollideAndStream(LatticeField &df
+    , LatticeField &df_next
+    , std::size_t first_row
+    , std::size_t last_row
+    , const SparseLattice *sparse
+    , Kernel collide) const;
+
+  /**
+   * Collides and streams two lattices which share their nodes, e.g., the NS
+   * and CD lattices of a coupled simulation, in a single pass over the nodes,
+   * see CollideAndStream(). The values of a node of both lattices are handed
+   * to the collision kernel together so a value computed for one of them,
+   * such as the velocity, is used by the other without going through memory.
+   * The fields have to share their storage precision and, when streaming in
+   * place, their layout
+   * \param df lattice distribution functions of the first lattice before
+   *        collision
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions of the first lattice, unused when streaming in place
+   * \param dg lattice distribution functions of the second lattice before
+   *        collision
+   * \param dg_next buffer which receives the streamed lattice distribution
+   *        functions of the second lattice, unused when streaming in place
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   * \param sparse nodes to collide, every node when nullptr
+   * \param collide kernel called as collide(n, node_f, node_g) which replaces
+   *        the Lattice::nq values of node n of both lattices with their
+   *        post-collision values
+   */
+  template <typename Lattice, typename Kernel>
+  void CollideAndStream(LatticeField &df
+    , LatticeField &df_next
+    , LatticeField &dg
+    , LatticeField &dg_next
+    , std::size_t first_row
+    , std::size_t last_row
+    , const SparseLattice *sparse
+    , Kernel collide) const;
+
+  /**
+   * Streams num_fields lattices of the size of the lattice model which are
+   * stored interleaved, the values of the fields at a node in a discrete
+   * direction are contiguous, e.g., the members of LatticeBoltzmannEnsemble.
+   * Every field is streamed like StreamRows() in a single pass over the rows,
+   * the values of all fields at a node move together. The fields are stored
+   * in double precision
+   * \param df lattice distribution functions, node n of field k is stored at
+   *        n * num_fields + k of each plane
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param num_fields number of interleaved fields
+   */
+  void StreamInterleaved(const LatticeField &df
+    , LatticeField &df_next
+    , std::size_t num_fields) const;
+
+  /**
+   * Completes a collide and stream pass over all slabs, flips the layout of
+   * df when streaming in place
+   * \param df lattice distribution functions after collision
+   */
+  void FinishCollideAndStream(LatticeField &df) const;
+
+  /**
+   * Finds where a value of a field streamed in place is stored, see
+   * CollideInPlace() for the layouts
+   * \param n index of the node in the lattice, replaced by the index of the
+   *        node which stores the value
+   * \param i discrete direction, replaced by the direction which stores the
+   *        value
+   * \param is_swapped Boolean toggle to indicate if the field holds the values
+   *        of an even step
+   * \param is_post_collision Boolean toggle to locate the post-collision value
+   *        instead of the streamed value
+   */
+  void Locate(std::size_t &n
+    , std::size_t &i
+    , bool is_swapped
+    , bool is_post_collision) const;
+
+  /**
+   * Boolean toggle to indicate if streaming is periodic across the left and
+   * right edges
+   */
+  bool periodic_x;
+
+  /**
+   * Boolean toggle to indicate if streaming is periodic across the bottom and
+   * top edges
+   */
+  bool periodic_y;
+
+  /**
+   * Boolean toggle to indicate if the lattice distribution functions are
+   * streamed in place
+   */
+  bool in_place;
 
  protected:
   /**
@@ -39,9 +205,393 @@ class StreamModel {
     SE
   };
 
+  /**
+   * Streams the values arriving at the nodes of a slab of rows, pulling them
+   * from the node they come from. The lattice is treated as if it were padded
+   * with a layer of ghost nodes: a value coming from outside the lattice is
+   * read from the wrapped node across a periodic edge and is the value of the
+   * node itself across any other edge. The source of each row and direction
+   * is resolved once, so apart from the first and last column every value is
+   * copied by a branch-free loop over a contiguous row
+   * \param df lattice distribution functions
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  void StreamRows(const LatticeField &df
+    , LatticeField &df_next
+    , std::size_t first_row
+    , std::size_t last_row) const;
+
   /**
    * Reference to lattice model
    */
   LatticeModel &lm_;
+
+ private:
+  /**
+   * Streams the raw planes, see StreamRows(). Values are copied without
+   * converting them since df and df_next share their storage precision and
+   * shifts
+   * \tparam Lattice velocity set of df and df_next
+   * \tparam T storage type of df and df_next
+   * \param df lattice distribution functions
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   */
+  template <typename Lattice, typename T>
+  void StreamRowsKernel(const LatticeField &df
+    , LatticeField &df_next
+    , std::size_t first_row
+    , std::size_t last_row) const;
+
+  /**
+   * Streams the interleaved fields for the velocity set described by Lattice,
+   * see StreamInterleaved()
+   * \param df lattice distribution functions
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param num_fields number of interleaved fields
+   */
+  template <typename Lattice>
+  void StreamInterleavedKernel(const LatticeField &df
+    , LatticeField &df_next
+    , std::size_t num_fields) const;
+
+  /**
+   * Checks that K fields can be streamed in the same pass and collides and
+   * streams them with CollideInPlace() or CollideAndPush() for their storage
+   * type, see CollideAndStream()
+   * \param df lattice distribution functions of each field before collision
+   * \param df_next buffer of each field which receives the streamed lattice
+   *        distribution functions, unused when streaming in place
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   * \param sparse nodes to collide, every node when nullptr
+   * \param collide kernel called as collide(n, node) which replaces the
+   *        values of node n of field k in node[k] with their post-collision
+   *        values
+   */
+  template <typename Lattice, std::size_t K, typename Kernel>
+  void CollideAndStreamFields(LatticeField *const (&df)[K]
+    , LatticeField *const (&df_next)[K]
+    , std::size_t first_row
+    , std::size_t last_row
+    , const SparseLattice *sparse
+    , Kernel collide) const;
+
+  /**
+   * Pushes the post-collision values of each node of K fields into df_next.
+   * Distribution functions which stream across the lattice edge are also
+   * written back to df so boundary conditions which copy post-collision
+   * values before streaming, such as half-way bounceback, can still do so
+   * after this pass. Off-lattice streaming follows Stream() of the derived
+   * class: wrap around across periodic edges, unchanged otherwise. Values
+   * are loaded from and stored to the planes as T, the collision kernel
+   * always works in double precision
+   * \tparam K number of fields
+   * \tparam T storage type of the fields, each field shares its shifts with
+   *         its buffer
+   * \param df lattice distribution functions of each field before collision
+   * \param df_next buffer of each field which receives the streamed lattice
+   *        distribution functions, every value is overwritten once all slabs
+   *        are done
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   * \param sparse nodes to collide, every node when nullptr
+   * \param collide collision kernel
+   */
+  template <typename Lattice, std::size_t K, typename T, typename Kernel>
+  void CollideAndPush(LatticeField *const (&df)[K]
+    , LatticeField *const (&df_next)[K]
+    , std::size_t first_row
+    , std::size_t last_row
+    , const SparseLattice *sparse
+    , Kernel collide) const;
+
+  /**
+   * Collides and streams K fields in place with the AA access pattern,
+   * alternating between two kinds of steps based on the layout of the
+   * fields, which is flipped by FinishCollideAndStream(). An even step reads
+   * the values of each node from the node itself and writes the
+   * post-collision values back to the same node in the opposite directions,
+   * leaving the field in the swapped layout. An odd step reads the values
+   * streaming into each node from the opposite directions of its neighbours
+   * and writes the post-collision values to the neighbours they stream to,
+   * leaving the field in the plain layout. Each node writes exactly the
+   * values it read so no second buffer is needed. Values leaving the lattice
+   * across an edge which is not periodic come back to the same node in the
+   * opposite direction
+   * \tparam K number of fields
+   * \tparam T storage type of the fields
+   * \param df lattice distribution functions of each field before collision
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
+   * \param sparse nodes to collide, every node when nullptr
+   * \param collide collision kernel
+   */
+  template <typename Lattice, std::size_t K, typename T, typename Kernel>
+  void CollideInPlace(LatticeField *const (&df)[K]
+    , std::size_t first_row
+    , std::size_t last_row
+    , const SparseLattice *sparse
+    , Kernel collide) const;
 };
+
+template <typename Lattice, typename Kernel>
+void StreamModel::CollideAndStream(LatticeField &df
+  , LatticeField &df_next
+  , std::size_t first_row
+  , std::size_t last_row
+  , const SparseLattice *sparse
+  , Kernel collide) const
+{
+  LatticeField *const fields[] = {&df};
+  LatticeField *const fields_next[] = {&df_next};
+  CollideAndStreamFields<Lattice>(fields, fields_next, first_row, last_row,
+      sparse, [&collide](std::size_t n, double (*node)[Lattice::nq]) {
+    collide(n, node[0]);
+  });
+}
+
+template <typename Lattice, typename Kernel>
+void StreamModel::CollideAndStream(LatticeField &df
+  , LatticeField &df_next
+  , LatticeField &dg
+  , LatticeField &dg_next
+  , std::size_t first_row
+  , std::size_t last_row
+  , const SparseLattice *sparse
+  , Kernel collide) const
+{
+  LatticeField *const fields[] = {&df, &dg};
+  LatticeField *const fields_next[] = {&df_next, &dg_next};
+  CollideAndStreamFields<Lattice>(fields, fields_next, first_row, last_row,
+      sparse, [&collide](std::size_t n, double (*node)[Lattice::nq]) {
+    collide(n, node[0], node[1]);
+  });
+}
+
+template <typename Lattice, std::size_t K, typename Kernel>
+void StreamModel::CollideAndStreamFields(LatticeField *const (&df)[K]
+  , LatticeField *const (&df_next)[K]
+  , std::size_t first_row
+  , std::size_t last_row
+  , const SparseLattice *sparse
+  , Kernel collide) const
+{
+  static_assert(Lattice::nd == 2, "Stream models are two-dimensional");
+  const auto is_single = df[0]->IsSinglePrecision();
+  for (auto k = 1u; k < K; ++k) {
+    if (df[k]->IsSinglePrecision() != is_single) {
+      throw std::runtime_error("Precision mismatch");
+    }
+    if (in_place && df[k]->IsSwapped() != df[0]->IsSwapped()) {
+      throw std::runtime_error("Layout mismatch");
+    }
+  }  // k
+  if (in_place) {
+    if (is_single) {
+      CollideInPlace<Lattice, K, float>(df, first_row, last_row, sparse,
+          collide);
+    }
+    else {
+      CollideInPlace<Lattice, K, double>(df, first_row, last_row, sparse,
+          collide);
+    }
+  }
+  else {
+    if (is_single) {
+      CollideAndPush<Lattice, K, float>(df, df_next, first_row, last_row,
+          sparse, collide);
+    }
+    else {
+      CollideAndPush<Lattice, K, double>(df, df_next, first_row, last_row,
+          sparse, collide);
+    }
+  }
+}
+
+template <typename Lattice, std::size_t K, typename T, typename Kernel>
+void StreamModel::CollideAndPush(LatticeField *const (&df)[K]
+  , LatticeField *const (&df_next)[K]
+  , std::size_t first_row
+  , std::size_t last_row
+  , const SparseLattice *sparse
+  , Kernel collide) const
+{
+  const auto nx = static_cast<std::ptrdiff_t>(lm_.GetNumberOfColumns());
+  const auto ny = static_cast<std::ptrdiff_t>(lm_.GetNumberOfRows());
+  const auto nq = static_cast<int>(Lattice::nq);
+  T *src[K][Lattice::nq];
+  T *dst[K][Lattice::nq];
+  double shift[K][Lattice::nq];
+  std::ptrdiff_t offset[Lattice::nq];
+  for (auto i = 0; i < nq; ++i) {
+    for (auto k = 0u; k < K; ++k) {
+      src[k][i] = df[k]->template Plane<T>(i);
+      dst[k][i] = df_next[k]->template Plane<T>(i);
+      shift[k][i] = df[k]->Shift(i);
+    }  // k
+    offset[i] = Lattice::e[i][1] * nx + Lattice::e[i][0];
+  }  // i
+  const auto y_begin = static_cast<std::ptrdiff_t>(first_row);
+  const auto y_end = static_cast<std::ptrdiff_t>(last_row);
+  const std::size_t dense_run[] = {0, lm_.GetNumberOfColumns()};
+  double node[K][Lattice::nq];
+  for (auto y = y_begin; y < y_end; ++y) {
+    const auto is_edge_row = y == 0 || y == ny - 1;
+    const auto runs = sparse ? sparse->GetRuns(y) : dense_run;
+    const auto num_runs = sparse ? sparse->GetNumberOfRuns(y) : 1;
+    for (auto r = 0u; r < num_runs; ++r) {
+      const auto x_begin = static_cast<std::ptrdiff_t>(runs[2 * r]);
+      const auto x_end = static_cast<std::ptrdiff_t>(runs[2 * r + 1]);
+      for (auto x = x_begin; x < x_end; ++x) {
+        const auto n = y * nx + x;
+        for (auto k = 0u; k < K; ++k) {
+          for (auto i = 0; i < nq; ++i) {
+            node[k][i] = shift[k][i] + src[k][i][n];
+          }  // i
+        }  // k
+        collide(n, node);
+        for (auto k = 0u; k < K; ++k) {
+          for (auto i = 0; i < nq; ++i) node[k][i] -= shift[k][i];
+        }  // k
+        if (!(is_edge_row || x == 0 || x == nx - 1)) {
+          for (auto k = 0u; k < K; ++k) {
+            for (auto i = 0; i < nq; ++i) {
+              dst[k][i][n + offset[i]] = static_cast<T>(node[k][i]);
+            }  // i
+          }  // k
+          continue;
+        }
+        for (auto i = 0; i < nq; ++i) {
+          auto x_dst = x + Lattice::e[i][0];
+          auto y_dst = y + Lattice::e[i][1];
+          const auto is_leaving_x = x_dst < 0 || x_dst == nx;
+          const auto is_leaving_y = y_dst < 0 || y_dst == ny;
+          if (is_leaving_x || is_leaving_y) {
+            for (auto k = 0u; k < K; ++k) {
+              src[k][i][n] = static_cast<T>(node[k][i]);
+            }  // k
+          }
+          // nothing streams in from outside the lattice across an edge which
+          // is not periodic, value is unchanged
+          const auto x_src = x - Lattice::e[i][0];
+          const auto y_src = y - Lattice::e[i][1];
+          if ((!periodic_x && (x_src < 0 || x_src == nx)) ||
+              (!periodic_y && (y_src < 0 || y_src == ny))) {
+            for (auto k = 0u; k < K; ++k) {
+              dst[k][i][n] = static_cast<T>(node[k][i]);
+            }  // k
+          }
+          if ((!periodic_x && is_leaving_x) || (!periodic_y && is_leaving_y)) {
+            continue;
+          }
+          x_dst = (x_dst + nx) % nx;
+          y_dst = (y_dst + ny) % ny;
+          for (auto k = 0u; k < K; ++k) {
+            dst[k][i][y_dst * nx + x_dst] = static_cast<T>(node[k][i]);
+          }  // k
+        }  // i
+      }  // x
+    }  // r
+  }  // y
+}
+
+template <typename Lattice, std::size_t K, typename T, typename Kernel>
+void StreamModel::CollideInPlace(LatticeField *const (&df)[K]
+  , std::size_t first_row
+  , std::size_t last_row
+  , const SparseLattice *sparse
+  , Kernel collide) const
+{
+  const auto nx = static_cast<std::ptrdiff_t>(lm_.GetNumberOfColumns());
+  const auto ny = static_cast<std::ptrdiff_t>(lm_.GetNumberOfRows());
+  const auto nq = static_cast<int>(Lattice::nq);
+  const auto &opposite = Lattice::opposite;
+  const auto is_even = !df[0]->IsSwapped();
+  T *f[K][Lattice::nq];
+  double shift[K][Lattice::nq];
+  std::ptrdiff_t offset[Lattice::nq];
+  for (auto i = 0; i < nq; ++i) {
+    for (auto k = 0u; k < K; ++k) {
+      f[k][i] = df[k]->template Plane<T>(i);
+      shift[k][i] = df[k]->Shift(i);
+    }  // k
+    offset[i] = Lattice::e[i][1] * nx + Lattice::e[i][0];
+  }  // i
+  const auto y_begin = static_cast<std::ptrdiff_t>(first_row);
+  const auto y_end = static_cast<std::ptrdiff_t>(last_row);
+  const std::size_t dense_run[] = {0, lm_.GetNumberOfColumns()};
+  double node[K][Lattice::nq];
+  for (auto y = y_begin; y < y_end; ++y) {
+    const auto is_edge_row = y == 0 || y == ny - 1;
+    const auto runs = sparse ? sparse->GetRuns(y) : dense_run;
+    const auto num_runs = sparse ? sparse->GetNumberOfRuns(y) : 1;
+    for (auto r = 0u; r < num_runs; ++r) {
+      const auto x_begin = static_cast<std::ptrdiff_t>(runs[2 * r]);
+      const auto x_end = static_cast<std::ptrdiff_t>(runs[2 * r + 1]);
+      for (auto x = x_begin; x < x_end; ++x) {
+        const auto n = y * nx + x;
+        if (is_even) {
+          for (auto k = 0u; k < K; ++k) {
+            for (auto i = 0; i < nq; ++i) {
+              node[k][i] = shift[k][i] + f[k][i][n];
+            }  // i
+          }  // k
+          collide(n, node);
+          for (auto k = 0u; k < K; ++k) {
+            for (auto i = 0; i < nq; ++i) {
+              const auto j = opposite[i];
+              f[k][j][n] = static_cast<T>(node[k][i] - shift[k][j]);
+            }  // i
+          }  // k
+          continue;
+        }
+        if (!(is_edge_row || x == 0 || x == nx - 1)) {
+          for (auto k = 0u; k < K; ++k) {
+            for (auto i = 0; i < nq; ++i) {
+              const auto j = opposite[i];
+              node[k][i] = shift[k][j] + f[k][j][n - offset[i]];
+            }  // i
+          }  // k
+          collide(n, node);
+          for (auto k = 0u; k < K; ++k) {
+            for (auto i = 0; i < nq; ++i) {
+              f[k][i][n + offset[i]] = static_cast<T>(node[k][i] -
+                  shift[k][i]);
+            }  // i
+          }  // k
+          continue;
+        }
+        // the value streaming into n in direction i and the post-collision
+        // value leaving n in direction opposite[i] share a location, which is
+        // the same for every field
+        std::size_t location[Lattice::nq];
+        std::size_t direction[Lattice::nq];
+        for (auto i = 0; i < nq; ++i) {
+          location[i] = n;
+          direction[i] = i;
+          Locate(location[i], direction[i], true, false);
+          for (auto k = 0u; k < K; ++k) {
+            node[k][i] = shift[k][direction[i]] +
+                f[k][direction[i]][location[i]];
+          }  // k
+        }  // i
+        collide(n, node);
+        for (auto i = 0; i < nq; ++i) {
+          const auto j = direction[opposite[i]];
+          for (auto k = 0u; k < K; ++k) {
+            f[k][j][location[opposite[i]]] = static_cast<T>(node[k][i] -
+                shift[k][j]);
+          }  // k
+        }  // i
+      }  // x
+    }  // r
+  }  // y
+}
 #endif  // STREAM_MODEL_CPP_
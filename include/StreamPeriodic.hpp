@@ -1,18 +1,36 @@
 #ifndef STREAM_PERIODIC_HPP_
 #define STREAM_PERIODIC_HPP_
 #include <vector>
+#include "LatticeField.hpp"
 #include "LatticeModel.hpp"
 #include "StreamModel.hpp"
 
 class StreamPeriodic: public StreamModel {
  public:
   /**
-   * Constructor: Creates a periodic streaming model for the D2Q9 lattice model
+   * Constructor: Creates a periodic streaming model for the D2Q9 or D2Q5
+   * lattice model
    * \param lm lattice model which contains information on the number of rows,
    *        columns, dimensions, discrete directons and lattice velocity
    */
   StreamPeriodic(LatticeModel &lm);
 
+  /**
+   * Constructor: Creates a streaming model for the D2Q9 or D2Q5 lattice model
+   * which is periodic along the chosen axes, e.g., a channel which is periodic
+   * in x and bounded by walls in y. Distribution functions which require
+   * off-lattice streaming across the other edges are unchanged
+   * \param lm lattice model which contains information on the number of rows,
+   *        columns, dimensions, discrete directons and lattice velocity
+   * \param is_periodic_x Boolean toggle to indicate if there are periodic
+   *        boundary conditions on the left and right edges
+   * \param is_periodic_y Boolean toggle to indicate if there are periodic
+   *        boundary conditions on the bottom and top edges
+   */
+  StreamPeriodic(LatticeModel &lm
+    , bool is_periodic_x
+    , bool is_periodic_y);
+
   /**
    * Destructor
    */
@@ -20,12 +38,20 @@ class StreamPeriodic: public StreamModel {
 
   /**
    * Performs the streaming step based on "Introduction to Lattice Boltzmann
-   * Methods" and assumes there are periodic boundary conditions on all edges
-   * and corners.
-   * \param df lattice distribution functions stored row-wise in a 2D vector
+   * Methods" with periodic boundary conditions on the periodic edges and
+   * corners, see StreamModel::StreamRows()
+   * \param df lattice distribution functions
+   * \param df_next buffer which receives the streamed lattice distribution
+   *        functions
+   * \param first_row first row of the slab
+   * \param last_row one past the last row of the slab
    */
-  std::vector<std::vector<double>> Stream(
-      const std::vector<std::vector<double>> &df);
+  void Stream(const LatticeField &df
+    , LatticeField &df_next
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  using StreamModel::Stream;
 };
 
 #endif  // STREAM_PERIODIC_HPP_
@@ -0,0 +1,123 @@
+#ifndef THREAD_POOL_HPP_
+#define THREAD_POOL_HPP_
+#include <condition_variable>
+#include <cstddef>  // std::size_t
+#include <exception>  // std::exception_ptr
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+ public:
+  /**
+   * Constructor: Starts the worker threads. The calling thread also takes a
+   * share of the work so num_threads - 1 threads are started
+   * \param num_threads number of threads which share the work, at least 1
+   */
+  explicit ThreadPool(std::size_t num_threads);
+
+  /**
+   * Destructor: Stops and joins the worker threads
+   */
+  ~ThreadPool();
+
+  /**
+   * The worker threads cannot be copied
+   */
+  ThreadPool(const ThreadPool&) = delete;
+
+  /**
+   * The worker threads cannot be copied
+   */
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * Splits the rows of the lattice into contiguous slabs, one per thread, and
+   * calls task once for each slab. Returns once every slab is done, so each
+   * call acts as a barrier between the phases of a step. The slab of a thread
+   * only depends on the number of rows and threads, an exception thrown by
+   * task is rethrown in the calling thread
+   * \param num_rows number of rows to split
+   * \param task called as task(first_row, last_row) for the rows
+   *        [first_row, last_row)
+   */
+  void ParallelFor(std::size_t num_rows
+    , const std::function<void(std::size_t, std::size_t)> &task);
+
+  /**
+   * Get the number of threads which share the work, including the calling
+   * thread
+   * \return number of threads
+   */
+  std::size_t GetNumberOfThreads() const;
+
+ private:
+  /**
+   * Loop of each worker thread, waits for a new task and runs its slab
+   * \param id index of the slab of the worker thread
+   */
+  void Work(std::size_t id);
+
+  /**
+   * Runs the slab of a thread and records the first exception
+   * \param id index of the slab
+   */
+  void RunSlab(std::size_t id);
+
+  /**
+   * Number of threads which share the work, including the calling thread
+   */
+  std::size_t num_threads_;
+
+  /**
+   * Worker threads
+   */
+  std::vector<std::thread> workers_;
+
+  /**
+   * Guards the task and the counters below
+   */
+  std::mutex mutex_;
+
+  /**
+   * Wakes the workers when a new task is posted
+   */
+  std::condition_variable start_;
+
+  /**
+   * Wakes the calling thread when the last worker is done
+   */
+  std::condition_variable done_;
+
+  /**
+   * Task of the current call to ParallelFor()
+   */
+  const std::function<void(std::size_t, std::size_t)> *task_;
+
+  /**
+   * Number of rows split by the current call to ParallelFor()
+   */
+  std::size_t num_rows_;
+
+  /**
+   * Incremented for every posted task so workers run each task once
+   */
+  std::size_t generation_;
+
+  /**
+   * Number of workers which have not finished the current task
+   */
+  std::size_t num_busy_;
+
+  /**
+   * Boolean toggle to tell the workers to stop
+   */
+  bool is_stopping_;
+
+  /**
+   * First exception thrown by a slab of the current task
+   */
+  std::exception_ptr error_;
+};
+#endif  // THREAD_POOL_HPP_
@@ -1,8 +1,10 @@
 #ifndef ZOU_HE_NODES_HPP_
 #define ZOU_HE_NODES_HPP_
+#include <cstddef>  // std::size_t
 #include <vector>
 #include "BoundaryNodes.hpp"
 #include "CollisionModel.hpp"
+#include "LatticeField.hpp"
 #include "ValueNode.hpp"
 
 class ZouHeNodes: public BoundaryNodes {
@@ -22,7 +24,8 @@ class ZouHeNodes: public BoundaryNodes {
   ~ZouHeNodes() = default;
 
   /**
-   * Adds a Zou/He velocity node to the nodes vector
+   * Adds a Zou/He velocity node. Side nodes are kept in contiguous arrays of
+   * indices and velocities per side, in ascending order of their index
    * \param x x-coordinate of the node
    * \param y y-coordinate of the node
    * \param u_x x-velocity of the node
@@ -35,31 +38,42 @@ class ZouHeNodes: public BoundaryNodes {
 
   /**
    * Updates the boundary nodes based on "On pressure and velocity boundary
-   * conditions for the lattice Boltzmann"
-   * \param df lattice distribution functions stored row-wise in a 2D vector
+   * conditions for the lattice Boltzmann". The nodes of each side are updated
+   * in a single loop without dispatching on the side of every node, the
+   * corners afterwards
+   * \param df lattice distribution functions
    * \param is_modify_stream boolean toggle for half-way bounceback nodes to
    *        perform functions during stream, set to FALSE for Zou/He velocity
    *        nodes
+   * \param first_row first row of the band
+   * \param last_row one past the last row of the band
    */
-  void UpdateNodes(std::vector<std::vector<double>> &df
-    , bool is_modify_stream);
+  void UpdateNodes(LatticeField &df
+    , bool is_modify_stream
+    , std::size_t first_row
+    , std::size_t last_row);
+
+  using BoundaryNodes::UpdateNodes;
 
   /**
-   * Updates the non-corner nodes
-   * \param df lattice distribution function stored row-wise in a 2D vector
-   * \param node Zou/He velocity node which contains information on the position
-   *        of the boundary node and velocities of the node
+   * Updates the non-corner nodes of one side in a band of rows
+   * \param df lattice distribution functions
+   * \param side side of the lattice, 0: right, 1: top, 2: left, 3: bottom
+   * \param first_row first row of the band
+   * \param last_row one past the last row of the band
    */
-  void UpdateSide(std::vector<std::vector<double>> &df
-    , ValueNode &node);
+  void UpdateSide(LatticeField &df
+    , std::size_t side
+    , std::size_t first_row
+    , std::size_t last_row);
 
   /**
    * Updates the corner nodes, first-order expolation for node density
-   * \param df lattice distribution function stored row-wise in a 2D vector
+   * \param df lattice distribution functions
    * \param node Zou/He velocity node which contains information on the position
    *        of the boundary node and velocities of the node
    */
-  void UpdateCorner(std::vector<std::vector<double>> &df
+  void UpdateCorner(LatticeField &df
     , ValueNode &node);
 
   /**
@@ -69,9 +83,18 @@ class ZouHeNodes: public BoundaryNodes {
   void ToggleNormalFlow();
 
   /**
-   * Boundary nodes stored in a 1D vector
+   * Returns all Zou/He velocity nodes with their prescribed velocities, the
+   * side nodes of the right, top, left and bottom sides in ascending order of
+   * their index, followed by the corner nodes. Read-only replacement for the
+   * former nodes vector, the side nodes are rebuilt on every call
+   * \return vector of side and corner nodes
+   */
+  std::vector<ValueNode> GetNodes() const;
+
+  /**
+   * Corner nodes stored in a 1D vector
    */
-  std::vector<ValueNode> nodes;
+  std::vector<ValueNode> corners;
 
  protected:
   /**
@@ -91,8 +114,37 @@ class ZouHeNodes: public BoundaryNodes {
   double beta1_;
   double beta2_;
   double beta3_;
-//  std::vector<bool> is_corner_;
-//  std::vector<bool> knowns_;
+
+  /**
+   * Indices of the non-corner nodes of each side, right, top, left and
+   * bottom, in ascending order so the nodes of a band of rows are contiguous
+   */
+  std::vector<std::vector<std::size_t>> side_nodes_;
+
+  /**
+   * x-velocity of the non-corner nodes of each side, replaced by the velocity
+   * of the neighbouring node with normal flow
+   */
+  std::vector<std::vector<double>> side_u_x_;
+
+  /**
+   * y-velocity of the non-corner nodes of each side
+   */
+  std::vector<std::vector<double>> side_u_y_;
+
+  /**
+   * Updates the non-corner nodes of one side, the same code serves the
+   * LatticeField and its raw planes
+   * \param df lattice distribution functions
+   * \param side side of the lattice
+   * \param first first node of the side to update
+   * \param last one past the last node of the side to update
+   */
+  template <typename Field>
+  void UpdateSideKernel(Field &df
+    , std::size_t side
+    , std::size_t first
+    , std::size_t last);
 };
 
 #endif  // ZOU_HE_NODES_HPP_
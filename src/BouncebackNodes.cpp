@@ -1,23 +1,34 @@
 #include "BouncebackNodes.hpp"
+#include <cstddef>  // std::size_t
 #include <iostream>
 #include <vector>
 #include "BoundaryNodes.hpp"
 #include "CollisionModel.hpp"
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
 #include "Node.hpp"
 
 BouncebackNodes::BouncebackNodes(LatticeModel &lm
   , CollisionModel *cm)
   : BoundaryNodes(true, false, lm),
     nodes {},
-    cm_ {cm}
+    cm_ {cm},
+    link_directions_ {},
+    link_offsets_(1, 0),
+    link_values_ {}
 {}
 
 BouncebackNodes::BouncebackNodes(LatticeModel &lm
   , StreamModel *sm)
   : BoundaryNodes(true, true, lm),
     nodes {},
-    sm_ {sm}
-{}
+    sm_ {sm},
+    link_directions_ {},
+    link_offsets_(1, 0),
+    link_values_ {}
+{
+  link_wise = true;
+}
 
 void BouncebackNodes::AddNode(std::size_t x
   , std::size_t y)
@@ -25,53 +36,126 @@ void BouncebackNodes::AddNode(std::size_t x
   const auto nx = lm_.GetNumberOfColumns();
   const auto n = y * nx + x;
   nodes.push_back(Node(x, y, nx));
+  AddNodeToRow(y);
   // in C++11 nullptr is implicitly cast to boolean false
   // http://stackoverflow.com/questions/11279715/nullptr-and-checking-if-a-
   // pointer-points-to-a-valid-object
   if (cm_) cm_->AddNodeToSkip(n);
+  if (sm_) {
+    const auto ny = lm_.GetNumberOfRows();
+    const auto left = x == 0;
+    const auto right = x == nx - 1;
+    const auto bottom = y == 0;
+    const auto top = y == ny - 1;
+    if (bottom) link_directions_.push_back(N);
+    if (top) link_directions_.push_back(S);
+    if (left) link_directions_.push_back(E);
+    if (right) link_directions_.push_back(W);
+    // D2Q5 has no diagonal directions
+    if (lm_.GetNumberOfDirections() > NE) {
+      if (bottom || left) link_directions_.push_back(NE);
+      if (bottom || right) link_directions_.push_back(NW);
+      if (top || right) link_directions_.push_back(SW);
+      if (top || left) link_directions_.push_back(SE);
+    }
+    link_values_.resize(link_directions_.size());
+  }
+  // full-way bounceback nodes have no wall links
+  link_offsets_.push_back(link_directions_.size());
   // add node position to position vector for cmgui output
   position.push_back(n);
 }
 
-void BouncebackNodes::UpdateNodes(std::vector<std::vector<double>> &df
-  , bool is_modify_stream)
+void BouncebackNodes::UpdateNodes(LatticeField &df
+  , bool is_modify_stream
+  , std::size_t first_row
+  , std::size_t last_row)
 {
   if (is_modify_stream) {
-    const auto nx = lm_.GetNumberOfColumns();
-    const auto ny = lm_.GetNumberOfRows();
-    for (auto &node : nodes) {
-      const auto n = node.n;
-      const auto left = n % nx == 0;
-      const auto right = n % nx == nx - 1;
-      const auto bottom = n / nx == 0;
-      const auto top = n / nx == ny - 1;
-      if (bottom) df[n][N] = node.df_node[S];
-      if (top) df[n][S] = node.df_node[N];
-      if (left) df[n][E] = node.df_node[W];
-      if (right) df[n][W] = node.df_node[E];
-      if (bottom || left) df[n][NE] = node.df_node[SW];
-      if (bottom || right) df[n][NW] = node.df_node[SE];
-      if (top || right) df[n][SW] = node.df_node[NE];
-      if (top || left) df[n][SE] = node.df_node[NW];
-    }  // node
+    for (auto y = first_row; y < last_row; ++y) {
+      for (auto k : row_nodes_[y]) {
+        const auto n = nodes[k].n;
+        for (auto l = link_offsets_[k]; l < link_offsets_[k + 1]; ++l) {
+          df(n, link_directions_[l]) = link_values_[l];
+        }  // l
+      }  // k
+    }  // y
   }
   else {
     if (cm_) {
-      for (auto node : nodes) {
-        const auto n = node.n;
-        auto temp_node = df[n];
-        df[n][E] = temp_node[W];
-        df[n][N] = temp_node[S];
-        df[n][W] = temp_node[E];
-        df[n][S] = temp_node[N];
-        df[n][NE] = temp_node[SW];
-        df[n][NW] = temp_node[SE];
-        df[n][SW] = temp_node[NE];
-        df[n][SE] = temp_node[NW];
-      }  // node
+      // D2Q5 has no diagonal directions
+      const auto is_diagonal = df.GetNumberOfDirections() > NE;
+      for (auto y = first_row; y < last_row; ++y) {
+        for (auto k : row_nodes_[y]) {
+          const auto n = nodes[k].n;
+          swap(df(n, E), df(n, W));
+          swap(df(n, N), df(n, S));
+          if (!is_diagonal) continue;
+          swap(df(n, NE), df(n, SW));
+          swap(df(n, NW), df(n, SE));
+        }  // k
+      }  // y
     }
     if (sm_) {
-      for (auto &node : nodes) node.df_node = df[node.n];
+      const auto &opposite = D2Q9::opposite;
+      for (auto y = first_row; y < last_row; ++y) {
+        for (auto k : row_nodes_[y]) {
+          const auto n = nodes[k].n;
+          for (auto l = link_offsets_[k]; l < link_offsets_[k + 1]; ++l) {
+            link_values_[l] = df(n, opposite[link_directions_[l]]);
+          }  // l
+        }  // k
+      }  // y
     }
   }
 }
+
+void BouncebackNodes::UpdateLinks(const LatticeField &df
+  , LatticeField &df_next
+  , std::size_t first_row
+  , std::size_t last_row) const
+{
+  if (!df.IsPlainLayout() || !df_next.IsPlainLayout()) {
+    const auto &opposite = D2Q9::opposite;
+    for (auto y = first_row; y < last_row; ++y) {
+      for (auto k : row_nodes_[y]) {
+        const auto n = nodes[k].n;
+        for (auto l = link_offsets_[k]; l < link_offsets_[k + 1]; ++l) {
+          const auto i = link_directions_[l];
+          df_next(n, i) = df(n, opposite[i]);
+        }  // l
+      }  // k
+    }  // y
+  }
+  else if (df.IsSinglePrecision()) {
+    UpdateLinksKernel<float>(df, df_next, first_row, last_row);
+  }
+  else {
+    UpdateLinksKernel<double>(df, df_next, first_row, last_row);
+  }
+}
+
+template <typename T>
+void BouncebackNodes::UpdateLinksKernel(const LatticeField &df
+  , LatticeField &df_next
+  , std::size_t first_row
+  , std::size_t last_row) const
+{
+  const auto &opposite = D2Q9::opposite;
+  const auto nq = df.GetNumberOfDirections();
+  const T *src[D2Q9::nq];
+  T *dst[D2Q9::nq];
+  for (auto i = 0u; i < nq; ++i) {
+    src[i] = df.Plane<T>(opposite[i]);
+    dst[i] = df_next.Plane<T>(i);
+  }  // i
+  for (auto y = first_row; y < last_row; ++y) {
+    for (auto k : row_nodes_[y]) {
+      const auto n = nodes[k].n;
+      for (auto l = link_offsets_[k]; l < link_offsets_[k + 1]; ++l) {
+        const auto i = link_directions_[l];
+        dst[i][n] = src[i][n];
+      }  // l
+    }  // k
+  }  // y
+}
@@ -1,5 +1,7 @@
 #include "BoundaryNodes.hpp"
+#include <cstddef>  // std::size_t
 #include <vector>
+#include "LatticeField.hpp"
 #include "LatticeModel.hpp"
 
 // have to use parenthesis for reference initializing in initializer list due to
@@ -9,6 +11,26 @@ BoundaryNodes::BoundaryNodes(bool is_prestream
   , LatticeModel &lm)
   : prestream {is_prestream},
     during_stream {is_during_stream},
+    link_wise {false},
     position {},
+    row_nodes_ (lm.GetNumberOfRows()),
+    num_nodes_ {0},
     lm_ (lm)
 {}
+
+void BoundaryNodes::UpdateNodes(LatticeField &df
+  , bool is_modify_stream)
+{
+  UpdateNodes(df, is_modify_stream, 0, lm_.GetNumberOfRows());
+}
+
+void BoundaryNodes::UpdateLinks(const LatticeField&
+  , LatticeField&
+  , std::size_t
+  , std::size_t) const
+{}
+
+void BoundaryNodes::AddNodeToRow(std::size_t y)
+{
+  row_nodes_[y].push_back(num_nodes_++);
+}
@@ -1,9 +1,16 @@
 #include "CollisionCD.hpp"
+#include <algorithm>  // std::fill
+#include <cmath>
 #include <iostream>
 #include <stdexcept>
 #include <vector>
 #include "Algorithm.hpp"
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
 #include "LatticeModel.hpp"
+#include "SimdKernels.hpp"
+#include "SparseSource.hpp"
+#include "StreamModel.hpp"
 
 // specifies the base class constructor to call
 // https://stackoverflow.com/questions/10282787/calling-the-base-class-
@@ -14,10 +21,31 @@ CollisionCD::CollisionCD(LatticeModel &lm
   , double diffusion_coefficient
   , double initial_density_g
   , bool is_instant)
-  : CollisionModel(lm, initial_density_g),
+  : CollisionCD(lm, lm, source_position, source_strength,
+        diffusion_coefficient, initial_density_g, is_instant)
+{}
+
+CollisionCD::CollisionCD(LatticeModel &lm
+  , const LatticeModel &flow_lm
+  , const std::vector<std::vector<std::size_t>> &source_position
+  , const std::vector<double> &source_strength
+  , double diffusion_coefficient
+  , double initial_density_g
+  , bool is_instant)
+  : CollisionModel(lm, flow_lm.u, initial_density_g),
     source {},
-    is_instant_ {is_instant}
+    is_instant_ {is_instant},
+    is_sparse_source_ {false},
+    source_nodes_(lm.GetNumberOfColumns() * lm.GetNumberOfRows()),
+    is_frozen_flow_ {false},
+    edf_factor_ (0, lm.GetNumberOfDirections()),
+    source_factor_ (0, lm.GetNumberOfDirections()),
+    u_prev_ {}
 {
+  if (flow_lm.GetNumberOfRows() != lm.GetNumberOfRows() ||
+      flow_lm.GetNumberOfColumns() != lm.GetNumberOfColumns()) {
+    throw std::runtime_error("Lattice size mismatch");
+  }
   const auto dt = lm.GetTimeStep();
   // tau_ formula from "A new scheme for source term in LBGK model for
   // convection diffusion equation"
@@ -34,45 +62,322 @@ void CollisionCD::InitSource(
   const auto nx = lm_.GetNumberOfColumns();
   const auto ny = lm_.GetNumberOfRows();
   const auto nd = lm_.GetNumberOfDimensions();
-  source.assign(nx * ny, 0.0);
+  if (is_sparse_source_) {
+    KillSource();
+  }
+  else {
+    source.assign(nx * ny, 0.0);
+  }
+  std::vector<std::size_t> nodes;
+  nodes.reserve(source_position.size());
   auto it_strength = begin(source_strength);
   for (auto pos : source_position) {
     if (pos.size() != nd) throw std::runtime_error("Dimensions mismatch");
     if (pos[0] > nx - 1) throw std::runtime_error("x value out of range");
     if (pos[1] > ny - 1) throw std::runtime_error("y value out of range");
-    source[pos[1] * nx + pos[0]] = *it_strength++;
+    nodes.push_back(pos[1] * nx + pos[0]);
+    source[nodes.back()] = *it_strength++;
   }  // pos
+  if (is_sparse_source_) source_nodes_.Assign(nodes);
 }
 
-void CollisionCD::ComputeMacroscopicProperties(
-      const std::vector<std::vector<double>> &df)
+void CollisionCD::ComputeEq(std::size_t first_row
+  , std::size_t last_row)
 {
-  rho = CollisionCD::ComputeRho(df);
+  if (!is_frozen_flow_) {
+    CollisionModel::ComputeEq(first_row, last_row);
+  }
+  else if (lm_.GetNumberOfDirections() == D2Q5::nq) {
+    ComputeFrozenEq<D2Q5>(first_row, last_row);
+  }
+  else {
+    ComputeFrozenEq<D2Q9>(first_row, last_row);
+  }
 }
 
-void CollisionCD::Collide(std::vector<std::vector<double>> &df)
+template <typename Lattice>
+void CollisionCD::ComputeFrozenEq(std::size_t first_row
+  , std::size_t last_row)
+{
+  const auto nx = lm_.GetNumberOfColumns();
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    const auto factor = edf_factor_.Direction(i);
+    auto edf_i = edf.Direction(i);
+    for (auto n = first_row * nx; n < last_row * nx; ++n) {
+      edf_i[n] = Lattice::omega[i] * rho[n] * factor[n];
+    }  // n
+  }  // i
+}
+
+void CollisionCD::ComputeMacroscopicProperties(const LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  CollisionCD::ComputeRho(df, rho, first_row, last_row);
+}
+
+void CollisionCD::Collide(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  if (lm_.GetNumberOfDirections() == D2Q5::nq) {
+    CollideSlab<D2Q5>(df, first_row, last_row);
+  }
+  else {
+    CollideSlab<D2Q9>(df, first_row, last_row);
+  }
+}
+
+template <typename Lattice>
+void CollisionCD::CollideSlab(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  if (is_sparse_source_ && !df.IsSinglePrecision()) {
+    CollideSourceNodes<Lattice>(df, first_row, last_row);
+    return;
+  }
+  const auto first_node = first_row * lm_.GetNumberOfColumns();
+  const auto last_node = last_row * lm_.GetNumberOfColumns();
+  if (df.IsSinglePrecision()) {
+    CollideKernel<Lattice>(df, first_row, last_row);
+  }
+  else if (is_frozen_flow_) {
+    CollideFrozen<Lattice>(df, first_row, last_row);
+  }
+  else {
+    const auto nn = df.GetNumberOfNodes();
+    GatherVelocity(first_row, last_row);
+    double *df_planes[Lattice::nq];
+    const double *edf_planes[Lattice::nq];
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      df_planes[i] = df.Direction(i) + first_node;
+      edf_planes[i] = edf.Direction(i) + first_node;
+    }  // i
+    const double *u_planes[Lattice::nd];
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      u_planes[d] = velocity_planes_.data() + d * nn + first_node;
+    }  // d
+    SimdCollideCD<Lattice>(last_node - first_node, df_planes, edf_planes,
+        skip.data() + first_node, u_planes, source.data() + first_node, tau_,
+        c_, cs_sqr_, lm_.GetTimeStep());
+  }
+  // only the source of the slab is cleared so slabs can run concurrently
+  if (is_instant_ && is_sparse_source_) {
+    const auto &nodes = source_nodes_.GetNodes();
+    const auto last = source_nodes_.LowerBound(last_node);
+    for (auto k = source_nodes_.LowerBound(first_node); k < last; ++k) {
+      source[nodes[k]] = 0.0;
+    }  // k
+  }
+  else if (is_instant_) {
+    std::fill(begin(source) + first_node, begin(source) + last_node, 0.0);
+  }
+}
+
+template <typename Lattice>
+void CollisionCD::CollideFrozen(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  const auto first_node = first_row * lm_.GetNumberOfColumns();
+  const auto last_node = last_row * lm_.GetNumberOfColumns();
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    auto f_i = df.Direction(i);
+    const auto edf_i = edf.Direction(i);
+    const auto factor = source_factor_.Direction(i);
+    for (auto n = first_node; n < last_node; ++n) {
+      if (skip[n]) continue;
+      // most nodes have no source, their source factors are not read
+      const auto src_i = std::abs(source[n]) > 0.0 ? Lattice::omega[i] *
+          source[n] * factor[n] : 0.0;
+      f_i[n] += (edf_i[n] - f_i[n]) / tau_ + dt_ * src_i;
+    }  // n
+  }  // i
+}
+
+template <typename Lattice>
+void CollisionCD::ComputeFlowFactors()
+{
+  const auto nn = lm_.GetNumberOfColumns() * lm_.GetNumberOfRows();
+  edf_factor_ = LatticeField(nn, Lattice::nq);
+  source_factor_ = LatticeField(nn, Lattice::nq);
+  for (auto n = 0u; n < nn; ++n) {
+    const auto u = u_[n].data();
+    auto u_sqr = 0.0;
+    for (auto d = 0u; d < Lattice::nd; ++d) u_sqr += u[d] * u[d];
+    u_sqr /= 2.0 * cs_sqr_;
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      double c_dot_u = DotVelocity<Lattice>(i, u, c_);
+      c_dot_u /= cs_sqr_;
+      edf_factor_.Direction(i)[n] = 1.0 + c_dot_u * (1.0 + c_dot_u / 2.0) -
+          u_sqr;
+      source_factor_.Direction(i)[n] = 1.0 + (1.0 - 0.5 / tau_) * c_dot_u;
+    }  // i
+  }  // n
+}
+
+template <typename Lattice>
+void CollisionCD::CollideSourceNodes(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  const auto first_node = first_row * lm_.GetNumberOfColumns();
+  const auto last_node = last_row * lm_.GetNumberOfColumns();
+  const auto &nodes = source_nodes_.GetNodes();
+  const auto first = source_nodes_.LowerBound(first_node);
+  const auto last = source_nodes_.LowerBound(last_node);
+  // the source nodes of the slab are left out of the BGK kernel, they are
+  // marked with 2 so they can be told apart from the skipped nodes
+  for (auto k = first; k < last; ++k) {
+    if (!skip[nodes[k]]) skip[nodes[k]] = 2;
+  }  // k
+  double *df_planes[Lattice::nq];
+  const double *edf_planes[Lattice::nq];
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    df_planes[i] = df.Direction(i) + first_node;
+    edf_planes[i] = edf.Direction(i) + first_node;
+  }  // i
+  SimdCollideNS<Lattice>(last_node - first_node, df_planes, edf_planes,
+      skip.data() + first_node, tau_);
+  for (auto k = first; k < last; ++k) {
+    const auto n = nodes[k];
+    if (skip[n] == 2) {
+      skip[n] = 0;
+      double *df_node[Lattice::nq];
+      const double *edf_node[Lattice::nq];
+      for (auto i = 0u; i < Lattice::nq; ++i) {
+        df_node[i] = df.Direction(i) + n;
+        edf_node[i] = edf.Direction(i) + n;
+      }  // i
+      const double *u_node[Lattice::nd];
+      for (auto d = 0u; d < Lattice::nd; ++d) u_node[d] = &u_[n][d];
+      SimdCollideCD<Lattice>(1, df_node, edf_node, skip.data() + n, u_node,
+          source.data() + n, tau_, c_, cs_sqr_, dt_);
+    }
+    if (is_instant_) source[n] = 0.0;
+  }  // k
+}
+
+template <typename Lattice>
+void CollisionCD::CollideKernel(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
 {
-  const auto nc = lm_.GetNumberOfDirections();
   const auto nx = lm_.GetNumberOfColumns();
-  const auto ny = lm_.GetNumberOfRows();
   const auto dt = lm_.GetTimeStep();
-  for (auto n = 0u; n < nx * ny; ++n) {
+  for (auto n = first_row * nx; n < last_row * nx; ++n) {
     if (!skip[n]) {
-      for (auto i = 0u; i < nc; ++i) {
-        double c_dot_u = InnerProduct(lm_.e[i], lm_.u[n]);
+      const auto u = u_[n].data();
+      for (auto i = 0u; i < Lattice::nq; ++i) {
+        double c_dot_u = DotVelocity<Lattice>(i, u, c_);
         c_dot_u /= cs_sqr_;
         // source term using forward scheme, theta = 0
-        const auto src_i = lm_.omega[i] * source[n] * (1.0 + (1.0 - 0.5 /
+        const auto src_i = Lattice::omega[i] * source[n] * (1.0 + (1.0 - 0.5 /
             tau_) * c_dot_u);
-        df[n][i] += (edf[n][i] - df[n][i]) / tau_ + dt * src_i;
+        df(n, i) += (edf(n, i) - df(n, i)) / tau_ + dt * src_i;
       }  // i
     }
   }  // n
-  if (is_instant_) CollisionCD::KillSource();
 }
 
 void CollisionCD::KillSource()
 {
-//  for (auto &node : source) node = 0.0;
-  source = std::vector<double>(source.size(), 0.0);
+  if (is_sparse_source_) {
+    for (auto n : source_nodes_.GetNodes()) source[n] = 0.0;
+    source_nodes_.Clear();
+  }
+  else {
+    std::fill(begin(source), end(source), 0.0);
+  }
+}
+
+void CollisionCD::ToggleSparseSource()
+{
+  is_sparse_source_ = !is_sparse_source_;
+  if (is_sparse_source_) {
+    UpdateSourceNodes();
+  }
+  else {
+    source_nodes_.Clear();
+  }
+}
+
+void CollisionCD::UpdateSourceNodes()
+{
+  if (!is_sparse_source_) return;
+  std::vector<std::size_t> nodes;
+  for (auto n = 0u; n < source.size(); ++n) {
+    if (std::abs(source[n]) > 0.0) nodes.push_back(n);
+  }  // n
+  source_nodes_.Assign(nodes);
+}
+
+void CollisionCD::ToggleFrozenFlow()
+{
+  is_frozen_flow_ = !is_frozen_flow_;
+  u_prev_.clear();
+  if (!is_frozen_flow_) {
+    edf_factor_ = LatticeField(0, lm_.GetNumberOfDirections());
+    source_factor_ = LatticeField(0, lm_.GetNumberOfDirections());
+  }
+  else if (lm_.GetNumberOfDirections() == D2Q5::nq) {
+    ComputeFlowFactors<D2Q5>();
+  }
+  else {
+    ComputeFlowFactors<D2Q9>();
+  }
+}
+
+bool CollisionCD::FreezeSteadyFlow(double tolerance)
+{
+  if (is_frozen_flow_) return true;
+  if (!u_prev_.empty() && CheckSteadyState(u_prev_, u_, tolerance)) {
+    ToggleFrozenFlow();
+    return true;
+  }
+  u_prev_ = u_;
+  return false;
+}
+
+bool CollisionCD::IsFlowFrozen() const
+{
+  return is_frozen_flow_;
+}
+
+const SparseSource* CollisionCD::GetSourceNodes() const
+{
+  return is_sparse_source_ ? &source_nodes_ : nullptr;
+}
+
+bool CollisionCD::IsInstant() const
+{
+  return is_instant_;
+}
+
+void CollisionCD::CollideAndStream(LatticeField &df
+  , LatticeField &df_next
+  , const StreamModel &sm
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  if (lm_.GetNumberOfDirections() == D2Q5::nq) {
+    CollideAndStreamKernel<D2Q5>(df, df_next, sm, first_row, last_row);
+  }
+  else {
+    CollideAndStreamKernel<D2Q9>(df, df_next, sm, first_row, last_row);
+  }
+}
+
+template <typename Lattice>
+void CollisionCD::CollideAndStreamKernel(LatticeField &df
+  , LatticeField &df_next
+  , const StreamModel &sm
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  sm.CollideAndStream<Lattice>(df, df_next, first_row, last_row,
+      sparse_.get(), [this](std::size_t n, double *node) {
+    CollideNode<Lattice>(n, node);
+  });
 }
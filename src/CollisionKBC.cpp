@@ -0,0 +1,83 @@
+#include "CollisionKBC.hpp"
+#include <vector>
+#include "CollisionNSF.hpp"
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
+#include "LatticeModel.hpp"
+#include "StreamModel.hpp"
+
+CollisionKBC::CollisionKBC(LatticeModel &lm
+  , double kinematic_viscosity
+  , double initial_density_f)
+  : CollisionKBC(lm, {}, {}, kinematic_viscosity, initial_density_f)
+{}
+
+CollisionKBC::CollisionKBC(LatticeModel &lm
+  , const std::vector<std::vector<std::size_t>> &source_position
+  , const std::vector<std::vector<double>> &source_strength
+  , double kinematic_viscosity
+  , double initial_density_f)
+  : CollisionNSF(lm, source_position, source_strength, kinematic_viscosity,
+        initial_density_f)
+{}
+
+void CollisionKBC::Collide(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  CollideKernel<D2Q9>(df, first_row, last_row);
+}
+
+template <typename Lattice>
+void CollisionKBC::CollideKernel(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  const auto nx = lm_.GetNumberOfColumns();
+  double node[Lattice::nq];
+  double edf_node[Lattice::nq];
+  double neq[Lattice::nq];
+  double src[Lattice::nq];
+  for (auto n = first_row * nx; n < last_row * nx; ++n) {
+    if (skip[n]) continue;
+    const auto u = lm_.u[n].data();
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      double c_dot_u = DotVelocity<Lattice>(i, u, c_);
+      c_dot_u /= cs_sqr_;
+      double src_dot_product = 0.0;
+      for (auto d = 0u; d < Lattice::nd; ++d) {
+        const auto e_id = Lattice::e[i][d] * c_;
+        src_dot_product += (e_id - u[d] + c_dot_u * e_id) * source[n][d];
+      }  // d
+      src_dot_product /= cs_sqr_ / rho[n];
+      node[i] = df(n, i);
+      edf_node[i] = edf(n, i);
+      neq[i] = node[i] - edf_node[i];
+      src[i] = Lattice::omega[i] * src_dot_product;
+    }  // i
+    RelaxNode<Lattice>(node, neq, edf_node, src);
+    for (auto i = 0u; i < Lattice::nq; ++i) df(n, i) = node[i];
+  }  // n
+}
+
+void CollisionKBC::CollideAndStream(LatticeField &df
+  , LatticeField &df_next
+  , const StreamModel &sm
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  CollideAndStreamKernel<D2Q9>(df, df_next, sm, first_row, last_row);
+}
+
+template <typename Lattice>
+void CollisionKBC::CollideAndStreamKernel(LatticeField &df
+  , LatticeField &df_next
+  , const StreamModel &sm
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  sm.CollideAndStream<Lattice>(df, df_next, first_row, last_row,
+      sparse_.get(), [this](std::size_t n, double *node) {
+    CollideNode<Lattice>(n, node);
+  });
+}
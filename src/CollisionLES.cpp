@@ -0,0 +1,122 @@
+#include "CollisionLES.hpp"
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "CollisionNSF.hpp"
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
+#include "LatticeModel.hpp"
+#include "SimdKernels.hpp"
+#include "StreamModel.hpp"
+
+CollisionLES::CollisionLES(LatticeModel &lm
+  , double kinematic_viscosity
+  , double smagorinsky_constant
+  , double initial_density_f)
+  : CollisionLES(lm, {}, {}, kinematic_viscosity, smagorinsky_constant,
+        initial_density_f)
+{}
+
+CollisionLES::CollisionLES(LatticeModel &lm
+  , const std::vector<std::vector<std::size_t>> &source_position
+  , const std::vector<std::vector<double>> &source_strength
+  , double kinematic_viscosity
+  , double smagorinsky_constant
+  , double initial_density_f)
+  : CollisionNSF(lm, source_position, source_strength, kinematic_viscosity,
+        initial_density_f),
+    smagorinsky_constant_ {smagorinsky_constant},
+    smagorinsky_factor_ {0.0}
+{
+  if (smagorinsky_constant < 0.0) {
+    throw std::runtime_error("Smagorinsky constant cannot be negative");
+  }
+  smagorinsky_factor_ = 18.0 * std::sqrt(2.0) * smagorinsky_constant *
+      smagorinsky_constant;
+}
+
+void CollisionLES::Collide(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  if (df.IsSinglePrecision()) {
+    CollideKernel<D2Q9>(df, first_row, last_row);
+    return;
+  }
+  const auto nn = df.GetNumberOfNodes();
+  const auto first_node = first_row * lm_.GetNumberOfColumns();
+  const auto last_node = last_row * lm_.GetNumberOfColumns();
+  GatherVelocity(first_row, last_row);
+  double *df_planes[D2Q9::nq];
+  const double *edf_planes[D2Q9::nq];
+  for (auto i = 0u; i < D2Q9::nq; ++i) {
+    df_planes[i] = df.Direction(i) + first_node;
+    edf_planes[i] = edf.Direction(i) + first_node;
+  }  // i
+  const double *u_planes[D2Q9::nd];
+  const double *source_d[D2Q9::nd];
+  for (auto d = 0u; d < D2Q9::nd; ++d) {
+    auto plane = source_planes_.data() + d * nn;
+    for (auto n = first_node; n < last_node; ++n) plane[n] = source[n][d];
+    u_planes[d] = velocity_planes_.data() + d * nn + first_node;
+    source_d[d] = plane + first_node;
+  }  // d
+  SimdCollideLES<D2Q9>(last_node - first_node, df_planes, edf_planes,
+      skip.data() + first_node, u_planes, source_d, rho.data() + first_node,
+      tau_, smagorinsky_factor_, c_, cs_sqr_, dt_);
+}
+
+template <typename Lattice>
+void CollisionLES::CollideKernel(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  const auto nx = lm_.GetNumberOfColumns();
+  double neq[Lattice::nq];
+  for (auto n = first_row * nx; n < last_row * nx; ++n) {
+    if (skip[n]) continue;
+    for (auto i = 0u; i < Lattice::nq; ++i) neq[i] = df(n, i) - edf(n, i);
+    const auto tau_node = ComputeNodeRelaxationTime<Lattice>(neq, rho[n]);
+    const auto u = lm_.u[n].data();
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      double c_dot_u = DotVelocity<Lattice>(i, u, c_);
+      c_dot_u /= cs_sqr_;
+      double src_dot_product = 0.0;
+      for (auto d = 0u; d < Lattice::nd; ++d) {
+        const auto e_id = Lattice::e[i][d] * c_;
+        src_dot_product += (e_id - u[d] + c_dot_u * e_id) * source[n][d];
+      }  // d
+      src_dot_product /= cs_sqr_ / rho[n];
+      const auto src_i = (1.0 - 0.5 / tau_node) * Lattice::omega[i] *
+          src_dot_product;
+      df(n, i) += (edf(n, i) - df(n, i)) / tau_node + dt_ * src_i;
+    }  // i
+  }  // n
+}
+
+void CollisionLES::CollideAndStream(LatticeField &df
+  , LatticeField &df_next
+  , const StreamModel &sm
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  CollideAndStreamKernel<D2Q9>(df, df_next, sm, first_row, last_row);
+}
+
+template <typename Lattice>
+void CollisionLES::CollideAndStreamKernel(LatticeField &df
+  , LatticeField &df_next
+  , const StreamModel &sm
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  sm.CollideAndStream<Lattice>(df, df_next, first_row, last_row,
+      sparse_.get(), [this](std::size_t n, double *node) {
+    CollideNode<Lattice>(n, node);
+  });
+}
+
+double CollisionLES::GetSmagorinskyConstant() const
+{
+  return smagorinsky_constant_;
+}
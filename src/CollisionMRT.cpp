@@ -0,0 +1,123 @@
+#include "CollisionMRT.hpp"
+#include <vector>
+#include "CollisionNSF.hpp"
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
+#include "LatticeModel.hpp"
+#include "SimdKernels.hpp"
+#include "StreamModel.hpp"
+
+CollisionMRT::CollisionMRT(LatticeModel &lm
+  , const std::vector<std::vector<std::size_t>> &source_position
+  , const std::vector<std::vector<double>> &source_strength
+  , double kinematic_viscosity
+  , double initial_density_f)
+  : CollisionNSF(lm, source_position, source_strength, kinematic_viscosity,
+        initial_density_f),
+    rates_ {},
+    relax_ {},
+    force_ {}
+{
+  const auto rate = 1.0 / tau_;
+  CollisionMRT::SetRelaxationRates(1.64, 1.54, 8.0 * (2.0 - rate) /
+      (8.0 - rate));
+}
+
+void CollisionMRT::SetRelaxationRates(double energy
+  , double energy_square
+  , double heat_flux)
+{
+  const auto rate = 1.0 / tau_;
+  // same order as the rows of D2Q9::moment
+  rates_ = {rate, energy, energy_square, rate, heat_flux, rate, heat_flux,
+      rate, rate};
+  relax_.assign(D2Q9::nq, 0.0);
+  force_.assign(D2Q9::nq, 0.0);
+  for (auto k = 0u; k < D2Q9::nq; ++k) {
+    relax_[k] = rates_[k] / D2Q9::moment_norm[k];
+    force_[k] = dt_ * (1.0 - 0.5 * rates_[k]) / D2Q9::moment_norm[k];
+  }  // k
+}
+
+void CollisionMRT::Collide(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  if (df.IsSinglePrecision()) {
+    CollideKernel<D2Q9>(df, first_row, last_row);
+    return;
+  }
+  const auto nn = df.GetNumberOfNodes();
+  const auto first_node = first_row * lm_.GetNumberOfColumns();
+  const auto last_node = last_row * lm_.GetNumberOfColumns();
+  GatherVelocity(first_row, last_row);
+  double *df_planes[D2Q9::nq];
+  const double *edf_planes[D2Q9::nq];
+  for (auto i = 0u; i < D2Q9::nq; ++i) {
+    df_planes[i] = df.Direction(i) + first_node;
+    edf_planes[i] = edf.Direction(i) + first_node;
+  }  // i
+  const double *u_planes[D2Q9::nd];
+  const double *source_d[D2Q9::nd];
+  for (auto d = 0u; d < D2Q9::nd; ++d) {
+    auto plane = source_planes_.data() + d * nn;
+    for (auto n = first_node; n < last_node; ++n) plane[n] = source[n][d];
+    u_planes[d] = velocity_planes_.data() + d * nn + first_node;
+    source_d[d] = plane + first_node;
+  }  // d
+  SimdCollideMRT<D2Q9>(last_node - first_node, df_planes, edf_planes,
+      skip.data() + first_node, u_planes, source_d, rho.data() + first_node,
+      rates_.data(), c_, cs_sqr_, dt_);
+}
+
+template <typename Lattice>
+void CollisionMRT::CollideKernel(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  const auto nx = lm_.GetNumberOfColumns();
+  double node[Lattice::nq];
+  double neq[Lattice::nq];
+  double src[Lattice::nq];
+  for (auto n = first_row * nx; n < last_row * nx; ++n) {
+    if (skip[n]) continue;
+    const auto u = lm_.u[n].data();
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      double c_dot_u = DotVelocity<Lattice>(i, u, c_);
+      c_dot_u /= cs_sqr_;
+      double src_dot_product = 0.0;
+      for (auto d = 0u; d < Lattice::nd; ++d) {
+        const auto e_id = Lattice::e[i][d] * c_;
+        src_dot_product += (e_id - u[d] + c_dot_u * e_id) * source[n][d];
+      }  // d
+      src_dot_product /= cs_sqr_ / rho[n];
+      node[i] = df(n, i);
+      neq[i] = node[i] - edf(n, i);
+      src[i] = Lattice::omega[i] * src_dot_product;
+    }  // i
+    RelaxNode<Lattice>(node, neq, src);
+    for (auto i = 0u; i < Lattice::nq; ++i) df(n, i) = node[i];
+  }  // n
+}
+
+void CollisionMRT::CollideAndStream(LatticeField &df
+  , LatticeField &df_next
+  , const StreamModel &sm
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  CollideAndStreamKernel<D2Q9>(df, df_next, sm, first_row, last_row);
+}
+
+template <typename Lattice>
+void CollisionMRT::CollideAndStreamKernel(LatticeField &df
+  , LatticeField &df_next
+  , const StreamModel &sm
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  sm.CollideAndStream<Lattice>(df, df_next, first_row, last_row,
+      sparse_.get(), [this](std::size_t n, double *node) {
+    CollideNode<Lattice>(n, node);
+  });
+}
@@ -1,74 +1,262 @@
 #include "CollisionModel.hpp"
+#include <algorithm>  // std::fill
 #include <iostream>
+#include <memory>  // std::make_shared
 #include <stdexcept>
 #include <vector>
 #include "Algorithm.hpp"
+#include "LatticeField.hpp"
 #include "LatticeModel.hpp"
+#include "SparseLattice.hpp"
+#include "StreamModel.hpp"
 
 CollisionModel::CollisionModel(LatticeModel &lm
   , double initial_density)
-  : edf {},
+  : edf (0, lm.GetNumberOfDirections()),
     rho {},
     skip {},
     lm_ (lm),
+    u_ (lm.u),
     tau_ {0},
-    c_ {lm.GetLatticeSpeed()}
+    c_ {lm.GetLatticeSpeed()},
+    dt_ {lm.GetTimeStep()},
+    velocity_planes_ {},
+    sparse_ {}
 {
   const auto nx = lm_.GetNumberOfColumns();
   const auto ny = lm_.GetNumberOfRows();
-  const auto nc = lm_.GetNumberOfDirections();
   const auto lat_size = nx * ny;
-  edf.assign(lat_size, std::vector<double>(nc, 0.0));
   rho.assign(lat_size, initial_density);
   skip.assign(lat_size, false);
-  ComputeEq();
+  velocity_planes_.assign(lm_.GetNumberOfDimensions() * lat_size, 0.0);
+  CheckVelocity();
 }
 
 CollisionModel::CollisionModel(LatticeModel &lm
   , const std::vector<double> &initial_density)
-  : edf {},
+  : edf (0, lm.GetNumberOfDirections()),
     rho {initial_density},
     skip {},
     lm_ (lm),
+    u_ (lm.u),
     tau_ {0},
-    c_ {lm.GetLatticeSpeed()}
+    c_ {lm.GetLatticeSpeed()},
+    dt_ {lm.GetTimeStep()},
+    velocity_planes_ {},
+    sparse_ {}
 {
   const auto nx = lm_.GetNumberOfColumns();
   const auto ny = lm_.GetNumberOfRows();
-  const auto nc = lm_.GetNumberOfDirections();
   const auto lat_size = nx * ny;
-  edf.assign(lat_size, std::vector<double>(nc, 0.0));
   skip.assign(lat_size, false);
-  ComputeEq();
+  velocity_planes_.assign(lm_.GetNumberOfDimensions() * lat_size, 0.0);
+  CheckVelocity();
+}
+
+CollisionModel::CollisionModel(LatticeModel &lm
+  , const std::vector<std::vector<double>> &velocity
+  , double initial_density)
+  : edf (0, lm.GetNumberOfDirections()),
+    rho {},
+    skip {},
+    lm_ (lm),
+    u_ (velocity),
+    tau_ {0},
+    c_ {lm.GetLatticeSpeed()},
+    dt_ {lm.GetTimeStep()},
+    velocity_planes_ {},
+    sparse_ {}
+{
+  const auto nx = lm_.GetNumberOfColumns();
+  const auto ny = lm_.GetNumberOfRows();
+  const auto lat_size = nx * ny;
+  rho.assign(lat_size, initial_density);
+  skip.assign(lat_size, false);
+  velocity_planes_.assign(lm_.GetNumberOfDimensions() * lat_size, 0.0);
+  CheckVelocity();
 }
 
 void CollisionModel::ComputeEq()
 {
-  auto nc = lm_.GetNumberOfDirections();
+  AllocateEq();
+  ComputeEq(0, lm_.GetNumberOfRows());
+}
+
+void CollisionModel::ComputeEq(std::size_t first_row
+  , std::size_t last_row)
+{
+  if (lm_.GetNumberOfDirections() == D2Q5::nq) {
+    ComputeEqKernel<D2Q5>(edf, first_row, last_row);
+  }
+  else {
+    ComputeEqKernel<D2Q9>(edf, first_row, last_row);
+  }
+}
+
+LatticeField CollisionModel::ComputeEqField() const
+{
+  const auto ny = lm_.GetNumberOfRows();
+  LatticeField result(ny * lm_.GetNumberOfColumns()
+    , lm_.GetNumberOfDirections());
+  if (lm_.GetNumberOfDirections() == D2Q5::nq) {
+    ComputeEqKernel<D2Q5>(result, 0, ny);
+  }
+  else {
+    ComputeEqKernel<D2Q9>(result, 0, ny);
+  }
+  return result;
+}
+
+void CollisionModel::AllocateEq()
+{
+  if (edf.GetNumberOfNodes() != 0) return;
+  edf = LatticeField(lm_.GetNumberOfRows() * lm_.GetNumberOfColumns()
+    , lm_.GetNumberOfDirections());
+}
+
+template <typename Lattice>
+void CollisionModel::ComputeEqKernel(LatticeField &result
+  , std::size_t first_row
+  , std::size_t last_row) const
+{
   auto nx = lm_.GetNumberOfColumns();
-  auto ny = lm_.GetNumberOfRows();
-  for (auto n = 0u; n < nx * ny; ++n) {
-    double u_sqr = InnerProduct(lm_.u[n], lm_.u[n]);
+  double *edf_planes[Lattice::nq];
+  for (auto i = 0u; i < Lattice::nq; ++i) edf_planes[i] = result.Direction(i);
+  for (auto n = first_row * nx; n < last_row * nx; ++n) {
+    const auto u = u_[n].data();
+    auto u_sqr = 0.0;
+    for (auto d = 0u; d < Lattice::nd; ++d) u_sqr += u[d] * u[d];
     u_sqr /= 2.0 * cs_sqr_;
-    for (auto i = 0u; i < nc; ++i) {
-      double c_dot_u = InnerProduct(lm_.e[i], lm_.u[n]);
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      double c_dot_u = DotVelocity<Lattice>(i, u, c_);
       c_dot_u /= cs_sqr_;
-      edf[n][i] = lm_.omega[i] * rho[n] * (1.0 + c_dot_u * (1.0 + c_dot_u /
-          2.0) - u_sqr);
+      edf_planes[i][n] = Lattice::omega[i] * rho[n] * (1.0 + c_dot_u * (1.0 +
+          c_dot_u / 2.0) - u_sqr);
     }  // i
   }  // n
 }
 
-std::vector<double> CollisionModel::ComputeRho(
-    const std::vector<std::vector<double>> &df)
+std::vector<double> CollisionModel::ComputeRho(const LatticeField &df)
 {
-  std::vector<double> result(df.size(), 0.0);
-  auto it_result = begin(result);
-  for (auto node : df) (*it_result++) = GetZerothMoment(node);
+  std::vector<double> result(df.GetNumberOfNodes(), 0.0);
+  ComputeRho(df, result);
   return result;
 }
 
+void CollisionModel::ComputeRho(const LatticeField &df
+  , std::vector<double> &result)
+{
+  ComputeRho(df, result, 0, lm_.GetNumberOfRows());
+}
+
+void CollisionModel::ComputeRho(const LatticeField &df
+  , std::vector<double> &result
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  const auto nc = df.GetNumberOfDirections();
+  const auto nx = lm_.GetNumberOfColumns();
+  const auto first_node = first_row * nx;
+  const auto last_node = last_row * nx;
+  std::fill(begin(result) + first_node, begin(result) + last_node, 0.0);
+  // the planes of a field streamed in place do not line up with the nodes
+  if (df.IsSwapped()) {
+    for (auto n = first_node; n < last_node; ++n) {
+      for (auto i = 0u; i < nc; ++i) result[n] += df(n, i);
+    }  // n
+  }
+  else if (df.IsSinglePrecision()) {
+    ComputeRhoKernel<float>(df, result, first_node, last_node);
+  }
+  else {
+    ComputeRhoKernel<double>(df, result, first_node, last_node);
+  }
+}
+
+void CollisionModel::ComputeMacroscopicProperties(const LatticeField &df)
+{
+  ComputeMacroscopicProperties(df, 0, lm_.GetNumberOfRows());
+}
+
+void CollisionModel::Collide(LatticeField &df)
+{
+  if (edf.GetNumberOfNodes() == 0) ComputeEq();
+  Collide(df, 0, lm_.GetNumberOfRows());
+}
+
+void CollisionModel::CollideAndStream(LatticeField &df
+  , LatticeField &df_next
+  , const StreamModel &sm)
+{
+  CollideAndStream(df, df_next, sm, 0, lm_.GetNumberOfRows());
+  sm.FinishCollideAndStream(df);
+}
+
+template <typename T>
+void CollisionModel::ComputeRhoKernel(const LatticeField &df
+  , std::vector<double> &result
+  , std::size_t first_node
+  , std::size_t last_node)
+{
+  const auto nc = df.GetNumberOfDirections();
+  // sweep one direction plane at a time so the inner loop is contiguous
+  for (auto i = 0u; i < nc; ++i) {
+    const auto df_i = df.Plane<T>(i);
+    const auto shift = df.Shift(i);
+    for (auto n = first_node; n < last_node; ++n) result[n] += shift + df_i[n];
+  }  // i
+}
+
+void CollisionModel::CheckVelocity()
+{
+  const auto nd = lm_.GetNumberOfDimensions();
+  if (u_.size() != rho.size()) throw std::runtime_error("Size mismatch");
+  for (const auto &u_node : u_) {
+    if (u_node.size() != nd) throw std::runtime_error("Size mismatch");
+  }  // u_node
+}
+
+void CollisionModel::GatherVelocity(std::size_t first_row
+  , std::size_t last_row)
+{
+  const auto nd = lm_.GetNumberOfDimensions();
+  const auto nx = lm_.GetNumberOfColumns();
+  const auto nn = rho.size();
+  for (auto d = 0u; d < nd; ++d) {
+    auto u_d = velocity_planes_.data() + d * nn;
+    for (auto n = first_row * nx; n < last_row * nx; ++n) {
+      u_d[n] = u_[n][d];
+    }  // n
+  }  // d
+}
+
 void CollisionModel::AddNodeToSkip(std::size_t n)
 {
   skip[n] = true;
 }
+
+void CollisionModel::ToggleSparseLattice()
+{
+  if (sparse_) {
+    sparse_.reset();
+  }
+  else {
+    sparse_ = std::make_shared<const SparseLattice>(lm_, skip);
+  }
+}
+
+const SparseLattice* CollisionModel::GetSparseLattice() const
+{
+  return sparse_.get();
+}
+
+double CollisionModel::GetRelaxationTime() const
+{
+  return tau_;
+}
+
+const std::vector<std::vector<double>>&
+    CollisionModel::GetAdvectingVelocity() const
+{
+  return u_;
+}
@@ -4,7 +4,11 @@
 #include <stdexcept>
 #include <vector>
 #include "Algorithm.hpp"
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
 #include "LatticeModel.hpp"
+#include "SimdKernels.hpp"
+#include "StreamModel.hpp"
 
 // specifies the base class constructor to call
 // https://stackoverflow.com/questions/10282787/calling-the-base-class-
@@ -31,36 +35,111 @@ CollisionNS::CollisionNS(LatticeModel &lm
   tau_ = 0.5 + kinematic_viscosity / cs_sqr_ / dt;
 }
 
-std::vector<std::vector<double>> CollisionNS::ComputeU(
-    const std::vector<std::vector<double>> &df)
+std::vector<std::vector<double>> CollisionNS::ComputeU(const LatticeField &df)
 {
-  std::vector<std::vector<double>> result;
-  auto index = 0u;
-  for (auto node : df) result.push_back(GetFirstMoment(node, lm_.e));
-  for (auto &node : result) {
-    for (auto &d : node) d /= rho[index];
-    ++index;
-  }  // node
+  const auto nd = lm_.GetNumberOfDimensions();
+  const auto nn = df.GetNumberOfNodes();
+  std::vector<std::vector<double>> result(nn, std::vector<double>(nd, 0.0));
+  ComputeU(df, result);
   return result;
 }
 
-void CollisionNS::ComputeMacroscopicProperties(
-      const std::vector<std::vector<double>> &df)
+void CollisionNS::ComputeU(const LatticeField &df
+  , std::vector<std::vector<double>> &result)
 {
-  rho = CollisionNS::ComputeRho(df);
-  lm_.u = CollisionNS::ComputeU(df);
+  ComputeU(df, result, 0, lm_.GetNumberOfRows());
 }
 
-void CollisionNS::Collide(std::vector<std::vector<double>> &lattice)
+void CollisionNS::ComputeU(const LatticeField &df
+  , std::vector<std::vector<double>> &result
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  ComputeUKernel<D2Q9>(df, result, first_row, last_row);
+}
+
+template <typename Lattice>
+void CollisionNS::ComputeUKernel(const LatticeField &df
+  , std::vector<std::vector<double>> &result
+  , std::size_t first_row
+  , std::size_t last_row)
 {
-  const auto nc = lm_.GetNumberOfDirections();
   const auto nx = lm_.GetNumberOfColumns();
-  const auto ny = lm_.GetNumberOfRows();
-  for (auto n = 0u; n < nx * ny; ++n) {
-    if (!skip[n]) {
-      for (auto i = 0u; i < nc; ++i) {
-        lattice[n][i] += (edf[n][i] - lattice[n][i]) / tau_;
-      }  // i
-    }
+  double node[Lattice::nq];
+  for (auto n = first_row * nx; n < last_row * nx; ++n) {
+    for (auto i = 0u; i < Lattice::nq; ++i) node[i] = df(n, i);
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      result[n][d] = FirstMoment<Lattice>(node, d, c_);
+      result[n][d] /= rho[n];
+    }  // d
   }  // n
 }
+
+void CollisionNS::ComputeMacroscopicProperties(const LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  CollisionNS::ComputeRho(df, rho, first_row, last_row);
+  CollisionNS::ComputeU(df, lm_.u, first_row, last_row);
+}
+
+void CollisionNS::Collide(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  if (df.IsSinglePrecision()) {
+    RelaxKernel<float>(df, first_row, last_row);
+    return;
+  }
+  const auto first_node = first_row * lm_.GetNumberOfColumns();
+  double *df_planes[D2Q9::nq];
+  const double *edf_planes[D2Q9::nq];
+  for (auto i = 0u; i < D2Q9::nq; ++i) {
+    df_planes[i] = df.Direction(i) + first_node;
+    edf_planes[i] = edf.Direction(i) + first_node;
+  }  // i
+  SimdCollideNS<D2Q9>((last_row - first_row) * lm_.GetNumberOfColumns(),
+      df_planes, edf_planes, skip.data() + first_node, tau_);
+}
+
+template <typename T>
+void CollisionNS::RelaxKernel(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  const auto nc = lm_.GetNumberOfDirections();
+  const auto nx = lm_.GetNumberOfColumns();
+  // sweep one direction plane at a time so the inner loop is contiguous
+  for (auto i = 0u; i < nc; ++i) {
+    auto df_i = df.Plane<T>(i);
+    const auto edf_i = edf.Direction(i);
+    const auto shift = df.Shift(i);
+    for (auto n = first_row * nx; n < last_row * nx; ++n) {
+      if (skip[n]) continue;
+      const auto value = shift + df_i[n];
+      df_i[n] = static_cast<T>(value + (edf_i[n] - value) / tau_ - shift);
+    }  // n
+  }  // i
+}
+
+void CollisionNS::CollideAndStream(LatticeField &df
+  , LatticeField &df_next
+  , const StreamModel &sm
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  CollideAndStreamKernel<D2Q9>(df, df_next, sm, first_row, last_row);
+}
+
+template <typename Lattice>
+void CollisionNS::CollideAndStreamKernel(LatticeField &df
+  , LatticeField &df_next
+  , const StreamModel &sm
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  sm.CollideAndStream<Lattice>(df, df_next, first_row, last_row,
+      sparse_.get(), [this](std::size_t n, double *node) {
+    CollideNode<Lattice>(n, node);
+  });
+}
@@ -4,7 +4,12 @@
 #include <stdexcept>
 #include <vector>
 #include "Algorithm.hpp"
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
 #include "LatticeModel.hpp"
+#include "SimdKernels.hpp"
+#include "SparseSource.hpp"
+#include "StreamModel.hpp"
 
 CollisionNSF::CollisionNSF(LatticeModel &lm
   , const std::vector<std::vector<std::size_t>> &source_position
@@ -12,7 +17,10 @@ CollisionNSF::CollisionNSF(LatticeModel &lm
   , double kinematic_viscosity
   , double initial_density_f)
   : CollisionNS(lm, kinematic_viscosity, initial_density_f),
-    source {}
+    source {},
+    source_planes_ {},
+    is_sparse_source_ {false},
+    source_nodes_(lm.GetNumberOfColumns() * lm.GetNumberOfRows())
 {
   const auto dt = lm.GetTimeStep();
   // tau_ formula from "Discrete lattice effects on the forcing term in
@@ -30,62 +38,211 @@ void CollisionNSF::InitSource(
   const auto nx = lm_.GetNumberOfColumns();
   const auto ny = lm_.GetNumberOfRows();
   const auto nd = lm_.GetNumberOfDimensions();
-  source.assign(nx * ny, std::vector<double>(nd, 0.0));
+  if (is_sparse_source_) {
+    // only the old source nodes can be nonzero
+    for (auto n : source_nodes_.GetNodes()) source[n].assign(nd, 0.0);
+    source_nodes_.Clear();
+  }
+  else {
+    source.assign(nx * ny, std::vector<double>(nd, 0.0));
+    source_planes_.assign(nd * nx * ny, 0.0);
+  }
+  std::vector<std::size_t> nodes;
+  nodes.reserve(source_position.size());
   auto it_strength = begin(source_strength);
   for (auto pos : source_position) {
     if (pos.size() != nd) throw std::runtime_error("Dimensions mismatch");
     if (pos[0] > nx - 1) throw std::runtime_error("x value out of range");
     if (pos[1] > ny - 1) throw std::runtime_error("y value out of range");
-    source[pos[1] * nx + pos[0]] = *it_strength++;
+    nodes.push_back(pos[1] * nx + pos[0]);
+    source[nodes.back()] = *it_strength++;
   }  // pos
+  if (is_sparse_source_) source_nodes_.Assign(nodes);
 }
 
-std::vector<std::vector<double>> CollisionNSF::ComputeU(
-    const std::vector<std::vector<double>> &df)
+void CollisionNSF::ToggleSparseSource()
 {
-  const auto nd = lm_.GetNumberOfDimensions();
+  is_sparse_source_ = !is_sparse_source_;
+  if (is_sparse_source_) {
+    UpdateSourceNodes();
+  }
+  else {
+    source_nodes_.Clear();
+  }
+}
+
+void CollisionNSF::UpdateSourceNodes()
+{
+  if (!is_sparse_source_) return;
+  std::vector<std::size_t> nodes;
+  for (auto n = 0u; n < source.size(); ++n) {
+    for (auto d = 0u; d < source[n].size(); ++d) {
+      if (std::abs(source[n][d]) > 0.0) {
+        nodes.push_back(n);
+        break;
+      }
+    }  // d
+  }  // n
+  source_nodes_.Assign(nodes);
+}
+
+const SparseSource* CollisionNSF::GetSourceNodes() const
+{
+  return is_sparse_source_ ? &source_nodes_ : nullptr;
+}
+
+void CollisionNSF::ComputeU(const LatticeField &df
+  , std::vector<std::vector<double>> &result
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  ComputeUKernel<D2Q9>(df, result, first_row, last_row);
+}
+
+template <typename Lattice>
+void CollisionNSF::ComputeUKernel(const LatticeField &df
+  , std::vector<std::vector<double>> &result
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  const auto nx = lm_.GetNumberOfColumns();
   const auto dt = lm_.GetTimeStep();
-  std::vector<std::vector<double>> result;
-  auto index = 0u;
-  for (auto node : df) {
-    result.push_back(GetFirstMoment(node, lm_.e));
-    for (auto d = 0u; d < nd; ++d) {
-      result[index][d] += 0.5 * dt * source[index][d] * rho[index];
-      result[index][d] /= rho[index];
+  double node[Lattice::nq];
+  for (auto n = first_row * nx; n < last_row * nx; ++n) {
+    const auto is_source_node = !is_sparse_source_ ||
+        source_nodes_.IsSourceNode(n);
+    for (auto i = 0u; i < Lattice::nq; ++i) node[i] = df(n, i);
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      result[n][d] = FirstMoment<Lattice>(node, d, c_);
+      if (is_source_node) result[n][d] += 0.5 * dt * source[n][d] * rho[n];
+      result[n][d] /= rho[n];
     }  // d
-    ++index;
+  }  // n
+}
+
+void CollisionNSF::ComputeMacroscopicProperties(const LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  CollisionNSF::ComputeRho(df, rho, first_row, last_row);
+  CollisionNSF::ComputeU(df, lm_.u, first_row, last_row);
+}
+
+void CollisionNSF::Collide(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  if (df.IsSinglePrecision()) {
+    CollideKernel<D2Q9>(df, first_row, last_row);
+    return;
   }
-  return result;
+  if (is_sparse_source_) {
+    CollideSourceNodes(df, first_row, last_row);
+    return;
+  }
+  const auto nn = df.GetNumberOfNodes();
+  const auto first_node = first_row * lm_.GetNumberOfColumns();
+  const auto last_node = last_row * lm_.GetNumberOfColumns();
+  GatherVelocity(first_row, last_row);
+  double *df_planes[D2Q9::nq];
+  const double *edf_planes[D2Q9::nq];
+  for (auto i = 0u; i < D2Q9::nq; ++i) {
+    df_planes[i] = df.Direction(i) + first_node;
+    edf_planes[i] = edf.Direction(i) + first_node;
+  }  // i
+  const double *u_planes[D2Q9::nd];
+  const double *source_d[D2Q9::nd];
+  for (auto d = 0u; d < D2Q9::nd; ++d) {
+    auto plane = source_planes_.data() + d * nn;
+    for (auto n = first_node; n < last_node; ++n) plane[n] = source[n][d];
+    u_planes[d] = velocity_planes_.data() + d * nn + first_node;
+    source_d[d] = plane + first_node;
+  }  // d
+  SimdCollideNSF<D2Q9>(last_node - first_node, df_planes, edf_planes,
+      skip.data() + first_node, u_planes, source_d, rho.data() + first_node,
+      tau_, c_, cs_sqr_, lm_.GetTimeStep());
 }
 
-void CollisionNSF::ComputeMacroscopicProperties(
-      const std::vector<std::vector<double>> &df)
+void CollisionNSF::CollideSourceNodes(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
 {
-  rho = CollisionNSF::ComputeRho(df);
-  lm_.u = CollisionNSF::ComputeU(df);
+  const auto nx = lm_.GetNumberOfColumns();
+  const auto &nodes = source_nodes_.GetNodes();
+  const auto first = source_nodes_.LowerBound(first_row * nx);
+  const auto last = source_nodes_.LowerBound(last_row * nx);
+  // the source nodes of the slab are left out of the BGK kernel, they are
+  // marked with 2 so they can be told apart from the skipped nodes
+  for (auto k = first; k < last; ++k) {
+    if (!skip[nodes[k]]) skip[nodes[k]] = 2;
+  }  // k
+  CollisionNS::Collide(df, first_row, last_row);
+  for (auto k = first; k < last; ++k) {
+    const auto n = nodes[k];
+    if (skip[n] != 2) continue;
+    skip[n] = 0;
+    double *df_node[D2Q9::nq];
+    const double *edf_node[D2Q9::nq];
+    for (auto i = 0u; i < D2Q9::nq; ++i) {
+      df_node[i] = df.Direction(i) + n;
+      edf_node[i] = edf.Direction(i) + n;
+    }  // i
+    const double *u_node[D2Q9::nd];
+    const double *source_node[D2Q9::nd];
+    for (auto d = 0u; d < D2Q9::nd; ++d) {
+      u_node[d] = &lm_.u[n][d];
+      source_node[d] = &source[n][d];
+    }  // d
+    SimdCollideNSF<D2Q9>(1, df_node, edf_node, skip.data() + n, u_node,
+        source_node, rho.data() + n, tau_, c_, cs_sqr_, dt_);
+  }  // k
 }
 
-void CollisionNSF::Collide(std::vector<std::vector<double>> &lattice)
+template <typename Lattice>
+void CollisionNSF::CollideKernel(LatticeField &df
+  , std::size_t first_row
+  , std::size_t last_row)
 {
-  const auto nc = lm_.GetNumberOfDirections();
-  const auto nd = lm_.GetNumberOfDimensions();
   const auto nx = lm_.GetNumberOfColumns();
-  const auto ny = lm_.GetNumberOfRows();
   const auto dt = lm_.GetTimeStep();
-  for (auto n = 0u; n < nx * ny; ++n) {
+  for (auto n = first_row * nx; n < last_row * nx; ++n) {
     if (!skip[n]) {
-      for (auto i = 0u; i < nc; ++i) {
-        double c_dot_u = InnerProduct(lm_.e[i], lm_.u[n]);
+      const auto u = lm_.u[n].data();
+      for (auto i = 0u; i < Lattice::nq; ++i) {
+        double c_dot_u = DotVelocity<Lattice>(i, u, c_);
         c_dot_u /= cs_sqr_;
         double src_dot_product = 0.0;
-        for (auto d = 0u; d < nd; ++d) {
-          src_dot_product += (lm_.e[i][d] - lm_.u[n][d] + c_dot_u *
-              lm_.e[i][d]) * source[n][d];
+        for (auto d = 0u; d < Lattice::nd; ++d) {
+          const auto e_id = Lattice::e[i][d] * c_;
+          src_dot_product += (e_id - u[d] + c_dot_u * e_id) * source[n][d];
         }  // d
         src_dot_product /= cs_sqr_ / rho[n];
-        const auto src_i = (1.0 - 0.5 / tau_) * lm_.omega[i] * src_dot_product;
-        lattice[n][i] += (edf[n][i] - lattice[n][i]) / tau_ + dt * src_i;
+        const auto src_i = (1.0 - 0.5 / tau_) * Lattice::omega[i] *
+            src_dot_product;
+        df(n, i) += (edf(n, i) - df(n, i)) / tau_ + dt * src_i;
       }  // i
     }
   }  // n
 }
+
+void CollisionNSF::CollideAndStream(LatticeField &df
+  , LatticeField &df_next
+  , const StreamModel &sm
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  CollideAndStreamKernel<D2Q9>(df, df_next, sm, first_row, last_row);
+}
+
+template <typename Lattice>
+void CollisionNSF::CollideAndStreamKernel(LatticeField &df
+  , LatticeField &df_next
+  , const StreamModel &sm
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  sm.CollideAndStream<Lattice>(df, df_next, first_row, last_row,
+      sparse_.get(), [this](std::size_t n, double *node) {
+    CollideNode<Lattice>(n, node);
+  });
+}
@@ -1,25 +1,60 @@
 #include "LatticeBoltzmann.hpp"
+#include <algorithm>  // std::min
 #include <cmath>  // std::fmod
+#include <functional>
 #include <iomanip>  // std::setprecision
 #include <iostream>
+#include <memory>  // std::shared_ptr, std::make_shared
+#include <numeric>  // std::accumulate
 #include <stdexcept>  // std::runtime_error
+#include <utility>  // std::swap
 #include <vector>
 #include "Algorithm.hpp"
 #include "CollisionModel.hpp"
 #include "LatticeModel.hpp"
 #include "Printing.hpp"
+#include "ThreadPool.hpp"
 #include "WriteResultsCmgui.hpp"
 
+// cache budget of the bands of a wavefront block, half of a typical L2 cache
+// so the collision model's density and velocity have room as well
+static const std::size_t g_band_cache_bytes = 1 << 20;
+
 LatticeBoltzmann::LatticeBoltzmann(LatticeModel &lm
   , CollisionModel &cm
   , StreamModel &sm)
-  : df {cm.edf},
+  : df (cm.ComputeEqField()),
     lm_ (lm),
     cm_ (cm),
     sm_ (sm),
-    bn_ {}
+    bn_ {},
+    df_next_ (sm.in_place ? 0 : df.GetNumberOfNodes(),
+        df.GetNumberOfDirections()),
+    is_fused_ {false},
+    pool_ {},
+    block_depth_ {0},
+    band_rows_ {0}
 {}
 
+LatticeBoltzmann::LatticeBoltzmann(LatticeModel &lm
+  , CollisionModel &cm
+  , StreamModel &sm
+  , std::size_t num_threads)
+  : LatticeBoltzmann(lm, cm, sm)
+{
+  pool_ = std::make_shared<ThreadPool>(num_threads);
+}
+
+LatticeBoltzmann::LatticeBoltzmann(LatticeModel &lm
+  , CollisionModel &cm
+  , StreamModel &sm
+  , ThreadPool &pool)
+  : LatticeBoltzmann(lm, cm, sm)
+{
+  // the caller owns the pool
+  pool_ = std::shared_ptr<ThreadPool>(&pool, [](ThreadPool*) {});
+}
+
 void LatticeBoltzmann::AddBoundaryNodes(BoundaryNodes *bn)
 {
   bn_.push_back(bn);
@@ -27,15 +62,258 @@ void LatticeBoltzmann::AddBoundaryNodes(BoundaryNodes *bn)
 
 void LatticeBoltzmann::TakeStep()
 {
-  cm_.ComputeEq();
-  cm_.Collide(df);
+  // link-wise boundary nodes reflect their values while the lattice streams
+  // into df_next_, which in-place streaming does not have
+  const auto is_link_wise = [this](const BoundaryNodes *bdr) {
+    return bdr->link_wise && !sm_.in_place;
+  };
+  // streaming in place always uses the fused pass
+  if (is_fused_ || sm_.in_place) {
+    // full-way bounceback only touches nodes which are not collided so it can
+    // be applied before the fused pass
+    for (auto bdr : bn_) {
+      if (bdr->prestream && !bdr->during_stream) bdr->UpdateNodes(df, false);
+    }  // bdr
+    // pushing across a periodic edge writes to other slabs, which may still
+    // be streaming into the nodes of the link-wise boundaries
+    const auto is_links_in_slab = !sm_.periodic_x && !sm_.periodic_y;
+    // every value is read and written by exactly one node so the slabs can
+    // be collided and streamed concurrently
+    ForEachSlab([&](std::size_t first_row, std::size_t last_row) {
+      cm_.CollideAndStream(df, df_next_, sm_, first_row, last_row);
+      if (!is_links_in_slab) return;
+      for (auto bdr : bn_) {
+        if (is_link_wise(bdr)) {
+          bdr->UpdateLinks(df, df_next_, first_row, last_row);
+        }
+      }  // bdr
+    });
+    if (!is_links_in_slab) {
+      ForEachSlab([&](std::size_t first_row, std::size_t last_row) {
+        for (auto bdr : bn_) {
+          if (is_link_wise(bdr)) {
+            bdr->UpdateLinks(df, df_next_, first_row, last_row);
+          }
+        }  // bdr
+      });
+    }
+    sm_.FinishCollideAndStream(df);
+    // the post-collision values leaving the lattice are still in df, or can
+    // be located through the post-collision view when streaming in place
+    if (sm_.in_place) df.SetPostCollisionView(true);
+    for (auto bdr : bn_) {
+      if (bdr->prestream && bdr->during_stream && !is_link_wise(bdr)) {
+        bdr->UpdateNodes(df, false);
+      }
+    }  // bdr
+    if (sm_.in_place) {
+      df.SetPostCollisionView(false);
+    }
+    else {
+      std::swap(df, df_next_);
+    }
+    for (auto bdr : bn_) {
+      if (bdr->during_stream && !is_link_wise(bdr)) {
+        bdr->UpdateNodes(df, true);
+      }
+      if (!bdr->prestream) bdr->UpdateNodes(df, false);
+    }  // bdr
+    return;
+  }
+  cm_.AllocateEq();
+  ForEachSlab([this](std::size_t first_row, std::size_t last_row) {
+    cm_.ComputeEq(first_row, last_row);
+    cm_.Collide(df, first_row, last_row);
+  });
   for (auto bdr : bn_) {
-    if (bdr->prestream) bdr->UpdateNodes(df, false);
+    if (bdr->prestream && !is_link_wise(bdr)) bdr->UpdateNodes(df, false);
   }  // bdr
-  df = sm_.Stream(df);
+  // stream into the second buffer and swap, no allocation in steady state.
+  // Streaming only writes the rows of the slab, so the link-wise boundaries
+  // can follow it there
+  ForEachSlab([&](std::size_t first_row, std::size_t last_row) {
+    sm_.Stream(df, df_next_, first_row, last_row);
+    for (auto bdr : bn_) {
+      if (is_link_wise(bdr)) {
+        bdr->UpdateLinks(df, df_next_, first_row, last_row);
+      }
+    }  // bdr
+  });
+  std::swap(df, df_next_);
   for (auto bdr : bn_) {
-    if (bdr->during_stream) bdr->UpdateNodes(df, true);
+    if (bdr->during_stream && !is_link_wise(bdr)) {
+      bdr->UpdateNodes(df, true);
+    }
     if (!bdr->prestream) bdr->UpdateNodes(df, false);
   }  // bdr
-  cm_.ComputeMacroscopicProperties(df);
+  ForEachSlab([this](std::size_t first_row, std::size_t last_row) {
+    cm_.ComputeMacroscopicProperties(df, first_row, last_row);
+  });
+}
+
+void LatticeBoltzmann::Advance(std::size_t num_steps)
+{
+  const auto num_threads = pool_ ? pool_->GetNumberOfThreads() : 1;
+  // the steps of a block are what the threads share
+  auto depth = block_depth_ == 0 ? std::max<std::size_t>(4, num_threads) :
+      block_depth_;
+  if (!is_fused_ || sm_.in_place || sm_.periodic_y || depth < 2) {
+    for (auto t = 0u; t < num_steps; ++t) TakeStep();
+    return;
+  }
+  auto band_rows = band_rows_;
+  if (band_rows == 0) {
+    // a block spans 3 * (depth - 1) + 1 bands of both buffers
+    const auto row_bytes = lm_.GetNumberOfColumns() *
+        df.GetNumberOfDirections() * (df.IsSinglePrecision() ? sizeof(float) :
+        sizeof(double));
+    band_rows = g_band_cache_bytes / (2 * (3 * depth - 2) * row_bytes);
+    if (band_rows == 0) band_rows = 1;
+  }
+  for (auto t = 0u; t < num_steps; t += depth) {
+    AdvanceBlock(std::min(depth, num_steps - t), band_rows);
+  }  // t
+}
+
+void LatticeBoltzmann::SetTemporalBlocking(std::size_t depth
+  , std::size_t band_rows)
+{
+  block_depth_ = depth;
+  band_rows_ = band_rows;
+}
+
+void LatticeBoltzmann::AdvanceBlock(std::size_t depth
+  , std::size_t band_rows)
+{
+  const auto ny = lm_.GetNumberOfRows();
+  const auto num_bands = (ny + band_rows - 1) / band_rows;
+  // step s reads buffer[s % 2] and streams into buffer[(s + 1) % 2]
+  LatticeField *buffer[] = {&df, &df_next_};
+  // Step s collides band w - 3 * s during sweep w, and afterwards updates the
+  // boundary nodes of the band below, which is final once its neighbours have
+  // been streamed. Streaming only reaches the neighbouring rows, so step s - 1
+  // has finished the bands around band w - 3 * s and step s + 1 is far enough
+  // behind not to overwrite values step s still reads. The lag also keeps the
+  // densities and velocities which the boundary nodes read at the values of
+  // step s, and lets the steps of a sweep run concurrently
+  const auto update_band = [&](std::size_t w, std::size_t s) {
+    auto &df_s = *buffer[s % 2];
+    auto &df_next = *buffer[(s + 1) % 2];
+    const auto band = w - 3 * s;
+    if (band < num_bands) {
+      const auto first_row = band * band_rows;
+      const auto last_row = std::min(first_row + band_rows, ny);
+      for (auto bdr : bn_) {
+        if (bdr->prestream && !bdr->during_stream) {
+          bdr->UpdateNodes(df_s, false, first_row, last_row);
+        }
+      }  // bdr
+      cm_.CollideAndStream(df_s, df_next, sm_, first_row, last_row);
+      for (auto bdr : bn_) {
+        if (bdr->prestream && bdr->during_stream) {
+          bdr->UpdateNodes(df_s, false, first_row, last_row);
+        }
+      }  // bdr
+    }
+    if (band == 0) return;
+    const auto first_row = (band - 1) * band_rows;
+    const auto last_row = std::min(first_row + band_rows, ny);
+    for (auto bdr : bn_) {
+      if (bdr->during_stream) {
+        bdr->UpdateNodes(df_next, true, first_row, last_row);
+      }
+      if (!bdr->prestream) {
+        bdr->UpdateNodes(df_next, false, first_row, last_row);
+      }
+    }  // bdr
+  };
+  for (std::size_t w = 0; w < num_bands + 3 * (depth - 1) + 1; ++w) {
+    // steps which have a band, or the boundary nodes of their last band, left
+    // to update in this sweep
+    const auto first_step = w > num_bands ? (w - num_bands + 2) / 3 : 0;
+    const auto last_step = std::min(w / 3 + 1, depth);
+    const std::function<void(std::size_t, std::size_t)> task =
+        [&](std::size_t first, std::size_t last) {
+      for (auto s = first_step + first; s < first_step + last; ++s) {
+        update_band(w, s);
+      }  // s
+    };
+    if (pool_) {
+      pool_->ParallelFor(last_step - first_step, task);
+    }
+    else {
+      task(0, last_step - first_step);
+    }
+  }  // w
+  if (depth % 2 == 1) std::swap(df, df_next_);
+}
+
+void LatticeBoltzmann::ForEachSlab(
+    const std::function<void(std::size_t, std::size_t)> &task)
+{
+  const auto ny = lm_.GetNumberOfRows();
+  if (pool_) {
+    pool_->ParallelFor(ny, task);
+  }
+  else {
+    task(0, ny);
+  }
+}
+
+void LatticeBoltzmann::ToggleFusedKernel()
+{
+  is_fused_ = !is_fused_;
+}
+
+void LatticeBoltzmann::ToggleSinglePrecision()
+{
+  const auto nc = lm_.GetNumberOfDirections();
+  const auto rho_mean = std::accumulate(begin(cm_.rho), end(cm_.rho), 0.0) /
+      cm_.rho.size();
+  std::vector<double> shift(nc, 0.0);
+  for (auto i = 0u; i < nc; ++i) shift[i] = lm_.omega[i] * rho_mean;
+  const auto is_single = !df.IsSinglePrecision();
+  df.SetSinglePrecision(is_single, shift);
+  df_next_.SetSinglePrecision(is_single, shift);
+}
+
+void LatticeBoltzmann::ToggleSparseLattice()
+{
+  cm_.ToggleSparseLattice();
+}
+
+LatticeModel& LatticeBoltzmann::GetLatticeModel()
+{
+  return lm_;
+}
+
+const LatticeModel& LatticeBoltzmann::GetLatticeModel() const
+{
+  return lm_;
+}
+
+const CollisionModel& LatticeBoltzmann::GetCollisionModel() const
+{
+  return cm_;
+}
+
+const StreamModel& LatticeBoltzmann::GetStreamModel() const
+{
+  return sm_;
+}
+
+const std::vector<BoundaryNodes*>& LatticeBoltzmann::GetBoundaryNodes() const
+{
+  return bn_;
+}
+
+const ThreadPool* LatticeBoltzmann::GetThreadPool() const
+{
+  return pool_.get();
+}
+
+std::size_t LatticeBoltzmann::GetNumberOfBytes() const
+{
+  return df.GetNumberOfBytes() + df_next_.GetNumberOfBytes() +
+      cm_.edf.GetNumberOfBytes();
 }
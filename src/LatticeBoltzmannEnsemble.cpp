@@ -0,0 +1,311 @@
+#include "LatticeBoltzmannEnsemble.hpp"
+#include <cmath>  // std::fabs
+#include <cstddef>  // std::size_t
+#include <initializer_list>
+#include <stdexcept>  // std::runtime_error
+#include <typeinfo>
+#include <utility>  // std::swap
+#include <vector>
+#include "BoundaryNodes.hpp"
+#include "CollisionNS.hpp"
+#include "CollisionNSF.hpp"
+#include "LatticeBoltzmann.hpp"
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
+#include "LatticeModel.hpp"
+#include "StreamModel.hpp"
+
+LatticeBoltzmannEnsemble::LatticeBoltzmannEnsemble()
+  : members_ {},
+    collisions_ {},
+    sources_ {},
+    nx_ {0},
+    ny_ {0},
+    c_ {0.0},
+    cs_sqr_ {0.0},
+    dt_ {0.0},
+    periodic_x_ {false},
+    periodic_y_ {false},
+    is_forced_ {false},
+    df_ (0, D2Q9::nq),
+    df_next_ (0, D2Q9::nq),
+    rho_ {},
+    velocity_ {},
+    source_ {},
+    tau_ {},
+    u_sqr_ {},
+    skip_ {},
+    skipped_nodes_ {},
+    edge_nodes_ {}
+{}
+
+void LatticeBoltzmannEnsemble::AddMember(LatticeBoltzmann &f
+  , CollisionNS &ns)
+{
+  AddMember(f, ns, nullptr);
+}
+
+void LatticeBoltzmannEnsemble::AddMember(LatticeBoltzmann &f
+  , CollisionNSF &nsf)
+{
+  AddMember(f, nsf, &nsf.source);
+}
+
+void LatticeBoltzmannEnsemble::AddMember(LatticeBoltzmann &f
+  , CollisionNS &ns
+  , const std::vector<std::vector<double>> *source)
+{
+  const auto &lm = f.GetLatticeModel();
+  const auto &sm = f.GetStreamModel();
+  if (&f.GetCollisionModel() != &ns) {
+    throw std::runtime_error("Collision model mismatch");
+  }
+  // the collision kernel of the ensemble is the BGK one, models derived from
+  // it collide differently
+  if (typeid(ns) != (source ? typeid(CollisionNSF) : typeid(CollisionNS))) {
+    throw std::runtime_error("Collision model not supported");
+  }
+  if (sm.in_place) throw std::runtime_error("In-place streaming");
+  if (f.df.IsSinglePrecision()) throw std::runtime_error("Single precision");
+  if (lm.GetNumberOfDirections() != D2Q9::nq) {
+    throw std::runtime_error("Not D2Q9");
+  }
+  if (members_.empty()) {
+    nx_ = lm.GetNumberOfColumns();
+    ny_ = lm.GetNumberOfRows();
+    c_ = lm.GetLatticeSpeed();
+    cs_sqr_ = c_ * c_ / 3.0;
+    dt_ = lm.GetTimeStep();
+    periodic_x_ = sm.periodic_x;
+    periodic_y_ = sm.periodic_y;
+    skip_ = ns.skip;
+    for (auto n = 0u; n < nx_ * ny_; ++n) {
+      const auto x = n % nx_;
+      const auto y = n / nx_;
+      if (skip_[n]) skipped_nodes_.push_back(n);
+      if (x < 2 || x + 2 >= nx_ || y < 2 || y + 2 >= ny_) {
+        edge_nodes_.push_back(n);
+      }
+    }  // n
+  }
+  else {
+    // the members share the geometry and the constants of the kernels
+    if (lm.GetNumberOfColumns() != nx_ || lm.GetNumberOfRows() != ny_ ||
+        ns.skip != skip_) {
+      throw std::runtime_error("Geometry mismatch");
+    }
+    if (std::fabs(lm.GetLatticeSpeed() - c_) > 0.0 ||
+        std::fabs(lm.GetTimeStep() - dt_) > 0.0) {
+      throw std::runtime_error("Lattice model mismatch");
+    }
+    if (sm.periodic_x != periodic_x_ || sm.periodic_y != periodic_y_) {
+      throw std::runtime_error("Stream model mismatch");
+    }
+  }
+  // the members which are already in the ensemble start from where they are
+  UpdateMembers();
+  members_.push_back(&f);
+  collisions_.push_back(&ns);
+  sources_.push_back(source);
+  if (source) is_forced_ = true;
+  const auto nk = members_.size();
+  const auto nn = nx_ * ny_;
+  const auto nc = nn * nk;
+  df_ = LatticeField(nc, D2Q9::nq);
+  df_next_ = LatticeField(nc, D2Q9::nq);
+  rho_.assign(nc, 0.0);
+  velocity_.assign(D2Q9::nd * nc, 0.0);
+  source_.assign(is_forced_ ? D2Q9::nd * nc : 0, 0.0);
+  tau_.assign(nk, 0.0);
+  u_sqr_.assign(nk, 0.0);
+  for (auto k = 0u; k < nk; ++k) {
+    const auto &df = members_[k]->df;
+    const auto &u = members_[k]->GetLatticeModel().u;
+    tau_[k] = collisions_[k]->GetRelaxationTime();
+    for (auto n = 0u; n < nn; ++n) {
+      const auto m = n * nk + k;
+      for (auto i = 0u; i < D2Q9::nq; ++i) df_.Direction(i)[m] = df(n, i);
+      rho_[m] = collisions_[k]->rho[n];
+      for (auto d = 0u; d < D2Q9::nd; ++d) {
+        velocity_[d * nc + m] = u[n][d];
+        if (sources_[k]) source_[d * nc + m] = (*sources_[k])[n][d];
+      }  // d
+    }  // n
+  }  // k
+}
+
+void LatticeBoltzmannEnsemble::TakeStep()
+{
+  if (members_.empty()) return;
+  UpdateBoundaries(Phase::BeforeCollision);
+  if (is_forced_) {
+    CollideKernel<D2Q9, true>();
+  }
+  else {
+    CollideKernel<D2Q9, false>();
+  }
+  UpdateBoundaries(Phase::AfterCollision);
+  members_.front()->GetStreamModel().StreamInterleaved(df_, df_next_,
+      members_.size());
+  std::swap(df_, df_next_);
+  UpdateBoundaries(Phase::AfterStream);
+}
+
+void LatticeBoltzmannEnsemble::UpdateMembers()
+{
+  const auto nk = members_.size();
+  const auto nn = nx_ * ny_;
+  const auto nc = nn * nk;
+  for (auto k = 0u; k < nk; ++k) {
+    auto &df = members_[k]->df;
+    auto &u = members_[k]->GetLatticeModel().u;
+    for (auto n = 0u; n < nn; ++n) {
+      const auto m = n * nk + k;
+      for (auto i = 0u; i < D2Q9::nq; ++i) df(n, i) = df_.Direction(i)[m];
+      collisions_[k]->rho[n] = rho_[m];
+      for (auto d = 0u; d < D2Q9::nd; ++d) u[n][d] = velocity_[d * nc + m];
+    }  // n
+  }  // k
+}
+
+std::size_t LatticeBoltzmannEnsemble::GetNumberOfMembers() const
+{
+  return members_.size();
+}
+
+void LatticeBoltzmannEnsemble::UpdateBoundaries(Phase phase)
+{
+  const auto is_due = [phase](const BoundaryNodes &bdr
+      , bool is_modify_stream) {
+    switch (phase) {
+      case Phase::BeforeCollision: {
+        return !is_modify_stream && bdr.prestream && !bdr.during_stream;
+      }
+      case Phase::AfterCollision: {
+        return !is_modify_stream && bdr.prestream && bdr.during_stream;
+      }
+      case Phase::AfterStream: {
+        return is_modify_stream ? bdr.during_stream : !bdr.prestream;
+      }
+      default: {
+        return false;
+      }
+    }
+  };
+  const auto nk = members_.size();
+  const auto nc = nx_ * ny_ * nk;
+  const auto &nodes = phase == Phase::BeforeCollision ? skipped_nodes_ :
+      edge_nodes_;
+  for (auto k = 0u; k < nk; ++k) {
+    auto &f = *members_[k];
+    auto is_any_due = false;
+    for (auto bdr : f.GetBoundaryNodes()) {
+      for (auto is_modify_stream : {true, false}) {
+        is_any_due = is_any_due || is_due(*bdr, is_modify_stream);
+      }  // is_modify_stream
+    }  // bdr
+    if (!is_any_due) continue;
+    // the boundary conditions work on the lattice of the member, which only
+    // needs to be up to date at the nodes they touch
+    auto &rho = collisions_[k]->rho;
+    auto &u = f.GetLatticeModel().u;
+    for (auto n : nodes) {
+      const auto m = n * nk + k;
+      for (auto i = 0u; i < D2Q9::nq; ++i) f.df(n, i) = df_.Direction(i)[m];
+      rho[n] = rho_[m];
+      for (auto d = 0u; d < D2Q9::nd; ++d) u[n][d] = velocity_[d * nc + m];
+    }  // n
+    for (auto bdr : f.GetBoundaryNodes()) {
+      for (auto is_modify_stream : {true, false}) {
+        if (is_due(*bdr, is_modify_stream)) {
+          bdr->UpdateNodes(f.df, is_modify_stream);
+        }
+      }  // is_modify_stream
+    }  // bdr
+    for (auto n : nodes) {
+      const auto m = n * nk + k;
+      for (auto i = 0u; i < D2Q9::nq; ++i) df_.Direction(i)[m] = f.df(n, i);
+    }  // n
+  }  // k
+}
+
+template <typename Lattice, bool IsForced>
+void LatticeBoltzmannEnsemble::CollideKernel()
+{
+  // same type as the loop counters so the loops over the members have a known
+  // trip count and are vectorized
+  const auto nk = static_cast<unsigned>(members_.size());
+  const auto nn = static_cast<unsigned>(nx_ * ny_);
+  const auto nc = nn * nk;
+  double *f[Lattice::nq];
+  for (auto i = 0u; i < Lattice::nq; ++i) f[i] = df_.Direction(i);
+  const auto tau = tau_.data();
+  const auto u_sqr = u_sqr_.data();
+  // the loops over the members are innermost, the members of a node are
+  // contiguous in every plane so they are updated by vector instructions
+  for (auto n = 0u; n < nn; ++n) {
+    const auto m = n * nk;
+    const auto rho = rho_.data() + m;
+    double *u[Lattice::nd];
+    const double *source[Lattice::nd];
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      u[d] = velocity_.data() + d * nc + m;
+      source[d] = IsForced ? source_.data() + d * nc + m : nullptr;
+    }  // d
+    for (auto k = 0u; k < nk; ++k) rho[k] = 0.0;
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      const auto f_i = f[i] + m;
+      for (auto k = 0u; k < nk; ++k) rho[k] += f_i[k];
+    }  // i
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      const auto u_d = u[d];
+      for (auto k = 0u; k < nk; ++k) u_d[k] = 0.0;
+      for (auto i = 0u; i < Lattice::nq; ++i) {
+        if (Lattice::e[i][d] == 0) continue;
+        const auto f_i = f[i] + m;
+        const auto e_id = Lattice::e[i][d] * c_;
+        for (auto k = 0u; k < nk; ++k) u_d[k] += f_i[k] * e_id;
+      }  // i
+      if (IsForced) {
+        const auto source_d = source[d];
+        for (auto k = 0u; k < nk; ++k) {
+          u_d[k] += 0.5 * dt_ * source_d[k] * rho[k];
+        }  // k
+      }
+      for (auto k = 0u; k < nk; ++k) u_d[k] /= rho[k];
+    }  // d
+    if (skip_[n]) continue;
+    for (auto k = 0u; k < nk; ++k) u_sqr[k] = 0.0;
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      const auto u_d = u[d];
+      for (auto k = 0u; k < nk; ++k) u_sqr[k] += u_d[k] * u_d[k];
+    }  // d
+    for (auto k = 0u; k < nk; ++k) u_sqr[k] /= 2.0 * cs_sqr_;
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      const auto f_i = f[i] + m;
+      for (auto k = 0u; k < nk; ++k) {
+        auto c_dot_u = 0.0;
+        for (auto d = 0u; d < Lattice::nd; ++d) {
+          if (Lattice::e[i][d] != 0) c_dot_u += Lattice::e[i][d] * c_ * u[d][k];
+        }  // d
+        c_dot_u /= cs_sqr_;
+        const auto edf_i = Lattice::omega[i] * rho[k] * (1.0 + c_dot_u *
+            (1.0 + c_dot_u / 2.0) - u_sqr[k]);
+        if (!IsForced) {
+          f_i[k] += (edf_i - f_i[k]) / tau[k];
+          continue;
+        }
+        auto src_dot_product = 0.0;
+        for (auto d = 0u; d < Lattice::nd; ++d) {
+          const auto e_id = Lattice::e[i][d] * c_;
+          src_dot_product += (e_id - u[d][k] + c_dot_u * e_id) *
+              source[d][k];
+        }  // d
+        src_dot_product /= cs_sqr_ / rho[k];
+        const auto src_i = (1.0 - 0.5 / tau[k]) * Lattice::omega[i] *
+            src_dot_product;
+        f_i[k] += (edf_i - f_i[k]) / tau[k] + dt_ * src_i;
+      }  // k
+    }  // i
+  }  // n
+}
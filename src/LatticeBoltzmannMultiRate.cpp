@@ -0,0 +1,162 @@
+#include "LatticeBoltzmannMultiRate.hpp"
+#include <algorithm>  // std::fill, std::min
+#include <cmath>  // std::floor, std::fabs, std::round
+#include <cstddef>  // std::size_t
+#include <stdexcept>  // std::runtime_error
+#include <vector>
+#include "CollisionModel.hpp"
+#include "LatticeBoltzmann.hpp"
+#include "LatticeModel.hpp"
+
+LatticeBoltzmannMultiRate::LatticeBoltzmannMultiRate(LatticeBoltzmann &f
+  , LatticeBoltzmann &g)
+  : f_ (f),
+    g_ (g),
+    flow_steps_ {1},
+    scalar_steps_ {1},
+    stencil_ {},
+    stencil_weights_ {},
+    u_start_ {},
+    u_end_ {},
+    u_sum_ {}
+{
+  const auto &lm_f = f.GetLatticeModel();
+  const auto &lm_g = g.GetLatticeModel();
+  // the velocity is handed over through the lattice model of g
+  if (&g.GetCollisionModel().GetAdvectingVelocity() != &lm_g.u) {
+    throw std::runtime_error("Velocity field mismatch");
+  }
+  const auto dt_f = lm_f.GetTimeStep();
+  const auto dt_g = lm_g.GetTimeStep();
+  const auto is_scalar_faster = dt_g < dt_f;
+  const auto ratio = is_scalar_faster ? dt_f / dt_g : dt_g / dt_f;
+  const auto num_steps = static_cast<std::size_t>(std::round(ratio));
+  if (std::fabs(ratio - num_steps) > 1e-9 * ratio) {
+    throw std::runtime_error("Time step ratio not an integer");
+  }
+  if (is_scalar_faster) {
+    scalar_steps_ = num_steps;
+  }
+  else {
+    flow_steps_ = num_steps;
+  }
+  const auto nx_f = lm_f.GetNumberOfColumns();
+  const auto ny_f = lm_f.GetNumberOfRows();
+  const auto nx_g = lm_g.GetNumberOfColumns();
+  const auto ny_g = lm_g.GetNumberOfRows();
+  const auto nd = lm_g.GetNumberOfDimensions();
+  const auto scale = lm_g.GetSpaceStep() / lm_f.GetSpaceStep();
+  // position of a node of g in the lattice units of f and the nodes of f it
+  // lies between, a node on the last row or column of f has no weight on
+  // the next one
+  const auto locate = [scale](std::size_t x_g
+      , std::size_t n_f
+      , std::size_t &x0
+      , std::size_t &x1) {
+    const auto x = x_g * scale;
+    if (x > (n_f - 1) * (1.0 + 1e-9)) {
+      throw std::runtime_error("Lattice size mismatch");
+    }
+    x0 = std::min(static_cast<std::size_t>(std::floor(x)), n_f - 1);
+    x1 = std::min(x0 + 1, n_f - 1);
+    return x1 == x0 ? 0.0 : x - x0;
+  };
+  stencil_.reserve(4 * nx_g * ny_g);
+  stencil_weights_.reserve(2 * nx_g * ny_g);
+  for (auto y_g = 0u; y_g < ny_g; ++y_g) {
+    std::size_t y0;
+    std::size_t y1;
+    const auto w_y = locate(y_g, ny_f, y0, y1);
+    for (auto x_g = 0u; x_g < nx_g; ++x_g) {
+      std::size_t x0;
+      std::size_t x1;
+      const auto w_x = locate(x_g, nx_f, x0, x1);
+      for (auto n : {y0 * nx_f + x0, y0 * nx_f + x1, y1 * nx_f + x0,
+          y1 * nx_f + x1}) {
+        stencil_.push_back(n);
+      }  // n
+      stencil_weights_.push_back(w_x);
+      stencil_weights_.push_back(w_y);
+    }  // x_g
+  }  // y_g
+  u_start_.assign(nd * nx_g * ny_g, 0.0);
+  u_end_.assign(nd * nx_g * ny_g, 0.0);
+  if (flow_steps_ > 1) u_sum_ = lm_f.u;
+}
+
+void LatticeBoltzmannMultiRate::TakeStep()
+{
+  if (flow_steps_ == 1) {
+    if (scalar_steps_ > 1) Interpolate(f_.GetLatticeModel().u, u_start_);
+    f_.TakeStep();
+    Interpolate(f_.GetLatticeModel().u, u_end_);
+    // each CD step sees the velocity at the end of its own time step, like a
+    // CD lattice stepped after the NS lattice
+    for (auto k = 1u; k <= scalar_steps_; ++k) {
+      SetScalarVelocity(static_cast<double>(k) / scalar_steps_);
+      g_.TakeStep();
+    }  // k
+    return;
+  }
+  for (auto &u_node : u_sum_) std::fill(begin(u_node), end(u_node), 0.0);
+  for (auto k = 0u; k < flow_steps_; ++k) {
+    f_.TakeStep();
+    const auto &u = f_.GetLatticeModel().u;
+    for (auto n = 0u; n < u.size(); ++n) {
+      for (auto d = 0u; d < u[n].size(); ++d) u_sum_[n][d] += u[n][d];
+    }  // n
+  }  // k
+  for (auto &u_node : u_sum_) {
+    for (auto &u_d : u_node) u_d /= flow_steps_;
+  }  // u_node
+  Interpolate(u_sum_, u_end_);
+  SetScalarVelocity(1.0);
+  g_.TakeStep();
+}
+
+double LatticeBoltzmannMultiRate::GetTimeStep() const
+{
+  const auto &lm = flow_steps_ > 1 ? g_.GetLatticeModel() :
+      f_.GetLatticeModel();
+  return lm.GetTimeStep();
+}
+
+std::size_t LatticeBoltzmannMultiRate::GetNumberOfFlowSteps() const
+{
+  return flow_steps_;
+}
+
+std::size_t LatticeBoltzmannMultiRate::GetNumberOfScalarSteps() const
+{
+  return scalar_steps_;
+}
+
+void LatticeBoltzmannMultiRate::Interpolate(
+    const std::vector<std::vector<double>> &u_f
+  , std::vector<double> &u_g) const
+{
+  const auto nn = stencil_weights_.size() / 2;
+  const auto nd = u_g.size() / nn;
+  for (auto n = 0u; n < nn; ++n) {
+    const auto s = stencil_.data() + 4 * n;
+    const auto w_x = stencil_weights_[2 * n];
+    const auto w_y = stencil_weights_[2 * n + 1];
+    for (auto d = 0u; d < nd; ++d) {
+      const auto lower = (1.0 - w_x) * u_f[s[0]][d] + w_x * u_f[s[1]][d];
+      const auto upper = (1.0 - w_x) * u_f[s[2]][d] + w_x * u_f[s[3]][d];
+      u_g[d * nn + n] = (1.0 - w_y) * lower + w_y * upper;
+    }  // d
+  }  // n
+}
+
+void LatticeBoltzmannMultiRate::SetScalarVelocity(double weight)
+{
+  auto &u = g_.GetLatticeModel().u;
+  const auto nn = u.size();
+  for (auto n = 0u; n < nn; ++n) {
+    for (auto d = 0u; d < u[n].size(); ++d) {
+      u[n][d] = (1.0 - weight) * u_start_[d * nn + n] + weight *
+          u_end_[d * nn + n];
+    }  // d
+  }  // n
+}
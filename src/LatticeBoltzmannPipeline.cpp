@@ -0,0 +1,67 @@
+#include "LatticeBoltzmannPipeline.hpp"
+#include <cstddef>  // std::size_t
+#include <functional>
+#include <stdexcept>  // std::runtime_error
+#include "CollisionModel.hpp"
+#include "LatticeBoltzmann.hpp"
+#include "LatticeModel.hpp"
+#include "ThreadPool.hpp"
+
+LatticeBoltzmannPipeline::LatticeBoltzmannPipeline(LatticeBoltzmann &f
+  , LatticeBoltzmann &g)
+  : f_ (f),
+    g_ (g),
+    pool_ (2)
+{
+  const auto &lm_f = f.GetLatticeModel();
+  const auto &lm_g = g.GetLatticeModel();
+  // the CD lattice cannot read the velocity the NS lattice is writing
+  if (&lm_g == &lm_f ||
+      &g.GetCollisionModel().GetAdvectingVelocity() != &lm_g.u) {
+    throw std::runtime_error("Velocity field mismatch");
+  }
+  if (lm_g.u.size() != lm_f.u.size() ||
+      lm_g.GetNumberOfDimensions() != lm_f.GetNumberOfDimensions()) {
+    throw std::runtime_error("Lattice size mismatch");
+  }
+  if (f.GetThreadPool() && f.GetThreadPool() == g.GetThreadPool()) {
+    throw std::runtime_error("Thread pool shared");
+  }
+}
+
+void LatticeBoltzmannPipeline::TakeStep()
+{
+  Advance(1);
+}
+
+void LatticeBoltzmannPipeline::Advance(std::size_t num_steps)
+{
+  if (num_steps == 0) return;
+  f_.TakeStep();
+  UpdateVelocity();
+  // the calling thread runs the first slab, the CD step, and the second
+  // thread runs the NS step one time step ahead
+  const std::function<void(std::size_t, std::size_t)> stage =
+      [this](std::size_t first, std::size_t) {
+    if (first == 0) {
+      g_.TakeStep();
+    }
+    else {
+      f_.TakeStep();
+    }
+  };
+  for (auto t = 1u; t < num_steps; ++t) {
+    pool_.ParallelFor(2, stage);
+    UpdateVelocity();
+  }  // t
+  g_.TakeStep();
+}
+
+void LatticeBoltzmannPipeline::UpdateVelocity()
+{
+  const auto &u_f = f_.GetLatticeModel().u;
+  auto &u_g = g_.GetLatticeModel().u;
+  for (auto n = 0u; n < u_f.size(); ++n) {
+    for (auto d = 0u; d < u_f[n].size(); ++d) u_g[n][d] = u_f[n][d];
+  }  // n
+}
@@ -0,0 +1,262 @@
+#include "LatticeBoltzmannSpecies.hpp"
+#include <cmath>  // std::fabs
+#include <cstddef>  // std::size_t
+#include <initializer_list>
+#include <stdexcept>  // std::runtime_error
+#include <typeinfo>
+#include <utility>  // std::swap
+#include <vector>
+#include "BoundaryNodes.hpp"
+#include "CollisionCD.hpp"
+#include "LatticeBoltzmann.hpp"
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
+#include "LatticeModel.hpp"
+#include "SparseSource.hpp"
+#include "StreamModel.hpp"
+
+LatticeBoltzmannSpecies::LatticeBoltzmannSpecies()
+  : species_ {},
+    collisions_ {},
+    nx_ {0},
+    ny_ {0},
+    nq_ {0},
+    c_ {0.0},
+    cs_sqr_ {0.0},
+    dt_ {0.0},
+    periodic_x_ {false},
+    periodic_y_ {false},
+    df_ (0, D2Q9::nq),
+    df_next_ (0, D2Q9::nq),
+    rho_ {},
+    tau_ {},
+    source_weight_ {},
+    source_ {},
+    source_nodes_ {},
+    is_instant_ {},
+    skip_ {},
+    skipped_nodes_ {},
+    edge_nodes_ {}
+{}
+
+void LatticeBoltzmannSpecies::AddSpecies(LatticeBoltzmann &g
+  , CollisionCD &cd)
+{
+  const auto &lm = g.GetLatticeModel();
+  const auto &sm = g.GetStreamModel();
+  if (&g.GetCollisionModel() != &cd) {
+    throw std::runtime_error("Collision model mismatch");
+  }
+  if (typeid(cd) != typeid(CollisionCD)) {
+    throw std::runtime_error("Collision model not supported");
+  }
+  if (sm.in_place) throw std::runtime_error("In-place streaming");
+  if (g.df.IsSinglePrecision()) throw std::runtime_error("Single precision");
+  if (species_.empty()) {
+    nx_ = lm.GetNumberOfColumns();
+    ny_ = lm.GetNumberOfRows();
+    nq_ = lm.GetNumberOfDirections();
+    c_ = lm.GetLatticeSpeed();
+    cs_sqr_ = c_ * c_ / 3.0;
+    dt_ = lm.GetTimeStep();
+    periodic_x_ = sm.periodic_x;
+    periodic_y_ = sm.periodic_y;
+    skip_ = cd.skip;
+    for (auto n = 0u; n < nx_ * ny_; ++n) {
+      const auto x = n % nx_;
+      const auto y = n / nx_;
+      if (skip_[n]) skipped_nodes_.push_back(n);
+      if (x < 2 || x + 2 >= nx_ || y < 2 || y + 2 >= ny_) {
+        edge_nodes_.push_back(n);
+      }
+    }  // n
+  }
+  else {
+    // the species share the geometry, the velocity and the constants of the
+    // kernels
+    if (lm.GetNumberOfColumns() != nx_ || lm.GetNumberOfRows() != ny_ ||
+        lm.GetNumberOfDirections() != nq_ || cd.skip != skip_) {
+      throw std::runtime_error("Geometry mismatch");
+    }
+    if (std::fabs(lm.GetLatticeSpeed() - c_) > 0.0 ||
+        std::fabs(lm.GetTimeStep() - dt_) > 0.0) {
+      throw std::runtime_error("Lattice model mismatch");
+    }
+    if (sm.periodic_x != periodic_x_ || sm.periodic_y != periodic_y_) {
+      throw std::runtime_error("Stream model mismatch");
+    }
+    if (&cd.GetAdvectingVelocity() !=
+        &collisions_.front()->GetAdvectingVelocity()) {
+      throw std::runtime_error("Velocity field mismatch");
+    }
+  }
+  // the species which are already in the set start from where they are
+  UpdateSpecies();
+  species_.push_back(&g);
+  collisions_.push_back(&cd);
+  const auto nk = species_.size();
+  const auto nn = nx_ * ny_;
+  const auto nc = nn * nk;
+  df_ = LatticeField(nc, nq_);
+  df_next_ = LatticeField(nc, nq_);
+  rho_.assign(nc, 0.0);
+  tau_.assign(nk, 0.0);
+  source_weight_.assign(nk, 0.0);
+  source_.assign(nk, 0.0);
+  for (auto k = 0u; k < nk; ++k) {
+    const auto &df = species_[k]->df;
+    tau_[k] = collisions_[k]->GetRelaxationTime();
+    source_weight_[k] = 1.0 - 0.5 / tau_[k];
+    for (auto n = 0u; n < nn; ++n) {
+      const auto m = n * nk + k;
+      for (auto i = 0u; i < nq_; ++i) df_.Direction(i)[m] = df(n, i);
+      rho_[m] = collisions_[k]->rho[n];
+    }  // n
+  }  // k
+}
+
+void LatticeBoltzmannSpecies::TakeStep()
+{
+  if (species_.empty()) return;
+  UpdateBoundaries(Phase::BeforeCollision);
+  if (nq_ == D2Q5::nq) {
+    CollideKernel<D2Q5>();
+  }
+  else {
+    CollideKernel<D2Q9>();
+  }
+  UpdateBoundaries(Phase::AfterCollision);
+  species_.front()->GetStreamModel().StreamInterleaved(df_, df_next_,
+      species_.size());
+  std::swap(df_, df_next_);
+  UpdateBoundaries(Phase::AfterStream);
+}
+
+void LatticeBoltzmannSpecies::UpdateSpecies()
+{
+  const auto nk = species_.size();
+  const auto nn = nx_ * ny_;
+  for (auto k = 0u; k < nk; ++k) {
+    auto &df = species_[k]->df;
+    for (auto n = 0u; n < nn; ++n) {
+      const auto m = n * nk + k;
+      for (auto i = 0u; i < nq_; ++i) df(n, i) = df_.Direction(i)[m];
+      collisions_[k]->rho[n] = rho_[m];
+    }  // n
+  }  // k
+}
+
+std::size_t LatticeBoltzmannSpecies::GetNumberOfSpecies() const
+{
+  return species_.size();
+}
+
+void LatticeBoltzmannSpecies::UpdateBoundaries(Phase phase)
+{
+  const auto is_due = [phase](const BoundaryNodes &bdr
+      , bool is_modify_stream) {
+    switch (phase) {
+      case Phase::BeforeCollision: {
+        return !is_modify_stream && bdr.prestream && !bdr.during_stream;
+      }
+      case Phase::AfterCollision: {
+        return !is_modify_stream && bdr.prestream && bdr.during_stream;
+      }
+      case Phase::AfterStream: {
+        return is_modify_stream ? bdr.during_stream : !bdr.prestream;
+      }
+      default: {
+        return false;
+      }
+    }
+  };
+  const auto nk = species_.size();
+  const auto &nodes = phase == Phase::BeforeCollision ? skipped_nodes_ :
+      edge_nodes_;
+  for (auto k = 0u; k < nk; ++k) {
+    auto &g = *species_[k];
+    auto is_any_due = false;
+    for (auto bdr : g.GetBoundaryNodes()) {
+      for (auto is_modify_stream : {true, false}) {
+        is_any_due = is_any_due || is_due(*bdr, is_modify_stream);
+      }  // is_modify_stream
+    }  // bdr
+    if (!is_any_due) continue;
+    // the boundary conditions work on the lattice of the species, which only
+    // needs to be up to date at the nodes they touch
+    auto &rho = collisions_[k]->rho;
+    for (auto n : nodes) {
+      const auto m = n * nk + k;
+      for (auto i = 0u; i < nq_; ++i) g.df(n, i) = df_.Direction(i)[m];
+      rho[n] = rho_[m];
+    }  // n
+    for (auto bdr : g.GetBoundaryNodes()) {
+      for (auto is_modify_stream : {true, false}) {
+        if (is_due(*bdr, is_modify_stream)) {
+          bdr->UpdateNodes(g.df, is_modify_stream);
+        }
+      }  // is_modify_stream
+    }  // bdr
+    for (auto n : nodes) {
+      const auto m = n * nk + k;
+      for (auto i = 0u; i < nq_; ++i) df_.Direction(i)[m] = g.df(n, i);
+    }  // n
+  }  // k
+}
+
+template <typename Lattice>
+void LatticeBoltzmannSpecies::CollideKernel()
+{
+  // same type as the loop counters so the loops over the species have a known
+  // trip count and are vectorized
+  const auto nk = static_cast<unsigned>(species_.size());
+  const auto nn = static_cast<unsigned>(nx_ * ny_);
+  double *f[Lattice::nq];
+  for (auto i = 0u; i < Lattice::nq; ++i) f[i] = df_.Direction(i);
+  const auto tau = tau_.data();
+  const auto source_weight = source_weight_.data();
+  const auto source = source_.data();
+  const auto &velocity = collisions_.front()->GetAdvectingVelocity();
+  source_nodes_.resize(nk);
+  is_instant_.resize(nk);
+  for (auto k = 0u; k < nk; ++k) {
+    source_nodes_[k] = collisions_[k]->GetSourceNodes();
+    is_instant_[k] = collisions_[k]->IsInstant();
+  }  // k
+  for (auto n = 0u; n < nn; ++n) {
+    const auto m = n * nk;
+    const auto rho = rho_.data() + m;
+    for (auto k = 0u; k < nk; ++k) rho[k] = 0.0;
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      const auto f_i = f[i] + m;
+      for (auto k = 0u; k < nk; ++k) rho[k] += f_i[k];
+    }  // i
+    // an instantaneous source is cleared once it has been read, skipped
+    // nodes included, see CollisionCD::CollideNode()
+    for (auto k = 0u; k < nk; ++k) {
+      auto &cd_source = collisions_[k]->source;
+      const auto is_source_node = !source_nodes_[k] ||
+          source_nodes_[k]->IsSourceNode(n);
+      source[k] = is_source_node ? cd_source[n] : 0.0;
+      if (is_instant_[k] && is_source_node) cd_source[n] = 0.0;
+    }  // k
+    if (skip_[n]) continue;
+    const auto u = velocity[n].data();
+    auto u_sqr = 0.0;
+    for (auto d = 0u; d < Lattice::nd; ++d) u_sqr += u[d] * u[d];
+    u_sqr /= 2.0 * cs_sqr_;
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      // the velocity dependent factors are the same for every species
+      const auto c_dot_u = DotVelocity<Lattice>(i, u, c_) / cs_sqr_;
+      const auto edf_factor = 1.0 + c_dot_u * (1.0 + c_dot_u / 2.0) - u_sqr;
+      const auto f_i = f[i] + m;
+      for (auto k = 0u; k < nk; ++k) {
+        const auto edf_i = Lattice::omega[i] * rho[k] * edf_factor;
+        // source term using forward scheme, theta = 0
+        const auto src_i = Lattice::omega[i] * source[k] * (1.0 +
+            source_weight[k] * c_dot_u);
+        f_i[k] += (edf_i - f_i[k]) / tau[k] + dt_ * src_i;
+      }  // k
+    }  // i
+  }  // n
+}
@@ -0,0 +1,35 @@
+#include "LatticeD2Q5.hpp"
+#include <iterator>  // std::begin, std::end
+#include <vector>
+#include "LatticeDescriptor.hpp"
+#include "LatticeModel.hpp"
+
+LatticeD2Q5::LatticeD2Q5(std::size_t num_rows
+  , std::size_t num_cols
+  , double dx
+  , double dt
+  , const std::vector<double> &initial_velocity)
+  : LatticeModel(2, 5, num_rows, num_cols, dx, dt, initial_velocity)
+{
+  // velocities and weights are copied from the compile-time descriptor used by
+  // the kernels, see LatticeD2Q9
+  e.assign(D2Q5::nq, std::vector<double>(D2Q5::nd, 0.0));
+  for (auto i = 0u; i < D2Q5::nq; ++i) {
+    for (auto d = 0u; d < D2Q5::nd; ++d) e[i][d] = D2Q5::e[i][d] * c_;
+  }  // i
+  omega.assign(std::begin(D2Q5::omega), std::end(D2Q5::omega));
+}
+
+LatticeD2Q5::LatticeD2Q5(std::size_t num_rows
+  , std::size_t num_cols
+  , double dx
+  , double dt
+  , const std::vector<std::vector<double>> &initial_velocity)
+  : LatticeModel(2, 5, num_rows, num_cols, dx, dt, initial_velocity)
+{
+  e.assign(D2Q5::nq, std::vector<double>(D2Q5::nd, 0.0));
+  for (auto i = 0u; i < D2Q5::nq; ++i) {
+    for (auto d = 0u; d < D2Q5::nd; ++d) e[i][d] = D2Q5::e[i][d] * c_;
+  }  // i
+  omega.assign(std::begin(D2Q5::omega), std::end(D2Q5::omega));
+}
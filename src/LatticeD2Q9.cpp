@@ -1,7 +1,9 @@
 #include "LatticeD2Q9.hpp"
 #include <iostream>
+#include <iterator>  // std::begin, std::end
 #include <vector>
 #include "Algorithm.hpp"
+#include "LatticeDescriptor.hpp"
 #include "LatticeModel.hpp"
 
 LatticeD2Q9::LatticeD2Q9(std::size_t num_rows
@@ -19,17 +21,15 @@ LatticeD2Q9::LatticeD2Q9(std::size_t num_rows
 
   // cannot pass e_d2q9 to LatticeModel and initialize it in LatticeModel
   // initializer list so have to do it here.
-  e = {{0, 0},
-       {1, 0}, {0, 1}, {-1, 0}, {0, -1},
-       {1, 1}, {-1, 1}, {-1, -1}, {1, -1}};
-  // set e to contain values of c_ in it according to "Viscous flow computations
-  // with the method of lattice Boltzmann equation
-  for (auto &i : e) {
-    for (auto &d : i) d *= c_;
+  // velocities and weights are copied from the compile-time descriptor used by
+  // the kernels so both always agree. Set e to contain values of c_ in it
+  // according to "Viscous flow computations with the method of lattice
+  // Boltzmann equation
+  e.assign(D2Q9::nq, std::vector<double>(D2Q9::nd, 0.0));
+  for (auto i = 0u; i < D2Q9::nq; ++i) {
+    for (auto d = 0u; d < D2Q9::nd; ++d) e[i][d] = D2Q9::e[i][d] * c_;
   }  // i
-  omega = {16.0 / 36.0,
-           4.0 / 36.0, 4.0 / 36.0, 4.0 / 36.0, 4.0 / 36.0,
-           1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0};
+  omega.assign(std::begin(D2Q9::omega), std::end(D2Q9::omega));
 }
 
 LatticeD2Q9::LatticeD2Q9(std::size_t num_rows
@@ -39,13 +39,9 @@ LatticeD2Q9::LatticeD2Q9(std::size_t num_rows
   , const std::vector<std::vector<double>> &initial_velocity)
   : LatticeModel(2, 9, num_rows, num_cols, dx, dt, initial_velocity)
 {
-  e = {{0, 0},
-       {1, 0}, {0, 1}, {-1, 0}, {0, -1},
-       {1, 1}, {-1, 1}, {-1, -1}, {1, -1}};
-  for (auto &i : e) {
-    for (auto &d : i) d *= c_;
+  e.assign(D2Q9::nq, std::vector<double>(D2Q9::nd, 0.0));
+  for (auto i = 0u; i < D2Q9::nq; ++i) {
+    for (auto d = 0u; d < D2Q9::nd; ++d) e[i][d] = D2Q9::e[i][d] * c_;
   }  // i
-  omega = {16.0 / 36.0,
-           4.0 / 36.0, 4.0 / 36.0, 4.0 / 36.0, 4.0 / 36.0,
-           1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0};
+  omega.assign(std::begin(D2Q9::omega), std::end(D2Q9::omega));
 }
@@ -0,0 +1,22 @@
+#include "LatticeDescriptor.hpp"
+#include <cstddef>  // std::size_t
+
+constexpr std::size_t D2Q9::nd;
+constexpr std::size_t D2Q9::nq;
+constexpr int D2Q9::e[D2Q9::nq][D2Q9::nd];
+constexpr double D2Q9::omega[D2Q9::nq];
+constexpr std::size_t D2Q9::opposite[D2Q9::nq];
+constexpr int D2Q9::moment[D2Q9::nq][D2Q9::nq];
+constexpr double D2Q9::moment_norm[D2Q9::nq];
+
+constexpr std::size_t D2Q5::nd;
+constexpr std::size_t D2Q5::nq;
+constexpr int D2Q5::e[D2Q5::nq][D2Q5::nd];
+constexpr double D2Q5::omega[D2Q5::nq];
+constexpr std::size_t D2Q5::opposite[D2Q5::nq];
+
+constexpr std::size_t D3Q19::nd;
+constexpr std::size_t D3Q19::nq;
+constexpr int D3Q19::e[D3Q19::nq][D3Q19::nd];
+constexpr double D3Q19::omega[D3Q19::nq];
+constexpr std::size_t D3Q19::opposite[D3Q19::nq];
@@ -0,0 +1,147 @@
+#include "LatticeField.hpp"
+#include <stdexcept>  // std::runtime_error
+#include <vector>
+#include "StreamModel.hpp"
+
+LatticeField::LatticeField(std::size_t num_nodes
+  , std::size_t num_dirs)
+  : number_of_nodes_ {num_nodes},
+    number_of_directions_ {num_dirs},
+    stride_ {0},
+    data_ {},
+    single_data_ {},
+    shift_ (num_dirs, 0.0),
+    is_single_ {false},
+    stream_ {nullptr},
+    is_swapped_ {false},
+    is_post_collision_ {false}
+{
+  const auto values_per_line = alignment_ / sizeof(double);
+  stride_ = (num_nodes + values_per_line - 1) / values_per_line *
+      values_per_line;
+  data_.assign(stride_ * num_dirs, 0.0);
+}
+
+LatticeField::LatticeField(const std::vector<std::vector<double>> &nodes)
+  : LatticeField(nodes.size(), nodes.empty() ? 0 : nodes[0].size())
+{
+  for (auto n = 0u; n < number_of_nodes_; ++n) SetNode(n, nodes[n]);
+}
+
+std::vector<double> LatticeField::GetNode(std::size_t n) const
+{
+  std::vector<double> result(number_of_directions_, 0.0);
+  GetNode(n, result);
+  return result;
+}
+
+void LatticeField::GetNode(std::size_t n
+  , std::vector<double> &node) const
+{
+  node.resize(number_of_directions_);
+  for (auto i = 0u; i < number_of_directions_; ++i) node[i] = (*this)(n, i);
+}
+
+void LatticeField::SetNode(std::size_t n
+  , const std::vector<double> &node)
+{
+  if (node.size() != number_of_directions_) {
+    throw std::runtime_error("Size mismatch");
+  }
+  for (auto i = 0u; i < number_of_directions_; ++i) (*this)(n, i) = node[i];
+}
+
+void LatticeField::Assign(const std::vector<double> &node)
+{
+  for (auto n = 0u; n < number_of_nodes_; ++n) SetNode(n, node);
+}
+
+std::vector<std::vector<double>> LatticeField::GetNodes() const
+{
+  std::vector<std::vector<double>> result;
+  result.reserve(number_of_nodes_);
+  for (auto n = 0u; n < number_of_nodes_; ++n) result.push_back(GetNode(n));
+  return result;
+}
+
+std::size_t LatticeField::GetNumberOfNodes() const
+{
+  return number_of_nodes_;
+}
+
+std::size_t LatticeField::GetNumberOfDirections() const
+{
+  return number_of_directions_;
+}
+
+std::size_t LatticeField::GetNumberOfBytes() const
+{
+  return data_.size() * sizeof(double) + single_data_.size() * sizeof(float);
+}
+
+void LatticeField::SetLayout(const StreamModel *sm
+  , bool is_swapped)
+{
+  stream_ = sm;
+  is_swapped_ = sm && is_swapped;
+  is_post_collision_ = false;
+}
+
+void LatticeField::SetPostCollisionView(bool is_post_collision)
+{
+  is_post_collision_ = is_post_collision;
+}
+
+bool LatticeField::IsSwapped() const
+{
+  return is_swapped_;
+}
+
+bool LatticeField::IsPlainLayout() const
+{
+  return stream_ == nullptr;
+}
+
+void LatticeField::SetSinglePrecision(bool is_single
+  , const std::vector<double> &shift)
+{
+  if (shift.size() != number_of_directions_) {
+    throw std::runtime_error("Size mismatch");
+  }
+  if (is_single == is_single_) return;
+  // convert the raw planes, the layout only changes where values are stored
+  const auto size = stride_ * number_of_directions_;
+  if (is_single) {
+    shift_ = shift;
+    single_data_.assign(size, 0.0f);
+    for (auto i = 0u; i < number_of_directions_; ++i) {
+      const auto plane = i * stride_;
+      for (auto n = plane; n < plane + number_of_nodes_; ++n) {
+        single_data_[n] = static_cast<float>(data_[n] - shift_[i]);
+      }  // n
+    }  // i
+    data_ = decltype(data_)();
+  }
+  else {
+    data_.assign(size, 0.0);
+    for (auto i = 0u; i < number_of_directions_; ++i) {
+      const auto plane = i * stride_;
+      for (auto n = plane; n < plane + number_of_nodes_; ++n) {
+        data_[n] = shift_[i] + single_data_[n];
+      }  // n
+    }  // i
+    single_data_ = decltype(single_data_)();
+  }
+  is_single_ = is_single;
+}
+
+bool LatticeField::IsSinglePrecision() const
+{
+  return is_single_;
+}
+
+void LatticeField::RemapInPlace(std::size_t &n
+  , std::size_t &i) const
+{
+  stream_->Locate(n, i, is_swapped_, is_post_collision_);
+}
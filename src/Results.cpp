@@ -113,9 +113,11 @@ void Results::WriteResult(int time)
   if (cd_) {
     data.push_back(std::vector<double>());
     const auto m = data.size() - 1;
-    for (auto n : g_->df) {
+    for (auto n = 0u; n < nx * ny; ++n) {
       auto temp = 0.0;
-      for (auto i : n) temp += i;
+      for (auto i = 0u; i < g_->df.GetNumberOfDirections(); ++i) {
+        temp += g_->df(n, i);
+      }  // i
       data[m].push_back(temp);
     }  // n
     data.push_back(cd_->rho);
@@ -0,0 +1,1274 @@
+#include "SimdKernels.hpp"
+#include <cmath>  // std::sqrt
+#include <cstddef>  // std::size_t
+#include <cstring>  // std::memcpy
+#include <stdexcept>  // std::runtime_error
+#include "LatticeDescriptor.hpp"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LBM_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// Kernels of each level are written out separately since a function can only
+// use the instructions of its own target. The vector kernels mirror the
+// scalar ones operation by operation, contraction into fused multiply-add is
+// turned off so every level rounds the same way
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+static SimdLevel g_simd_level = GetSupportedSimdLevel();
+
+SimdLevel GetSupportedSimdLevel()
+{
+#ifdef LBM_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return SimdLevel::Avx512;
+  if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+#endif
+  return SimdLevel::Scalar;
+}
+
+SimdLevel GetSimdLevel()
+{
+  return g_simd_level;
+}
+
+void SetSimdLevel(SimdLevel level)
+{
+  if (level > GetSupportedSimdLevel()) {
+    throw std::runtime_error("SIMD level not supported");
+  }
+  g_simd_level = level;
+}
+
+const char* GetSimdLevelName(SimdLevel level)
+{
+  switch (level) {
+    case SimdLevel::Scalar:
+      return "Scalar";
+    case SimdLevel::Avx2:
+      return "AVX2";
+    case SimdLevel::Avx512:
+      return "AVX-512";
+    default:
+      return "Unknown";
+  }
+}
+
+template <typename Lattice>
+static void CollideNSNode(std::size_t n
+  , double *const *df
+  , const double *const *edf
+  , double tau)
+{
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    df[i][n] += (edf[i][n] - df[i][n]) / tau;
+  }  // i
+}
+
+template <typename Lattice>
+static void CollideNSFNode(std::size_t n
+  , double *const *df
+  , const double *const *edf
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , double tau
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  double u_node[Lattice::nd];
+  for (auto d = 0u; d < Lattice::nd; ++d) u_node[d] = u[d][n];
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    double c_dot_u = DotVelocity<Lattice>(i, u_node, c);
+    c_dot_u /= cs_sqr;
+    double src_dot_product = 0.0;
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      const auto e_id = Lattice::e[i][d] * c;
+      src_dot_product += (e_id - u_node[d] + c_dot_u * e_id) * source[d][n];
+    }  // d
+    src_dot_product /= cs_sqr / rho[n];
+    const auto src_i = (1.0 - 0.5 / tau) * Lattice::omega[i] *
+        src_dot_product;
+    df[i][n] += (edf[i][n] - df[i][n]) / tau + dt * src_i;
+  }  // i
+}
+
+template <typename Lattice>
+static void CollideCDNode(std::size_t n
+  , double *const *df
+  , const double *const *edf
+  , const double *const *u
+  , const double *source
+  , double tau
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  double u_node[Lattice::nd];
+  for (auto d = 0u; d < Lattice::nd; ++d) u_node[d] = u[d][n];
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    double c_dot_u = DotVelocity<Lattice>(i, u_node, c);
+    c_dot_u /= cs_sqr;
+    // source term using forward scheme, theta = 0
+    const auto src_i = Lattice::omega[i] * source[n] * (1.0 + (1.0 - 0.5 /
+        tau) * c_dot_u);
+    df[i][n] += (edf[i][n] - df[i][n]) / tau + dt * src_i;
+  }  // i
+}
+template <typename Lattice>
+static void GuoSourceNode(std::size_t n
+  , const double *u_node
+  , const double *const *source
+  , const double *rho
+  , double c
+  , double cs_sqr
+  , double *src)
+{
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    double c_dot_u = DotVelocity<Lattice>(i, u_node, c);
+    c_dot_u /= cs_sqr;
+    double src_dot_product = 0.0;
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      const auto e_id = Lattice::e[i][d] * c;
+      src_dot_product += (e_id - u_node[d] + c_dot_u * e_id) * source[d][n];
+    }  // d
+    src_dot_product /= cs_sqr / rho[n];
+    src[i] = Lattice::omega[i] * src_dot_product;
+  }  // i
+}
+
+template <typename Lattice>
+static void CollideTRTNode(std::size_t n
+  , double *const *df
+  , const double *const *edf
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , double tau_plus
+  , double tau_minus
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  double u_node[Lattice::nd];
+  for (auto d = 0u; d < Lattice::nd; ++d) u_node[d] = u[d][n];
+  double src[Lattice::nq];
+  double neq[Lattice::nq];
+  GuoSourceNode<Lattice>(n, u_node, source, rho, c, cs_sqr, src);
+  for (auto i = 0u; i < Lattice::nq; ++i) neq[i] = df[i][n] - edf[i][n];
+  const auto factor_plus = 1.0 - 0.5 / tau_plus;
+  const auto factor_minus = 1.0 - 0.5 / tau_minus;
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    const auto j = Lattice::opposite[i];
+    const auto neq_plus = 0.5 * (neq[i] + neq[j]);
+    const auto neq_minus = 0.5 * (neq[i] - neq[j]);
+    const auto src_plus = 0.5 * (src[i] + src[j]);
+    const auto src_minus = 0.5 * (src[i] - src[j]);
+    df[i][n] += dt * (factor_plus * src_plus + factor_minus * src_minus) -
+        (neq_plus / tau_plus + neq_minus / tau_minus);
+  }  // i
+}
+
+template <typename Lattice>
+static void CollideMRTNode(std::size_t n
+  , double *const *df
+  , const double *const *edf
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , const double *relax
+  , const double *force
+  , double c
+  , double cs_sqr)
+{
+  double u_node[Lattice::nd];
+  for (auto d = 0u; d < Lattice::nd; ++d) u_node[d] = u[d][n];
+  double src[Lattice::nq];
+  double neq[Lattice::nq];
+  GuoSourceNode<Lattice>(n, u_node, source, rho, c, cs_sqr, src);
+  for (auto i = 0u; i < Lattice::nq; ++i) neq[i] = df[i][n] - edf[i][n];
+  double m[Lattice::nq];
+  for (auto k = 0u; k < Lattice::nq; ++k) {
+    auto m_neq = 0.0;
+    auto m_src = 0.0;
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      if (Lattice::moment[k][i] == 0) continue;
+      m_neq += Lattice::moment[k][i] * neq[i];
+      m_src += Lattice::moment[k][i] * src[i];
+    }  // i
+    m[k] = relax[k] * m_neq - force[k] * m_src;
+  }  // k
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    auto delta = 0.0;
+    for (auto k = 0u; k < Lattice::nq; ++k) {
+      if (Lattice::moment[k][i] != 0) delta += Lattice::moment[k][i] * m[k];
+    }  // k
+    df[i][n] -= delta;
+  }  // i
+}
+
+template <typename Lattice>
+static void CollideLESNode(std::size_t n
+  , double *const *df
+  , const double *const *edf
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , double tau
+  , double smagorinsky_factor
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  double neq[Lattice::nq];
+  for (auto i = 0u; i < Lattice::nq; ++i) neq[i] = df[i][n] - edf[i][n];
+  const auto tau_node = 0.5 * (tau + std::sqrt(tau * tau + smagorinsky_factor *
+      SecondMomentNorm<Lattice>(neq) / rho[n]));
+  CollideNSFNode<Lattice>(n, df, edf, u, source, rho, tau_node, c, cs_sqr,
+      dt);
+}
+
+#ifdef LBM_X86_SIMD
+/**
+ * Loads the skip flags of 4 nodes
+ * \param skip skip flag of the first node
+ * \return all bits set in the lanes of the nodes which are collided
+ */
+__attribute__((target("avx2")))
+static __m256i KeepMaskAvx2(const char *skip)
+{
+  int flags;
+  std::memcpy(&flags, skip, sizeof(flags));
+  const auto skip_v = _mm256_cvtepi8_epi64(_mm_cvtsi32_si128(flags));
+  return _mm256_cmpeq_epi64(skip_v, _mm256_setzero_si256());
+}
+
+/**
+ * Loads the skip flags of 8 nodes
+ * \param skip skip flag of the first node
+ * \return bits set for the nodes which are collided
+ */
+__attribute__((target("avx512f")))
+static __mmask8 KeepMaskAvx512(const char *skip)
+{
+  long long flags;
+  std::memcpy(&flags, skip, sizeof(flags));
+  const auto is_kept = _mm_cmpeq_epi8(_mm_set_epi64x(0, flags),
+      _mm_setzero_si128());
+  return static_cast<__mmask8>(_mm_movemask_epi8(is_kept) & 0xff);
+}
+
+template <typename Lattice>
+__attribute__((target("avx2")))
+static std::size_t CollideNSAvx2(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , double tau)
+{
+  const auto tau_v = _mm256_set1_pd(tau);
+  auto n = std::size_t {0};
+  for (; n + 4 <= num_nodes; n += 4) {
+    const auto keep = KeepMaskAvx2(skip + n);
+    if (_mm256_testz_si256(keep, keep)) continue;
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      const auto f = _mm256_loadu_pd(df[i] + n);
+      const auto feq = _mm256_loadu_pd(edf[i] + n);
+      _mm256_maskstore_pd(df[i] + n, keep, _mm256_add_pd(f,
+          _mm256_div_pd(_mm256_sub_pd(feq, f), tau_v)));
+    }  // i
+  }  // n
+  return n;
+}
+
+template <typename Lattice>
+__attribute__((target("avx512f")))
+static std::size_t CollideNSAvx512(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , double tau)
+{
+  const auto tau_v = _mm512_set1_pd(tau);
+  auto n = std::size_t {0};
+  for (; n + 8 <= num_nodes; n += 8) {
+    const auto keep = KeepMaskAvx512(skip + n);
+    if (!keep) continue;
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      const auto f = _mm512_loadu_pd(df[i] + n);
+      const auto feq = _mm512_loadu_pd(edf[i] + n);
+      _mm512_mask_storeu_pd(df[i] + n, keep, _mm512_add_pd(f,
+          _mm512_div_pd(_mm512_sub_pd(feq, f), tau_v)));
+    }  // i
+  }  // n
+  return n;
+}
+
+template <typename Lattice>
+__attribute__((target("avx2")))
+static std::size_t CollideNSFAvx2(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , double tau
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  const auto tau_v = _mm256_set1_pd(tau);
+  const auto cs_sqr_v = _mm256_set1_pd(cs_sqr);
+  const auto dt_v = _mm256_set1_pd(dt);
+  auto n = std::size_t {0};
+  for (; n + 4 <= num_nodes; n += 4) {
+    const auto keep = KeepMaskAvx2(skip + n);
+    if (_mm256_testz_si256(keep, keep)) continue;
+    __m256d u_v[Lattice::nd];
+    __m256d source_v[Lattice::nd];
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      u_v[d] = _mm256_loadu_pd(u[d] + n);
+      source_v[d] = _mm256_loadu_pd(source[d] + n);
+    }  // d
+    const auto scale = _mm256_div_pd(cs_sqr_v, _mm256_loadu_pd(rho + n));
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      auto c_dot_u = _mm256_setzero_pd();
+      for (auto d = 0u; d < Lattice::nd; ++d) {
+        if (Lattice::e[i][d] == 0) continue;
+        c_dot_u = _mm256_add_pd(c_dot_u, _mm256_mul_pd(_mm256_set1_pd(
+            Lattice::e[i][d] * c), u_v[d]));
+      }  // d
+      c_dot_u = _mm256_div_pd(c_dot_u, cs_sqr_v);
+      auto src_dot_product = _mm256_setzero_pd();
+      for (auto d = 0u; d < Lattice::nd; ++d) {
+        const auto e_id = _mm256_set1_pd(Lattice::e[i][d] * c);
+        src_dot_product = _mm256_add_pd(src_dot_product, _mm256_mul_pd(
+            _mm256_add_pd(_mm256_sub_pd(e_id, u_v[d]), _mm256_mul_pd(c_dot_u,
+            e_id)), source_v[d]));
+      }  // d
+      src_dot_product = _mm256_div_pd(src_dot_product, scale);
+      const auto src_i = _mm256_mul_pd(_mm256_set1_pd((1.0 - 0.5 / tau) *
+          Lattice::omega[i]), src_dot_product);
+      const auto f = _mm256_loadu_pd(df[i] + n);
+      const auto feq = _mm256_loadu_pd(edf[i] + n);
+      _mm256_maskstore_pd(df[i] + n, keep, _mm256_add_pd(f, _mm256_add_pd(
+          _mm256_div_pd(_mm256_sub_pd(feq, f), tau_v), _mm256_mul_pd(dt_v,
+          src_i))));
+    }  // i
+  }  // n
+  return n;
+}
+
+template <typename Lattice>
+__attribute__((target("avx512f")))
+static std::size_t CollideNSFAvx512(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , double tau
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  const auto tau_v = _mm512_set1_pd(tau);
+  const auto cs_sqr_v = _mm512_set1_pd(cs_sqr);
+  const auto dt_v = _mm512_set1_pd(dt);
+  auto n = std::size_t {0};
+  for (; n + 8 <= num_nodes; n += 8) {
+    const auto keep = KeepMaskAvx512(skip + n);
+    if (!keep) continue;
+    __m512d u_v[Lattice::nd];
+    __m512d source_v[Lattice::nd];
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      u_v[d] = _mm512_loadu_pd(u[d] + n);
+      source_v[d] = _mm512_loadu_pd(source[d] + n);
+    }  // d
+    const auto scale = _mm512_div_pd(cs_sqr_v, _mm512_loadu_pd(rho + n));
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      auto c_dot_u = _mm512_setzero_pd();
+      for (auto d = 0u; d < Lattice::nd; ++d) {
+        if (Lattice::e[i][d] == 0) continue;
+        c_dot_u = _mm512_add_pd(c_dot_u, _mm512_mul_pd(_mm512_set1_pd(
+            Lattice::e[i][d] * c), u_v[d]));
+      }  // d
+      c_dot_u = _mm512_div_pd(c_dot_u, cs_sqr_v);
+      auto src_dot_product = _mm512_setzero_pd();
+      for (auto d = 0u; d < Lattice::nd; ++d) {
+        const auto e_id = _mm512_set1_pd(Lattice::e[i][d] * c);
+        src_dot_product = _mm512_add_pd(src_dot_product, _mm512_mul_pd(
+            _mm512_add_pd(_mm512_sub_pd(e_id, u_v[d]), _mm512_mul_pd(c_dot_u,
+            e_id)), source_v[d]));
+      }  // d
+      src_dot_product = _mm512_div_pd(src_dot_product, scale);
+      const auto src_i = _mm512_mul_pd(_mm512_set1_pd((1.0 - 0.5 / tau) *
+          Lattice::omega[i]), src_dot_product);
+      const auto f = _mm512_loadu_pd(df[i] + n);
+      const auto feq = _mm512_loadu_pd(edf[i] + n);
+      _mm512_mask_storeu_pd(df[i] + n, keep, _mm512_add_pd(f, _mm512_add_pd(
+          _mm512_div_pd(_mm512_sub_pd(feq, f), tau_v), _mm512_mul_pd(dt_v,
+          src_i))));
+    }  // i
+  }  // n
+  return n;
+}
+
+template <typename Lattice>
+__attribute__((target("avx2")))
+static std::size_t CollideCDAvx2(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *source
+  , double tau
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  const auto tau_v = _mm256_set1_pd(tau);
+  const auto cs_sqr_v = _mm256_set1_pd(cs_sqr);
+  const auto dt_v = _mm256_set1_pd(dt);
+  const auto one_v = _mm256_set1_pd(1.0);
+  const auto factor_v = _mm256_set1_pd(1.0 - 0.5 / tau);
+  auto n = std::size_t {0};
+  for (; n + 4 <= num_nodes; n += 4) {
+    const auto keep = KeepMaskAvx2(skip + n);
+    if (_mm256_testz_si256(keep, keep)) continue;
+    __m256d u_v[Lattice::nd];
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      u_v[d] = _mm256_loadu_pd(u[d] + n);
+    }  // d
+    const auto source_v = _mm256_loadu_pd(source + n);
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      auto c_dot_u = _mm256_setzero_pd();
+      for (auto d = 0u; d < Lattice::nd; ++d) {
+        if (Lattice::e[i][d] == 0) continue;
+        c_dot_u = _mm256_add_pd(c_dot_u, _mm256_mul_pd(_mm256_set1_pd(
+            Lattice::e[i][d] * c), u_v[d]));
+      }  // d
+      c_dot_u = _mm256_div_pd(c_dot_u, cs_sqr_v);
+      const auto src_i = _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(
+          Lattice::omega[i]), source_v), _mm256_add_pd(one_v, _mm256_mul_pd(
+          factor_v, c_dot_u)));
+      const auto f = _mm256_loadu_pd(df[i] + n);
+      const auto feq = _mm256_loadu_pd(edf[i] + n);
+      _mm256_maskstore_pd(df[i] + n, keep, _mm256_add_pd(f, _mm256_add_pd(
+          _mm256_div_pd(_mm256_sub_pd(feq, f), tau_v), _mm256_mul_pd(dt_v,
+          src_i))));
+    }  // i
+  }  // n
+  return n;
+}
+
+template <typename Lattice>
+__attribute__((target("avx512f")))
+static std::size_t CollideCDAvx512(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *source
+  , double tau
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  const auto tau_v = _mm512_set1_pd(tau);
+  const auto cs_sqr_v = _mm512_set1_pd(cs_sqr);
+  const auto dt_v = _mm512_set1_pd(dt);
+  const auto one_v = _mm512_set1_pd(1.0);
+  const auto factor_v = _mm512_set1_pd(1.0 - 0.5 / tau);
+  auto n = std::size_t {0};
+  for (; n + 8 <= num_nodes; n += 8) {
+    const auto keep = KeepMaskAvx512(skip + n);
+    if (!keep) continue;
+    __m512d u_v[Lattice::nd];
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      u_v[d] = _mm512_loadu_pd(u[d] + n);
+    }  // d
+    const auto source_v = _mm512_loadu_pd(source + n);
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      auto c_dot_u = _mm512_setzero_pd();
+      for (auto d = 0u; d < Lattice::nd; ++d) {
+        if (Lattice::e[i][d] == 0) continue;
+        c_dot_u = _mm512_add_pd(c_dot_u, _mm512_mul_pd(_mm512_set1_pd(
+            Lattice::e[i][d] * c), u_v[d]));
+      }  // d
+      c_dot_u = _mm512_div_pd(c_dot_u, cs_sqr_v);
+      const auto src_i = _mm512_mul_pd(_mm512_mul_pd(_mm512_set1_pd(
+          Lattice::omega[i]), source_v), _mm512_add_pd(one_v, _mm512_mul_pd(
+          factor_v, c_dot_u)));
+      const auto f = _mm512_loadu_pd(df[i] + n);
+      const auto feq = _mm512_loadu_pd(edf[i] + n);
+      _mm512_mask_storeu_pd(df[i] + n, keep, _mm512_add_pd(f, _mm512_add_pd(
+          _mm512_div_pd(_mm512_sub_pd(feq, f), tau_v), _mm512_mul_pd(dt_v,
+          src_i))));
+    }  // i
+  }  // n
+  return n;
+}
+
+template <typename Lattice>
+__attribute__((target("avx2")))
+static void GuoSourceAvx2(const __m256d *u_v
+  , const __m256d *source_v
+  , __m256d scale
+  , double c
+  , double cs_sqr
+  , __m256d *src)
+{
+  const auto cs_sqr_v = _mm256_set1_pd(cs_sqr);
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    auto c_dot_u = _mm256_setzero_pd();
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      if (Lattice::e[i][d] == 0) continue;
+      c_dot_u = _mm256_add_pd(c_dot_u, _mm256_mul_pd(_mm256_set1_pd(
+          Lattice::e[i][d] * c), u_v[d]));
+    }  // d
+    c_dot_u = _mm256_div_pd(c_dot_u, cs_sqr_v);
+    auto src_dot_product = _mm256_setzero_pd();
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      const auto e_id = _mm256_set1_pd(Lattice::e[i][d] * c);
+      src_dot_product = _mm256_add_pd(src_dot_product, _mm256_mul_pd(
+          _mm256_add_pd(_mm256_sub_pd(e_id, u_v[d]), _mm256_mul_pd(c_dot_u,
+          e_id)), source_v[d]));
+    }  // d
+    src_dot_product = _mm256_div_pd(src_dot_product, scale);
+    src[i] = _mm256_mul_pd(_mm256_set1_pd(Lattice::omega[i]),
+        src_dot_product);
+  }  // i
+}
+
+template <typename Lattice>
+__attribute__((target("avx2")))
+static std::size_t CollideTRTAvx2(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , double tau_plus
+  , double tau_minus
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  const auto tau_plus_v = _mm256_set1_pd(tau_plus);
+  const auto tau_minus_v = _mm256_set1_pd(tau_minus);
+  const auto factor_plus_v = _mm256_set1_pd(1.0 - 0.5 / tau_plus);
+  const auto factor_minus_v = _mm256_set1_pd(1.0 - 0.5 / tau_minus);
+  const auto cs_sqr_v = _mm256_set1_pd(cs_sqr);
+  const auto dt_v = _mm256_set1_pd(dt);
+  const auto half_v = _mm256_set1_pd(0.5);
+  auto n = std::size_t {0};
+  for (; n + 4 <= num_nodes; n += 4) {
+    const auto keep = KeepMaskAvx2(skip + n);
+    if (_mm256_testz_si256(keep, keep)) continue;
+    __m256d u_v[Lattice::nd];
+    __m256d source_v[Lattice::nd];
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      u_v[d] = _mm256_loadu_pd(u[d] + n);
+      source_v[d] = _mm256_loadu_pd(source[d] + n);
+    }  // d
+    const auto scale = _mm256_div_pd(cs_sqr_v, _mm256_loadu_pd(rho + n));
+    __m256d src[Lattice::nq];
+    __m256d neq[Lattice::nq];
+    GuoSourceAvx2<Lattice>(u_v, source_v, scale, c, cs_sqr, src);
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      neq[i] = _mm256_sub_pd(_mm256_loadu_pd(df[i] + n),
+          _mm256_loadu_pd(edf[i] + n));
+    }  // i
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      const auto j = Lattice::opposite[i];
+      const auto neq_plus = _mm256_mul_pd(half_v, _mm256_add_pd(neq[i],
+          neq[j]));
+      const auto neq_minus = _mm256_mul_pd(half_v, _mm256_sub_pd(neq[i],
+          neq[j]));
+      const auto src_plus = _mm256_mul_pd(half_v, _mm256_add_pd(src[i],
+          src[j]));
+      const auto src_minus = _mm256_mul_pd(half_v, _mm256_sub_pd(src[i],
+          src[j]));
+      const auto f = _mm256_loadu_pd(df[i] + n);
+      _mm256_maskstore_pd(df[i] + n, keep, _mm256_add_pd(f, _mm256_sub_pd(
+          _mm256_mul_pd(dt_v, _mm256_add_pd(_mm256_mul_pd(factor_plus_v,
+          src_plus), _mm256_mul_pd(factor_minus_v, src_minus))),
+          _mm256_add_pd(_mm256_div_pd(neq_plus, tau_plus_v), _mm256_div_pd(
+          neq_minus, tau_minus_v)))));
+    }  // i
+  }  // n
+  return n;
+}
+
+template <typename Lattice>
+__attribute__((target("avx2")))
+static std::size_t CollideMRTAvx2(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , const double *relax
+  , const double *force
+  , double c
+  , double cs_sqr)
+{
+  const auto cs_sqr_v = _mm256_set1_pd(cs_sqr);
+  auto n = std::size_t {0};
+  for (; n + 4 <= num_nodes; n += 4) {
+    const auto keep = KeepMaskAvx2(skip + n);
+    if (_mm256_testz_si256(keep, keep)) continue;
+    __m256d u_v[Lattice::nd];
+    __m256d source_v[Lattice::nd];
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      u_v[d] = _mm256_loadu_pd(u[d] + n);
+      source_v[d] = _mm256_loadu_pd(source[d] + n);
+    }  // d
+    const auto scale = _mm256_div_pd(cs_sqr_v, _mm256_loadu_pd(rho + n));
+    __m256d src[Lattice::nq];
+    __m256d neq[Lattice::nq];
+    GuoSourceAvx2<Lattice>(u_v, source_v, scale, c, cs_sqr, src);
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      neq[i] = _mm256_sub_pd(_mm256_loadu_pd(df[i] + n),
+          _mm256_loadu_pd(edf[i] + n));
+    }  // i
+    __m256d m[Lattice::nq];
+    for (auto k = 0u; k < Lattice::nq; ++k) {
+      auto m_neq = _mm256_setzero_pd();
+      auto m_src = _mm256_setzero_pd();
+      for (auto i = 0u; i < Lattice::nq; ++i) {
+        if (Lattice::moment[k][i] == 0) continue;
+        const auto moment = _mm256_set1_pd(Lattice::moment[k][i]);
+        m_neq = _mm256_add_pd(m_neq, _mm256_mul_pd(moment, neq[i]));
+        m_src = _mm256_add_pd(m_src, _mm256_mul_pd(moment, src[i]));
+      }  // i
+      m[k] = _mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(relax[k]), m_neq),
+          _mm256_mul_pd(_mm256_set1_pd(force[k]), m_src));
+    }  // k
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      auto delta = _mm256_setzero_pd();
+      for (auto k = 0u; k < Lattice::nq; ++k) {
+        if (Lattice::moment[k][i] == 0) continue;
+        delta = _mm256_add_pd(delta, _mm256_mul_pd(_mm256_set1_pd(
+            Lattice::moment[k][i]), m[k]));
+      }  // k
+      const auto f = _mm256_loadu_pd(df[i] + n);
+      _mm256_maskstore_pd(df[i] + n, keep, _mm256_sub_pd(f, delta));
+    }  // i
+  }  // n
+  return n;
+}
+
+template <typename Lattice>
+__attribute__((target("avx2")))
+static std::size_t CollideLESAvx2(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , double tau
+  , double smagorinsky_factor
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  const auto tau_bgk_v = _mm256_set1_pd(tau);
+  const auto tau_sqr_v = _mm256_set1_pd(tau * tau);
+  const auto smagorinsky_v = _mm256_set1_pd(smagorinsky_factor);
+  const auto cs_sqr_v = _mm256_set1_pd(cs_sqr);
+  const auto dt_v = _mm256_set1_pd(dt);
+  const auto half_v = _mm256_set1_pd(0.5);
+  const auto one_v = _mm256_set1_pd(1.0);
+  auto n = std::size_t {0};
+  for (; n + 4 <= num_nodes; n += 4) {
+    const auto keep = KeepMaskAvx2(skip + n);
+    if (_mm256_testz_si256(keep, keep)) continue;
+    __m256d u_v[Lattice::nd];
+    __m256d source_v[Lattice::nd];
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      u_v[d] = _mm256_loadu_pd(u[d] + n);
+      source_v[d] = _mm256_loadu_pd(source[d] + n);
+    }  // d
+    const auto rho_v = _mm256_loadu_pd(rho + n);
+    const auto scale = _mm256_div_pd(cs_sqr_v, rho_v);
+    __m256d f[Lattice::nq];
+    __m256d feq[Lattice::nq];
+    __m256d neq[Lattice::nq];
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      f[i] = _mm256_loadu_pd(df[i] + n);
+      feq[i] = _mm256_loadu_pd(edf[i] + n);
+      neq[i] = _mm256_sub_pd(f[i], feq[i]);
+    }  // i
+    // norm of the non-equilibrium stress, see SecondMomentNorm()
+    auto norm = _mm256_setzero_pd();
+    for (auto a = 0u; a < Lattice::nd; ++a) {
+      for (auto b = a; b < Lattice::nd; ++b) {
+        auto moment = _mm256_setzero_pd();
+        for (auto i = 0u; i < Lattice::nq; ++i) {
+          const auto e_iab = Lattice::e[i][a] * Lattice::e[i][b];
+          if (e_iab == 0) continue;
+          moment = _mm256_add_pd(moment, _mm256_mul_pd(_mm256_set1_pd(e_iab),
+              neq[i]));
+        }  // i
+        const auto weight = _mm256_set1_pd(a == b ? 1.0 : 2.0);
+        norm = _mm256_add_pd(norm, _mm256_mul_pd(_mm256_mul_pd(weight, moment),
+            moment));
+      }  // b
+    }  // a
+    norm = _mm256_sqrt_pd(norm);
+    const auto tau_v = _mm256_mul_pd(half_v, _mm256_add_pd(tau_bgk_v,
+        _mm256_sqrt_pd(_mm256_add_pd(tau_sqr_v, _mm256_div_pd(_mm256_mul_pd(
+        smagorinsky_v, norm), rho_v)))));
+    const auto factor_v = _mm256_sub_pd(one_v, _mm256_div_pd(half_v, tau_v));
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      auto c_dot_u = _mm256_setzero_pd();
+      for (auto d = 0u; d < Lattice::nd; ++d) {
+        if (Lattice::e[i][d] == 0) continue;
+        c_dot_u = _mm256_add_pd(c_dot_u, _mm256_mul_pd(_mm256_set1_pd(
+            Lattice::e[i][d] * c), u_v[d]));
+      }  // d
+      c_dot_u = _mm256_div_pd(c_dot_u, cs_sqr_v);
+      auto src_dot_product = _mm256_setzero_pd();
+      for (auto d = 0u; d < Lattice::nd; ++d) {
+        const auto e_id = _mm256_set1_pd(Lattice::e[i][d] * c);
+        src_dot_product = _mm256_add_pd(src_dot_product, _mm256_mul_pd(
+            _mm256_add_pd(_mm256_sub_pd(e_id, u_v[d]), _mm256_mul_pd(c_dot_u,
+            e_id)), source_v[d]));
+      }  // d
+      src_dot_product = _mm256_div_pd(src_dot_product, scale);
+      const auto src_i = _mm256_mul_pd(_mm256_mul_pd(factor_v,
+          _mm256_set1_pd(Lattice::omega[i])), src_dot_product);
+      _mm256_maskstore_pd(df[i] + n, keep, _mm256_add_pd(f[i], _mm256_add_pd(
+          _mm256_div_pd(_mm256_sub_pd(feq[i], f[i]), tau_v), _mm256_mul_pd(dt_v,
+          src_i))));
+    }  // i
+  }  // n
+  return n;
+}
+
+template <typename Lattice>
+__attribute__((target("avx512f")))
+static void GuoSourceAvx512(const __m512d *u_v
+  , const __m512d *source_v
+  , __m512d scale
+  , double c
+  , double cs_sqr
+  , __m512d *src)
+{
+  const auto cs_sqr_v = _mm512_set1_pd(cs_sqr);
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    auto c_dot_u = _mm512_setzero_pd();
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      if (Lattice::e[i][d] == 0) continue;
+      c_dot_u = _mm512_add_pd(c_dot_u, _mm512_mul_pd(_mm512_set1_pd(
+          Lattice::e[i][d] * c), u_v[d]));
+    }  // d
+    c_dot_u = _mm512_div_pd(c_dot_u, cs_sqr_v);
+    auto src_dot_product = _mm512_setzero_pd();
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      const auto e_id = _mm512_set1_pd(Lattice::e[i][d] * c);
+      src_dot_product = _mm512_add_pd(src_dot_product, _mm512_mul_pd(
+          _mm512_add_pd(_mm512_sub_pd(e_id, u_v[d]), _mm512_mul_pd(c_dot_u,
+          e_id)), source_v[d]));
+    }  // d
+    src_dot_product = _mm512_div_pd(src_dot_product, scale);
+    src[i] = _mm512_mul_pd(_mm512_set1_pd(Lattice::omega[i]),
+        src_dot_product);
+  }  // i
+}
+
+template <typename Lattice>
+__attribute__((target("avx512f")))
+static std::size_t CollideTRTAvx512(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , double tau_plus
+  , double tau_minus
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  const auto tau_plus_v = _mm512_set1_pd(tau_plus);
+  const auto tau_minus_v = _mm512_set1_pd(tau_minus);
+  const auto factor_plus_v = _mm512_set1_pd(1.0 - 0.5 / tau_plus);
+  const auto factor_minus_v = _mm512_set1_pd(1.0 - 0.5 / tau_minus);
+  const auto cs_sqr_v = _mm512_set1_pd(cs_sqr);
+  const auto dt_v = _mm512_set1_pd(dt);
+  const auto half_v = _mm512_set1_pd(0.5);
+  auto n = std::size_t {0};
+  for (; n + 8 <= num_nodes; n += 8) {
+    const auto keep = KeepMaskAvx512(skip + n);
+    if (!keep) continue;
+    __m512d u_v[Lattice::nd];
+    __m512d source_v[Lattice::nd];
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      u_v[d] = _mm512_loadu_pd(u[d] + n);
+      source_v[d] = _mm512_loadu_pd(source[d] + n);
+    }  // d
+    const auto scale = _mm512_div_pd(cs_sqr_v, _mm512_loadu_pd(rho + n));
+    __m512d src[Lattice::nq];
+    __m512d neq[Lattice::nq];
+    GuoSourceAvx512<Lattice>(u_v, source_v, scale, c, cs_sqr, src);
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      neq[i] = _mm512_sub_pd(_mm512_loadu_pd(df[i] + n),
+          _mm512_loadu_pd(edf[i] + n));
+    }  // i
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      const auto j = Lattice::opposite[i];
+      const auto neq_plus = _mm512_mul_pd(half_v, _mm512_add_pd(neq[i],
+          neq[j]));
+      const auto neq_minus = _mm512_mul_pd(half_v, _mm512_sub_pd(neq[i],
+          neq[j]));
+      const auto src_plus = _mm512_mul_pd(half_v, _mm512_add_pd(src[i],
+          src[j]));
+      const auto src_minus = _mm512_mul_pd(half_v, _mm512_sub_pd(src[i],
+          src[j]));
+      const auto f = _mm512_loadu_pd(df[i] + n);
+      _mm512_mask_storeu_pd(df[i] + n, keep, _mm512_add_pd(f, _mm512_sub_pd(
+          _mm512_mul_pd(dt_v, _mm512_add_pd(_mm512_mul_pd(factor_plus_v,
+          src_plus), _mm512_mul_pd(factor_minus_v, src_minus))),
+          _mm512_add_pd(_mm512_div_pd(neq_plus, tau_plus_v), _mm512_div_pd(
+          neq_minus, tau_minus_v)))));
+    }  // i
+  }  // n
+  return n;
+}
+
+template <typename Lattice>
+__attribute__((target("avx512f")))
+static std::size_t CollideMRTAvx512(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , const double *relax
+  , const double *force
+  , double c
+  , double cs_sqr)
+{
+  const auto cs_sqr_v = _mm512_set1_pd(cs_sqr);
+  auto n = std::size_t {0};
+  for (; n + 8 <= num_nodes; n += 8) {
+    const auto keep = KeepMaskAvx512(skip + n);
+    if (!keep) continue;
+    __m512d u_v[Lattice::nd];
+    __m512d source_v[Lattice::nd];
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      u_v[d] = _mm512_loadu_pd(u[d] + n);
+      source_v[d] = _mm512_loadu_pd(source[d] + n);
+    }  // d
+    const auto scale = _mm512_div_pd(cs_sqr_v, _mm512_loadu_pd(rho + n));
+    __m512d src[Lattice::nq];
+    __m512d neq[Lattice::nq];
+    GuoSourceAvx512<Lattice>(u_v, source_v, scale, c, cs_sqr, src);
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      neq[i] = _mm512_sub_pd(_mm512_loadu_pd(df[i] + n),
+          _mm512_loadu_pd(edf[i] + n));
+    }  // i
+    __m512d m[Lattice::nq];
+    for (auto k = 0u; k < Lattice::nq; ++k) {
+      auto m_neq = _mm512_setzero_pd();
+      auto m_src = _mm512_setzero_pd();
+      for (auto i = 0u; i < Lattice::nq; ++i) {
+        if (Lattice::moment[k][i] == 0) continue;
+        const auto moment = _mm512_set1_pd(Lattice::moment[k][i]);
+        m_neq = _mm512_add_pd(m_neq, _mm512_mul_pd(moment, neq[i]));
+        m_src = _mm512_add_pd(m_src, _mm512_mul_pd(moment, src[i]));
+      }  // i
+      m[k] = _mm512_sub_pd(_mm512_mul_pd(_mm512_set1_pd(relax[k]), m_neq),
+          _mm512_mul_pd(_mm512_set1_pd(force[k]), m_src));
+    }  // k
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      auto delta = _mm512_setzero_pd();
+      for (auto k = 0u; k < Lattice::nq; ++k) {
+        if (Lattice::moment[k][i] == 0) continue;
+        delta = _mm512_add_pd(delta, _mm512_mul_pd(_mm512_set1_pd(
+            Lattice::moment[k][i]), m[k]));
+      }  // k
+      const auto f = _mm512_loadu_pd(df[i] + n);
+      _mm512_mask_storeu_pd(df[i] + n, keep, _mm512_sub_pd(f, delta));
+    }  // i
+  }  // n
+  return n;
+}
+
+// _mm512_sqrt_pd() starts from _mm512_undefined_pd(), which GCC 12 flags
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+template <typename Lattice>
+__attribute__((target("avx512f")))
+static std::size_t CollideLESAvx512(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , double tau
+  , double smagorinsky_factor
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  const auto tau_bgk_v = _mm512_set1_pd(tau);
+  const auto tau_sqr_v = _mm512_set1_pd(tau * tau);
+  const auto smagorinsky_v = _mm512_set1_pd(smagorinsky_factor);
+  const auto cs_sqr_v = _mm512_set1_pd(cs_sqr);
+  const auto dt_v = _mm512_set1_pd(dt);
+  const auto half_v = _mm512_set1_pd(0.5);
+  const auto one_v = _mm512_set1_pd(1.0);
+  auto n = std::size_t {0};
+  for (; n + 8 <= num_nodes; n += 8) {
+    const auto keep = KeepMaskAvx512(skip + n);
+    if (!keep) continue;
+    __m512d u_v[Lattice::nd];
+    __m512d source_v[Lattice::nd];
+    for (auto d = 0u; d < Lattice::nd; ++d) {
+      u_v[d] = _mm512_loadu_pd(u[d] + n);
+      source_v[d] = _mm512_loadu_pd(source[d] + n);
+    }  // d
+    const auto rho_v = _mm512_loadu_pd(rho + n);
+    const auto scale = _mm512_div_pd(cs_sqr_v, rho_v);
+    __m512d f[Lattice::nq];
+    __m512d feq[Lattice::nq];
+    __m512d neq[Lattice::nq];
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      f[i] = _mm512_loadu_pd(df[i] + n);
+      feq[i] = _mm512_loadu_pd(edf[i] + n);
+      neq[i] = _mm512_sub_pd(f[i], feq[i]);
+    }  // i
+    // norm of the non-equilibrium stress, see SecondMomentNorm()
+    auto norm = _mm512_setzero_pd();
+    for (auto a = 0u; a < Lattice::nd; ++a) {
+      for (auto b = a; b < Lattice::nd; ++b) {
+        auto moment = _mm512_setzero_pd();
+        for (auto i = 0u; i < Lattice::nq; ++i) {
+          const auto e_iab = Lattice::e[i][a] * Lattice::e[i][b];
+          if (e_iab == 0) continue;
+          moment = _mm512_add_pd(moment, _mm512_mul_pd(_mm512_set1_pd(e_iab),
+              neq[i]));
+        }  // i
+        const auto weight = _mm512_set1_pd(a == b ? 1.0 : 2.0);
+        norm = _mm512_add_pd(norm, _mm512_mul_pd(_mm512_mul_pd(weight, moment),
+            moment));
+      }  // b
+    }  // a
+    norm = _mm512_sqrt_pd(norm);
+    const auto tau_v = _mm512_mul_pd(half_v, _mm512_add_pd(tau_bgk_v,
+        _mm512_sqrt_pd(_mm512_add_pd(tau_sqr_v, _mm512_div_pd(_mm512_mul_pd(
+        smagorinsky_v, norm), rho_v)))));
+    const auto factor_v = _mm512_sub_pd(one_v, _mm512_div_pd(half_v, tau_v));
+    for (auto i = 0u; i < Lattice::nq; ++i) {
+      auto c_dot_u = _mm512_setzero_pd();
+      for (auto d = 0u; d < Lattice::nd; ++d) {
+        if (Lattice::e[i][d] == 0) continue;
+        c_dot_u = _mm512_add_pd(c_dot_u, _mm512_mul_pd(_mm512_set1_pd(
+            Lattice::e[i][d] * c), u_v[d]));
+      }  // d
+      c_dot_u = _mm512_div_pd(c_dot_u, cs_sqr_v);
+      auto src_dot_product = _mm512_setzero_pd();
+      for (auto d = 0u; d < Lattice::nd; ++d) {
+        const auto e_id = _mm512_set1_pd(Lattice::e[i][d] * c);
+        src_dot_product = _mm512_add_pd(src_dot_product, _mm512_mul_pd(
+            _mm512_add_pd(_mm512_sub_pd(e_id, u_v[d]), _mm512_mul_pd(c_dot_u,
+            e_id)), source_v[d]));
+      }  // d
+      src_dot_product = _mm512_div_pd(src_dot_product, scale);
+      const auto src_i = _mm512_mul_pd(_mm512_mul_pd(factor_v,
+          _mm512_set1_pd(Lattice::omega[i])), src_dot_product);
+      _mm512_mask_storeu_pd(df[i] + n, keep, _mm512_add_pd(f[i], _mm512_add_pd(
+          _mm512_div_pd(_mm512_sub_pd(feq[i], f[i]), tau_v), _mm512_mul_pd(dt_v,
+          src_i))));
+    }  // i
+  }  // n
+  return n;
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif  // LBM_X86_SIMD
+
+template <typename Lattice>
+void SimdCollideNS(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , double tau)
+{
+  auto n = std::size_t {0};
+#ifdef LBM_X86_SIMD
+  if (g_simd_level == SimdLevel::Avx512) {
+    n = CollideNSAvx512<Lattice>(num_nodes, df, edf, skip, tau);
+  }
+  else if (g_simd_level == SimdLevel::Avx2) {
+    n = CollideNSAvx2<Lattice>(num_nodes, df, edf, skip, tau);
+  }
+#endif
+  for (; n < num_nodes; ++n) {
+    if (!skip[n]) CollideNSNode<Lattice>(n, df, edf, tau);
+  }  // n
+}
+
+template <typename Lattice>
+void SimdCollideNSF(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , double tau
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  auto n = std::size_t {0};
+#ifdef LBM_X86_SIMD
+  if (g_simd_level == SimdLevel::Avx512) {
+    n = CollideNSFAvx512<Lattice>(num_nodes, df, edf, skip, u, source, rho,
+        tau, c, cs_sqr, dt);
+  }
+  else if (g_simd_level == SimdLevel::Avx2) {
+    n = CollideNSFAvx2<Lattice>(num_nodes, df, edf, skip, u, source, rho, tau,
+        c, cs_sqr, dt);
+  }
+#endif
+  for (; n < num_nodes; ++n) {
+    if (skip[n]) continue;
+    CollideNSFNode<Lattice>(n, df, edf, u, source, rho, tau, c, cs_sqr, dt);
+  }  // n
+}
+
+template <typename Lattice>
+void SimdCollideCD(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *source
+  , double tau
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  auto n = std::size_t {0};
+#ifdef LBM_X86_SIMD
+  if (g_simd_level == SimdLevel::Avx512) {
+    n = CollideCDAvx512<Lattice>(num_nodes, df, edf, skip, u, source, tau, c,
+        cs_sqr, dt);
+  }
+  else if (g_simd_level == SimdLevel::Avx2) {
+    n = CollideCDAvx2<Lattice>(num_nodes, df, edf, skip, u, source, tau, c,
+        cs_sqr, dt);
+  }
+#endif
+  for (; n < num_nodes; ++n) {
+    if (skip[n]) continue;
+    CollideCDNode<Lattice>(n, df, edf, u, source, tau, c, cs_sqr, dt);
+  }  // n
+}
+
+template <typename Lattice>
+void SimdCollideTRT(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , double tau_plus
+  , double tau_minus
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  auto n = std::size_t {0};
+#ifdef LBM_X86_SIMD
+  if (g_simd_level == SimdLevel::Avx512) {
+    n = CollideTRTAvx512<Lattice>(num_nodes, df, edf, skip, u, source, rho,
+        tau_plus, tau_minus, c, cs_sqr, dt);
+  }
+  else if (g_simd_level == SimdLevel::Avx2) {
+    n = CollideTRTAvx2<Lattice>(num_nodes, df, edf, skip, u, source, rho,
+        tau_plus, tau_minus, c, cs_sqr, dt);
+  }
+#endif
+  for (; n < num_nodes; ++n) {
+    if (skip[n]) continue;
+    CollideTRTNode<Lattice>(n, df, edf, u, source, rho, tau_plus, tau_minus,
+        c, cs_sqr, dt);
+  }  // n
+}
+
+template <typename Lattice>
+void SimdCollideMRT(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , const double *rates
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  // relaxation and forcing factors of each moment with the normalization of
+  // the inverse moment basis folded in
+  double relax[Lattice::nq];
+  double force[Lattice::nq];
+  for (auto k = 0u; k < Lattice::nq; ++k) {
+    relax[k] = rates[k] / Lattice::moment_norm[k];
+    force[k] = dt * (1.0 - 0.5 * rates[k]) / Lattice::moment_norm[k];
+  }  // k
+  auto n = std::size_t {0};
+#ifdef LBM_X86_SIMD
+  if (g_simd_level == SimdLevel::Avx512) {
+    n = CollideMRTAvx512<Lattice>(num_nodes, df, edf, skip, u, source, rho,
+        relax, force, c, cs_sqr);
+  }
+  else if (g_simd_level == SimdLevel::Avx2) {
+    n = CollideMRTAvx2<Lattice>(num_nodes, df, edf, skip, u, source, rho,
+        relax, force, c, cs_sqr);
+  }
+#endif
+  for (; n < num_nodes; ++n) {
+    if (skip[n]) continue;
+    CollideMRTNode<Lattice>(n, df, edf, u, source, rho, relax, force, c,
+        cs_sqr);
+  }  // n
+}
+
+template <typename Lattice>
+void SimdCollideLES(std::size_t num_nodes
+  , double *const *df
+  , const double *const *edf
+  , const char *skip
+  , const double *const *u
+  , const double *const *source
+  , const double *rho
+  , double tau
+  , double smagorinsky_factor
+  , double c
+  , double cs_sqr
+  , double dt)
+{
+  auto n = std::size_t {0};
+#ifdef LBM_X86_SIMD
+  if (g_simd_level == SimdLevel::Avx512) {
+    n = CollideLESAvx512<Lattice>(num_nodes, df, edf, skip, u, source, rho,
+        tau, smagorinsky_factor, c, cs_sqr, dt);
+  }
+  else if (g_simd_level == SimdLevel::Avx2) {
+    n = CollideLESAvx2<Lattice>(num_nodes, df, edf, skip, u, source, rho,
+        tau, smagorinsky_factor, c, cs_sqr, dt);
+  }
+#endif
+  for (; n < num_nodes; ++n) {
+    if (skip[n]) continue;
+    CollideLESNode<Lattice>(n, df, edf, u, source, rho, tau,
+        smagorinsky_factor, c, cs_sqr, dt);
+  }  // n
+}
+
+template void SimdCollideNS<D2Q9>(std::size_t
+  , double *const*
+  , const double *const*
+  , const char*
+  , double);
+
+template void SimdCollideNS<D2Q5>(std::size_t
+  , double *const*
+  , const double *const*
+  , const char*
+  , double);
+
+template void SimdCollideNSF<D2Q9>(std::size_t
+  , double *const*
+  , const double *const*
+  , const char*
+  , const double *const*
+  , const double *const*
+  , const double*
+  , double
+  , double
+  , double
+  , double);
+
+template void SimdCollideCD<D2Q9>(std::size_t
+  , double *const*
+  , const double *const*
+  , const char*
+  , const double *const*
+  , const double*
+  , double
+  , double
+  , double
+  , double);
+
+template void SimdCollideCD<D2Q5>(std::size_t
+  , double *const*
+  , const double *const*
+  , const char*
+  , const double *const*
+  , const double*
+  , double
+  , double
+  , double
+  , double);
+
+template void SimdCollideTRT<D2Q9>(std::size_t
+  , double *const*
+  , const double *const*
+  , const char*
+  , const double *const*
+  , const double *const*
+  , const double*
+  , double
+  , double
+  , double
+  , double
+  , double);
+
+template void SimdCollideMRT<D2Q9>(std::size_t
+  , double *const*
+  , const double *const*
+  , const char*
+  , const double *const*
+  , const double *const*
+  , const double*
+  , const double*
+  , double
+  , double
+  , double);
+
+template void SimdCollideLES<D2Q9>(std::size_t
+  , double *const*
+  , const double *const*
+  , const char*
+  , const double *const*
+  , const double *const*
+  , const double*
+  , double
+  , double
+  , double
+  , double
+  , double);
@@ -0,0 +1,49 @@
+#include "SparseLattice.hpp"
+#include <cstddef>  // std::size_t
+#include <stdexcept>  // std::runtime_error
+#include <vector>
+#include "LatticeModel.hpp"
+
+SparseLattice::SparseLattice(const LatticeModel &lm
+  , const std::vector<char> &skip)
+  : runs_ {},
+    row_runs_ {},
+    num_nodes_ {0}
+{
+  const auto nx = lm.GetNumberOfColumns();
+  const auto ny = lm.GetNumberOfRows();
+  if (skip.size() != nx * ny) throw std::runtime_error("Skip size");
+  row_runs_.reserve(ny + 1);
+  for (auto y = 0u; y < ny; ++y) {
+    row_runs_.push_back(runs_.size() / 2);
+    auto is_in_run = false;
+    for (auto x = 0u; x < nx; ++x) {
+      auto is_active = false;
+      for (auto dy = ny - 1; dy <= ny + 1 && !is_active; ++dy) {
+        for (auto dx = nx - 1; dx <= nx + 1 && !is_active; ++dx) {
+          is_active = !skip[(y + dy) % ny * nx + (x + dx) % nx];
+        }  // dx
+      }  // dy
+      if (is_active != is_in_run) runs_.push_back(x);
+      if (is_active) ++num_nodes_;
+      is_in_run = is_active;
+    }  // x
+    if (is_in_run) runs_.push_back(nx);
+  }  // y
+  row_runs_.push_back(runs_.size() / 2);
+}
+
+const std::size_t* SparseLattice::GetRuns(std::size_t row) const
+{
+  return runs_.data() + 2 * row_runs_[row];
+}
+
+std::size_t SparseLattice::GetNumberOfRuns(std::size_t row) const
+{
+  return row_runs_[row + 1] - row_runs_[row];
+}
+
+std::size_t SparseLattice::GetNumberOfNodes() const
+{
+  return num_nodes_;
+}
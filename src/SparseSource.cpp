@@ -0,0 +1,41 @@
+#include "SparseSource.hpp"
+#include <algorithm>  // std::sort, std::unique, std::lower_bound
+#include <cstddef>  // std::size_t
+#include <stdexcept>  // std::runtime_error
+#include <utility>  // std::move
+#include <vector>
+
+SparseSource::SparseSource(std::size_t num_nodes)
+  : nodes_ {},
+    is_source_node_(num_nodes, 0)
+{}
+
+void SparseSource::Assign(std::vector<std::size_t> nodes)
+{
+  for (auto n : nodes) {
+    if (n >= is_source_node_.size()) {
+      throw std::runtime_error("Source node out of range");
+    }
+  }  // n
+  Clear();
+  std::sort(begin(nodes), end(nodes));
+  nodes.erase(std::unique(begin(nodes), end(nodes)), end(nodes));
+  nodes_ = std::move(nodes);
+  for (auto n : nodes_) is_source_node_[n] = 1;
+}
+
+void SparseSource::Clear()
+{
+  for (auto n : nodes_) is_source_node_[n] = 0;
+  nodes_.clear();
+}
+
+const std::vector<std::size_t>& SparseSource::GetNodes() const
+{
+  return nodes_;
+}
+
+std::size_t SparseSource::LowerBound(std::size_t n) const
+{
+  return std::lower_bound(begin(nodes_), end(nodes_), n) - begin(nodes_);
+}
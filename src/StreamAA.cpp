@@ -0,0 +1,48 @@
+#include "StreamAA.hpp"
+#include <cstddef>  // std::ptrdiff_t
+#include <iostream>
+#include <vector>
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
+#include "LatticeModel.hpp"
+#include "StreamModel.hpp"
+
+StreamAA::StreamAA(LatticeModel &lm
+  , bool is_periodic)
+  : StreamModel(lm, is_periodic, is_periodic, true)
+{}
+
+StreamAA::StreamAA(LatticeModel &lm
+  , bool is_periodic_x
+  , bool is_periodic_y)
+  : StreamModel(lm, is_periodic_x, is_periodic_y, true)
+{}
+
+void StreamAA::Stream(const LatticeField &df
+  , LatticeField &df_next
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  const auto nx = static_cast<std::ptrdiff_t>(lm_.GetNumberOfColumns());
+  const auto ny = static_cast<std::ptrdiff_t>(lm_.GetNumberOfRows());
+  // Streaming
+  const auto first_node = static_cast<std::ptrdiff_t>(first_row) * nx;
+  const auto last_node = static_cast<std::ptrdiff_t>(last_row) * nx;
+  // the D2Q5 directions are the first D2Q9 directions so the D2Q9 tables
+  // serve both
+  const auto nc = df.GetNumberOfDirections();
+  for (auto n = first_node; n < last_node; ++n) {
+    for (auto i = 0u; i < nc; ++i) {
+      auto x = n % nx - D2Q9::e[i][0];
+      auto y = n / nx - D2Q9::e[i][1];
+      if ((!periodic_x && (x < 0 || x == nx)) ||
+          (!periodic_y && (y < 0 || y == ny))) {
+        df_next(n, i) = df(n, D2Q9::opposite[i]);
+        continue;
+      }
+      x = (x + nx) % nx;
+      y = (y + ny) % ny;
+      df_next(n, i) = df(y * nx + x, i);
+    }  // i
+  }  // n
+}
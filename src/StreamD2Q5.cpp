@@ -0,0 +1,23 @@
+#include "StreamD2Q5.hpp"
+#include <stdexcept>  // std::runtime_error
+#include <vector>
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
+#include "LatticeModel.hpp"
+#include "StreamModel.hpp"
+
+StreamD2Q5::StreamD2Q5(LatticeModel &lm)
+  : StreamModel(lm, false, false, false)
+{
+  if (lm.GetNumberOfDirections() != D2Q5::nq) {
+    throw std::runtime_error("Not D2Q5");
+  }
+}
+
+void StreamD2Q5::Stream(const LatticeField &df
+  , LatticeField &df_next
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  StreamRows(df, df_next, first_row, last_row);
+}
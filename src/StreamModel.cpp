@@ -1,6 +1,190 @@
 #include "StreamModel.hpp"
+#include <algorithm>  // std::copy
+#include <cstddef>  // std::ptrdiff_t
+#include <vector>
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
 #include "LatticeModel.hpp"
 
-StreamModel::StreamModel(LatticeModel &lm)
-  : lm_ (lm)
+StreamModel::StreamModel(LatticeModel &lm
+  , bool is_periodic_x
+  , bool is_periodic_y
+  , bool is_in_place)
+  : periodic_x {is_periodic_x},
+    periodic_y {is_periodic_y},
+    in_place {is_in_place},
+    lm_ (lm)
 {}
+
+LatticeField StreamModel::Stream(const LatticeField &df)
+{
+  const auto nc = df.GetNumberOfDirections();
+  LatticeField result(df.GetNumberOfNodes(), nc);
+  std::vector<double> shift(nc, 0.0);
+  for (auto i = 0u; i < nc; ++i) shift[i] = df.Shift(i);
+  result.SetSinglePrecision(df.IsSinglePrecision(), shift);
+  Stream(df, result);
+  return result;
+}
+
+void StreamModel::Stream(const LatticeField &df
+  , LatticeField &df_next)
+{
+  Stream(df, df_next, 0, lm_.GetNumberOfRows());
+}
+
+void StreamModel::StreamRows(const LatticeField &df
+  , LatticeField &df_next
+  , std::size_t first_row
+  , std::size_t last_row) const
+{
+  const auto is_d2q5 = df.GetNumberOfDirections() == D2Q5::nq;
+  if (df.IsSinglePrecision()) {
+    if (is_d2q5) {
+      StreamRowsKernel<D2Q5, float>(df, df_next, first_row, last_row);
+    }
+    else {
+      StreamRowsKernel<D2Q9, float>(df, df_next, first_row, last_row);
+    }
+  }
+  else if (is_d2q5) {
+    StreamRowsKernel<D2Q5, double>(df, df_next, first_row, last_row);
+  }
+  else {
+    StreamRowsKernel<D2Q9, double>(df, df_next, first_row, last_row);
+  }
+}
+
+template <typename Lattice, typename T>
+void StreamModel::StreamRowsKernel(const LatticeField &df
+  , LatticeField &df_next
+  , std::size_t first_row
+  , std::size_t last_row) const
+{
+  const auto nx = static_cast<std::ptrdiff_t>(lm_.GetNumberOfColumns());
+  const auto ny = static_cast<std::ptrdiff_t>(lm_.GetNumberOfRows());
+  const auto y_begin = static_cast<std::ptrdiff_t>(first_row);
+  const auto y_end = static_cast<std::ptrdiff_t>(last_row);
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    const auto f = df.Plane<T>(i);
+    const auto f_next = df_next.Plane<T>(i);
+    const auto e_x = Lattice::e[i][0];
+    const auto e_y = Lattice::e[i][1];
+    // columns which receive their value from a neighbour in the same plane
+    const std::ptrdiff_t x_begin = e_x > 0 ? e_x : 0;
+    const std::ptrdiff_t x_end = e_x < 0 ? nx + e_x : nx;
+    for (auto y = y_begin; y < y_end; ++y) {
+      const auto row = f + y * nx;
+      const auto row_next = f_next + y * nx;
+      auto y_src = y - e_y;
+      if (y_src < 0 || y_src == ny) {
+        if (!periodic_y) {
+          // ghost row holds the values of the row itself
+          for (std::ptrdiff_t x = 0; x < nx; ++x) row_next[x] = row[x];
+          continue;
+        }
+        y_src = (y_src + ny) % ny;
+      }
+      const auto row_src = f + y_src * nx;
+      for (auto x = x_begin; x < x_end; ++x) row_next[x] = row_src[x - e_x];
+      // ghost column at the edge the value comes from
+      if (e_x == 0) continue;
+      const auto x_edge = e_x > 0 ? 0 : nx - 1;
+      row_next[x_edge] = periodic_x ? row_src[x_edge - e_x + e_x * nx] :
+          row[x_edge];
+    }  // y
+  }  // i
+}
+
+void StreamModel::StreamInterleaved(const LatticeField &df
+  , LatticeField &df_next
+  , std::size_t num_fields) const
+{
+  if (df.GetNumberOfDirections() == D2Q5::nq) {
+    StreamInterleavedKernel<D2Q5>(df, df_next, num_fields);
+  }
+  else {
+    StreamInterleavedKernel<D2Q9>(df, df_next, num_fields);
+  }
+}
+
+template <typename Lattice>
+void StreamModel::StreamInterleavedKernel(const LatticeField &df
+  , LatticeField &df_next
+  , std::size_t num_fields) const
+{
+  const auto nk = static_cast<std::ptrdiff_t>(num_fields);
+  const auto nx = static_cast<std::ptrdiff_t>(lm_.GetNumberOfColumns());
+  const auto ny = static_cast<std::ptrdiff_t>(lm_.GetNumberOfRows());
+  // a row holds the fields of each of its nodes, so a node of every field
+  // streams by shifting the row by nk values per column
+  const auto row_size = nx * nk;
+  for (auto i = 0u; i < Lattice::nq; ++i) {
+    const auto f = df.Direction(i);
+    const auto f_next = df_next.Direction(i);
+    const auto e_x = Lattice::e[i][0];
+    const auto e_y = Lattice::e[i][1];
+    const std::ptrdiff_t x_begin = e_x > 0 ? e_x : 0;
+    const std::ptrdiff_t x_end = e_x < 0 ? nx + e_x : nx;
+    for (std::ptrdiff_t y = 0; y < ny; ++y) {
+      const auto row = f + y * row_size;
+      const auto row_next = f_next + y * row_size;
+      auto y_src = y - e_y;
+      if (y_src < 0 || y_src == ny) {
+        if (!periodic_y) {
+          // ghost row holds the values of the row itself
+          std::copy(row, row + row_size, row_next);
+          continue;
+        }
+        y_src = (y_src + ny) % ny;
+      }
+      const auto row_src = f + y_src * row_size;
+      std::copy(row_src + (x_begin - e_x) * nk, row_src + (x_end - e_x) * nk,
+          row_next + x_begin * nk);
+      // ghost column at the edge the value comes from
+      if (e_x == 0) continue;
+      const auto x_edge = e_x > 0 ? 0 : nx - 1;
+      const auto edge_src = periodic_x ? row_src + (x_edge - e_x + e_x * nx) *
+          nk : row + x_edge * nk;
+      std::copy(edge_src, edge_src + nk, row_next + x_edge * nk);
+    }  // y
+  }  // i
+}
+
+void StreamModel::FinishCollideAndStream(LatticeField &df) const
+{
+  if (in_place) df.SetLayout(this, !df.IsSwapped());
+}
+
+void StreamModel::Locate(std::size_t &n
+  , std::size_t &i
+  , bool is_swapped
+  , bool is_post_collision) const
+{
+  // the D2Q5 directions are the first D2Q9 directions so the D2Q9 tables
+  // serve both
+  const auto &opposite = D2Q9::opposite;
+  // post-collision values of an even step are stored at the same node,
+  // streamed values of an odd step are stored in the plain layout
+  if (is_swapped == is_post_collision) {
+    if (is_swapped) i = opposite[i];
+    return;
+  }
+  // streamed values of an even step are stored at the node they come from,
+  // post-collision values of an odd step at the node they go to
+  const auto nx = static_cast<std::ptrdiff_t>(lm_.GetNumberOfColumns());
+  const auto ny = static_cast<std::ptrdiff_t>(lm_.GetNumberOfRows());
+  const auto sign = is_swapped ? -1 : 1;
+  auto x = static_cast<std::ptrdiff_t>(n) % nx + sign * D2Q9::e[i][0];
+  auto y = static_cast<std::ptrdiff_t>(n) / nx + sign * D2Q9::e[i][1];
+  if ((!periodic_x && (x < 0 || x == nx)) ||
+      (!periodic_y && (y < 0 || y == ny))) {
+    // values leaving the lattice bounce back at the same node
+    if (is_post_collision) i = opposite[i];
+    return;
+  }
+  x = (x + nx) % nx;
+  y = (y + ny) % ny;
+  n = static_cast<std::size_t>(y * nx + x);
+  if (is_swapped) i = opposite[i];
+}
@@ -0,0 +1,99 @@
+#include "ThreadPool.hpp"
+#include <condition_variable>
+#include <cstddef>  // std::size_t
+#include <exception>  // std::exception_ptr, std::current_exception
+#include <functional>
+#include <mutex>
+#include <stdexcept>  // std::runtime_error
+#include <thread>
+
+ThreadPool::ThreadPool(std::size_t num_threads)
+  : num_threads_ {num_threads},
+    workers_ {},
+    mutex_ {},
+    start_ {},
+    done_ {},
+    task_ {nullptr},
+    num_rows_ {0},
+    generation_ {0},
+    num_busy_ {0},
+    is_stopping_ {false},
+    error_ {}
+{
+  if (num_threads == 0) throw std::runtime_error("Zero threads");
+  workers_.reserve(num_threads - 1);
+  for (auto id = 1u; id < num_threads; ++id) {
+    workers_.emplace_back(&ThreadPool::Work, this, id);
+  }  // id
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_stopping_ = true;
+  }
+  start_.notify_all();
+  for (auto &worker : workers_) worker.join();
+}
+
+void ThreadPool::ParallelFor(std::size_t num_rows
+  , const std::function<void(std::size_t, std::size_t)> &task)
+{
+  if (workers_.empty()) {
+    task(0, num_rows);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    num_rows_ = num_rows;
+    num_busy_ = workers_.size();
+    error_ = nullptr;
+    ++generation_;
+  }
+  start_.notify_all();
+  RunSlab(0);
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return num_busy_ == 0; });
+  task_ = nullptr;
+  if (error_) std::rethrow_exception(error_);
+}
+
+std::size_t ThreadPool::GetNumberOfThreads() const
+{
+  return num_threads_;
+}
+
+void ThreadPool::Work(std::size_t id)
+{
+  std::size_t generation = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [&] {
+        return is_stopping_ || generation_ != generation;
+      });
+      if (is_stopping_) return;
+      generation = generation_;
+    }
+    RunSlab(id);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--num_busy_ == 0) done_.notify_one();
+  }
+}
+
+void ThreadPool::RunSlab(std::size_t id)
+{
+  // rows are spread as evenly as possible
+  const auto first_row = id * num_rows_ / num_threads_;
+  const auto last_row = (id + 1) * num_rows_ / num_threads_;
+  if (first_row == last_row) return;
+  try {
+    (*task_)(first_row, last_row);
+  }
+  catch (...) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!error_) error_ = std::current_exception();
+  }
+}
@@ -1,4 +1,6 @@
 #include "ZouHeNodes.hpp"
+#include <algorithm>  // std::lower_bound, std::upper_bound
+#include <cstddef>  // std::size_t
 #include <iostream>
 #include <stdexcept>
 #include <vector>
@@ -7,12 +9,15 @@
 ZouHeNodes::ZouHeNodes(LatticeModel &lm
   , CollisionModel &cm)
   : BoundaryNodes(false, false, lm),
-    nodes {},
+    corners {},
     cm_ (cm),
     is_normal_flow_ {false},
     beta1_ {},
     beta2_ {},
-    beta3_ {}
+    beta3_ {},
+    side_nodes_(4),
+    side_u_x_(4),
+    side_u_y_(4)
 {
   const auto c = lm_.GetLatticeSpeed();
   const auto cs_sqr = c * c / 3.0;
@@ -44,78 +49,135 @@ void ZouHeNodes::AddNode(std::size_t x
   // adds a corner node
   if ((top || bottom) && (left || right)) {
     side = right * 1 + top * 2;
-    nodes.push_back(ValueNode(x, y, nx, u_x, u_y, true, side));
-  }
-  // adds a side node
-  else {
-    nodes.push_back(ValueNode(x, y, nx, u_x, u_y, false, side));
+    corners.push_back(ValueNode(x, y, nx, u_x, u_y, true, side));
+    return;
   }
+  if (side < 0) throw std::runtime_error("Not a side");
+  // adds a side node, the nodes of a side are kept in ascending order
+  const auto n = y * nx + x;
+  auto &nodes = side_nodes_[side];
+  const auto k = std::upper_bound(begin(nodes), end(nodes), n) -
+      begin(nodes);
+  nodes.insert(begin(nodes) + k, n);
+  side_u_x_[side].insert(begin(side_u_x_[side]) + k, u_x);
+  side_u_y_[side].insert(begin(side_u_y_[side]) + k, u_y);
 }
 
-void ZouHeNodes::UpdateNodes(std::vector<std::vector<double>> &df
-  , bool is_modify_stream)
+void ZouHeNodes::UpdateNodes(LatticeField &df
+  , bool is_modify_stream
+  , std::size_t first_row
+  , std::size_t last_row)
 {
   if (!is_modify_stream) {
-    for (auto node : nodes) {
-      if (node.b1) {
+    for (auto side = 0u; side < side_nodes_.size(); ++side) {
+      ZouHeNodes::UpdateSide(df, side, first_row, last_row);
+    }  // side
+    for (auto &node : corners) {
+      if (node.y >= first_row && node.y < last_row) {
         ZouHeNodes::UpdateCorner(df, node);
       }
-      else {
-        ZouHeNodes::UpdateSide(df, node);
-      }
-    }  // n
+    }  // node
   }
 }
 
-void ZouHeNodes::UpdateSide(std::vector<std::vector<double>> &df
-  , ValueNode &node)
+void ZouHeNodes::UpdateSide(LatticeField &df
+  , std::size_t side
+  , std::size_t first_row
+  , std::size_t last_row)
 {
-  const auto n = node.n;
   const auto nx = lm_.GetNumberOfColumns();
+  const auto &nodes = side_nodes_[side];
+  const std::size_t first = std::lower_bound(begin(nodes), end(nodes),
+      first_row * nx) - begin(nodes);
+  const std::size_t last = std::lower_bound(begin(nodes) + first, end(nodes),
+      last_row * nx) - begin(nodes);
+  auto u_x = side_u_x_[side].data();
+  auto u_y = side_u_y_[side].data();
+  if (is_normal_flow_) {
+    // extrapolates the velocity from the neighbouring node inside the lattice
+    const std::ptrdiff_t offset[] = {-1, -static_cast<std::ptrdiff_t>(nx), 1,
+        static_cast<std::ptrdiff_t>(nx)};
+    for (auto k = first; k < last; ++k) {
+      const auto &u_node = lm_.u[nodes[k] + offset[side]];
+      u_x[k] = u_node[0];
+      u_y[k] = u_node[1];
+    }  // k
+  }
+  if (!df.IsSinglePrecision() && df.IsPlainLayout()) {
+    Planes planes(df);
+    UpdateSideKernel(planes, side, first, last);
+  }
+  else {
+    UpdateSideKernel(df, side, first, last);
+  }
+}
+
+template <typename Field>
+void ZouHeNodes::UpdateSideKernel(Field &df
+  , std::size_t side
+  , std::size_t first
+  , std::size_t last)
+{
   const auto c = lm_.GetLatticeSpeed();
-  switch(node.i1) {
+  const auto &nodes = side_nodes_[side];
+  const auto u_x = side_u_x_[side].data();
+  const auto u_y = side_u_y_[side].data();
+  // the side is fixed for the whole loop so every node runs the same code
+  switch (side) {
     case 0: {  // right
-      auto vel = is_normal_flow_ ? lm_.u[n - 1] : node.v1;
-      const auto rho_node = (df[n][0] + df[n][N] + df[n][S] + 2.0 * (df[n][E] +
-          df[n][NE] + df[n][SE])) / (1.0 + vel[0] / c);
-      const auto df_diff = 0.5 * (df[n][S] - df[n][N]);
-      for (auto &u : vel) u *= rho_node;
-      df[n][W] = df[n][E] - 2.0 * beta1_ * vel[0];
-      df[n][NW] = df[n][SE] + df_diff - beta3_ * vel[0] + beta2_ * vel[1];
-      df[n][SW] = df[n][NE] - df_diff - beta3_ * vel[0] - beta2_ * vel[1];
+      for (auto k = first; k < last; ++k) {
+        const auto n = nodes[k];
+        double vel[] = {u_x[k], u_y[k]};
+        const auto rho_node = (df(n, 0) + df(n, N) + df(n, S) + 2.0 *
+            (df(n, E) + df(n, NE) + df(n, SE))) / (1.0 + vel[0] / c);
+        const auto df_diff = 0.5 * (df(n, S) - df(n, N));
+        for (auto &u : vel) u *= rho_node;
+        df(n, W) = df(n, E) - 2.0 * beta1_ * vel[0];
+        df(n, NW) = df(n, SE) + df_diff - beta3_ * vel[0] + beta2_ * vel[1];
+        df(n, SW) = df(n, NE) - df_diff - beta3_ * vel[0] - beta2_ * vel[1];
+      }  // k
       break;
     }
     case 1: {  // top
-      auto vel = is_normal_flow_ ? lm_.u[n - nx] : node.v1;
-      const auto rho_node = (df[n][0] + df[n][E] + df[n][W] + 2.0 * (df[n][N] +
-          df[n][NE] + df[n][NW])) / (1.0 + vel[1] / c);
-      const auto df_diff = 0.5 * (df[n][E] - df[n][W]);
-      for (auto &u : vel) u *= rho_node;
-      df[n][S] = df[n][N] - 2.0 * beta1_ * vel[1];
-      df[n][SW] = df[n][NE] + df_diff - beta2_ * vel[0] - beta3_ * vel[1];
-      df[n][SE] = df[n][NW] - df_diff + beta2_ * vel[0] - beta3_ * vel[1];
+      for (auto k = first; k < last; ++k) {
+        const auto n = nodes[k];
+        double vel[] = {u_x[k], u_y[k]};
+        const auto rho_node = (df(n, 0) + df(n, E) + df(n, W) + 2.0 *
+            (df(n, N) + df(n, NE) + df(n, NW))) / (1.0 + vel[1] / c);
+        const auto df_diff = 0.5 * (df(n, E) - df(n, W));
+        for (auto &u : vel) u *= rho_node;
+        df(n, S) = df(n, N) - 2.0 * beta1_ * vel[1];
+        df(n, SW) = df(n, NE) + df_diff - beta2_ * vel[0] - beta3_ * vel[1];
+        df(n, SE) = df(n, NW) - df_diff + beta2_ * vel[0] - beta3_ * vel[1];
+      }  // k
       break;
     }
     case 2: {  // left
-      auto vel = is_normal_flow_ ? lm_.u[n + 1] : node.v1;
-      const auto rho_node = (df[n][0] + df[n][N] + df[n][S] + 2.0 * (df[n][W] +
-          df[n][NW] + df[n][SW])) / (1.0 - vel[0] / c);
-      const auto df_diff = 0.5 * (df[n][S] - df[n][N]);
-      for (auto &u : vel) u *= rho_node;
-      df[n][E] = df[n][W] + 2.0 * beta1_ * vel[0];
-      df[n][NE] = df[n][SW] + df_diff + beta3_ * vel[0] + beta2_ * vel[1];
-      df[n][SE] = df[n][NW] - df_diff + beta3_ * vel[0] - beta2_ * vel[1];
+      for (auto k = first; k < last; ++k) {
+        const auto n = nodes[k];
+        double vel[] = {u_x[k], u_y[k]};
+        const auto rho_node = (df(n, 0) + df(n, N) + df(n, S) + 2.0 *
+            (df(n, W) + df(n, NW) + df(n, SW))) / (1.0 - vel[0] / c);
+        const auto df_diff = 0.5 * (df(n, S) - df(n, N));
+        for (auto &u : vel) u *= rho_node;
+        df(n, E) = df(n, W) + 2.0 * beta1_ * vel[0];
+        df(n, NE) = df(n, SW) + df_diff + beta3_ * vel[0] + beta2_ * vel[1];
+        df(n, SE) = df(n, NW) - df_diff + beta3_ * vel[0] - beta2_ * vel[1];
+      }  // k
       break;
     }
     case 3: {  // bottom
-      auto vel = is_normal_flow_ ? lm_.u[n + nx] : node.v1;
-      const auto rho_node = (df[n][0] + df[n][E] + df[n][W] + 2.0 * (df[n][S] +
-          df[n][SW] + df[n][SE])) / (1.0 - vel[1] / c);
-      const auto df_diff = 0.5 * (df[n][W] - df[n][E]);
-      for (auto &u : vel) u *= rho_node;
-      df[n][N] = df[n][S] + 2.0 * beta1_ * vel[1];
-      df[n][NE] = df[n][SW] + df_diff + beta2_ * vel[0] + beta3_ * vel[1];
-      df[n][NW] = df[n][SE] - df_diff - beta2_ * vel[0] + beta3_ * vel[1];
+      for (auto k = first; k < last; ++k) {
+        const auto n = nodes[k];
+        double vel[] = {u_x[k], u_y[k]};
+        const auto rho_node = (df(n, 0) + df(n, E) + df(n, W) + 2.0 *
+            (df(n, S) + df(n, SW) + df(n, SE))) / (1.0 - vel[1] / c);
+        const auto df_diff = 0.5 * (df(n, W) - df(n, E));
+        for (auto &u : vel) u *= rho_node;
+        df(n, N) = df(n, S) + 2.0 * beta1_ * vel[1];
+        df(n, NE) = df(n, SW) + df_diff + beta2_ * vel[0] + beta3_ * vel[1];
+        df(n, NW) = df(n, SE) - df_diff - beta2_ * vel[0] + beta3_ * vel[1];
+      }  // k
       break;
     }
     default: {
@@ -124,60 +186,60 @@ void ZouHeNodes::UpdateSide(std::vector<std::vector<double>> &df
   }
 }
 
-void ZouHeNodes::UpdateCorner(std::vector<std::vector<double>> &df
+void ZouHeNodes::UpdateCorner(LatticeField &df
   , ValueNode &node)
 {
   const auto n = node.n;
-  auto vel = node.v1;
+  double vel[] = {node.v1[0], node.v1[1]};
   const auto nx = lm_.GetNumberOfColumns();
   const auto nc = lm_.GetNumberOfDirections();
   switch (node.i1) {
     case 0: {  // bottom-left
       auto rho_node = 0.5 * (cm_.rho[n + nx] + cm_.rho[n + 1]);
       for (auto &u : vel) u *= rho_node;
-      df[n][E] = df[n][W] + 2.0 * beta1_ * vel[0];
-      df[n][N] = df[n][S] + 2.0 * beta1_ * vel[1];
-      df[n][NE] = df[n][SW] + 0.5 * beta1_ * vel[0] + 0.5 * beta1_ * vel[1];
-      df[n][NW] = -0.5 * beta3_ * vel[0] + 0.5 * beta3_ * vel[1];
-      df[n][SE] = 0.5 * beta3_ * vel[0] - 0.5 * beta3_ * vel[1];
-      for (auto i = 1u; i < nc; ++i) rho_node -= df[n][i];
-      df[n][0] = rho_node;
+      df(n, E) = df(n, W) + 2.0 * beta1_ * vel[0];
+      df(n, N) = df(n, S) + 2.0 * beta1_ * vel[1];
+      df(n, NE) = df(n, SW) + 0.5 * beta1_ * vel[0] + 0.5 * beta1_ * vel[1];
+      df(n, NW) = -0.5 * beta3_ * vel[0] + 0.5 * beta3_ * vel[1];
+      df(n, SE) = 0.5 * beta3_ * vel[0] - 0.5 * beta3_ * vel[1];
+      for (auto i = 1u; i < nc; ++i) rho_node -= df(n, i);
+      df(n, 0) = rho_node;
       break;
     }
     case 1: {  // bottom-right
       auto rho_node = 0.5 * (cm_.rho[n + nx] + cm_.rho[n - 1]);
       for (auto &u : vel) u *= rho_node;
-      df[n][W] = df[n][E] - 2.0 * beta1_ * vel[0];
-      df[n][N] = df[n][S] + 2.0 * beta1_ * vel[1];
-      df[n][NW] = df[n][SE] - 0.5 * beta1_ * vel[0] + 0.5 * beta1_ * vel[1];
-      df[n][NE] = 0.5 * beta3_ * vel[0] + 0.5 * beta3_ * vel[1];
-      df[n][SW] = -0.5 * beta3_ * vel[0] - 0.5 * beta3_ * vel[1];
-      for (auto i = 1u; i < nc; ++i) rho_node -= df[n][i];
-      df[n][0] = rho_node;
+      df(n, W) = df(n, E) - 2.0 * beta1_ * vel[0];
+      df(n, N) = df(n, S) + 2.0 * beta1_ * vel[1];
+      df(n, NW) = df(n, SE) - 0.5 * beta1_ * vel[0] + 0.5 * beta1_ * vel[1];
+      df(n, NE) = 0.5 * beta3_ * vel[0] + 0.5 * beta3_ * vel[1];
+      df(n, SW) = -0.5 * beta3_ * vel[0] - 0.5 * beta3_ * vel[1];
+      for (auto i = 1u; i < nc; ++i) rho_node -= df(n, i);
+      df(n, 0) = rho_node;
       break;
     }
     case 2: {  // top-left
       auto rho_node = 0.5 * (cm_.rho[n - nx] + cm_.rho[n + 1]);
       for (auto &u : vel) u *= rho_node;
-      df[n][E] = df[n][W] + 2.0 * beta1_ * vel[0];
-      df[n][S] = df[n][N] - 2.0 * beta1_ * vel[1];
-      df[n][SE] = df[n][NW] + 0.5 * beta1_ * vel[0] - 0.5 * beta1_ * vel[1];
-      df[n][NE] = 0.5 * beta3_ * vel[0] + 0.5 * beta3_ * vel[1];
-      df[n][SW] = -0.5 * beta3_ * vel[0] - 0.5 * beta3_ * vel[1];
-      for (auto i = 1u; i < nc; ++i) rho_node -= df[n][i];
-      df[n][0] = rho_node;
+      df(n, E) = df(n, W) + 2.0 * beta1_ * vel[0];
+      df(n, S) = df(n, N) - 2.0 * beta1_ * vel[1];
+      df(n, SE) = df(n, NW) + 0.5 * beta1_ * vel[0] - 0.5 * beta1_ * vel[1];
+      df(n, NE) = 0.5 * beta3_ * vel[0] + 0.5 * beta3_ * vel[1];
+      df(n, SW) = -0.5 * beta3_ * vel[0] - 0.5 * beta3_ * vel[1];
+      for (auto i = 1u; i < nc; ++i) rho_node -= df(n, i);
+      df(n, 0) = rho_node;
       break;
     }
     case 3: {  // top-right
       auto rho_node = 0.5 * (cm_.rho[n - nx] + cm_.rho[n - 1]);
       for (auto &u : vel) u *= rho_node;
-      df[n][W] = df[n][E] - 2.0 * beta1_ * vel[0];
-      df[n][S] = df[n][N] - 2.0 * beta1_ * vel[1];
-      df[n][SW] = df[n][NE] - 0.5 * beta1_ * vel[0] - 0.5 * beta1_ * vel[1];
-      df[n][NW] = -0.5 * beta3_ * vel[0] + 0.5 * beta3_ * vel[1];
-      df[n][SE] = 0.5 * beta3_ * vel[0] - 0.5 * beta3_ * vel[1];
-      for (auto i = 1u; i < nc; ++i) rho_node -= df[n][i];
-      df[n][0] = rho_node;
+      df(n, W) = df(n, E) - 2.0 * beta1_ * vel[0];
+      df(n, S) = df(n, N) - 2.0 * beta1_ * vel[1];
+      df(n, SW) = df(n, NE) - 0.5 * beta1_ * vel[0] - 0.5 * beta1_ * vel[1];
+      df(n, NW) = -0.5 * beta3_ * vel[0] + 0.5 * beta3_ * vel[1];
+      df(n, SE) = 0.5 * beta3_ * vel[0] - 0.5 * beta3_ * vel[1];
+      for (auto i = 1u; i < nc; ++i) rho_node -= df(n, i);
+      df(n, 0) = rho_node;
       break;
     }
     default: {
@@ -190,3 +252,18 @@ void ZouHeNodes::ToggleNormalFlow()
 {
   is_normal_flow_ = true;
 }
+
+std::vector<ValueNode> ZouHeNodes::GetNodes() const
+{
+  const auto nx = lm_.GetNumberOfColumns();
+  std::vector<ValueNode> nodes;
+  for (auto side = 0u; side < side_nodes_.size(); ++side) {
+    for (auto k = 0u; k < side_nodes_[side].size(); ++k) {
+      const auto n = side_nodes_[side][k];
+      nodes.push_back(ValueNode(n % nx, n / nx, nx, side_u_x_[side][k],
+          side_u_y_[side][k], false, side));
+    }  // k
+  }  // side
+  nodes.insert(end(nodes), begin(corners), end(corners));
+  return nodes;
+}
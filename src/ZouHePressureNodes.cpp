@@ -1,4 +1,6 @@
 #include "ZouHePressureNodes.hpp"
+#include <algorithm>  // std::lower_bound, std::upper_bound
+#include <cstddef>  // std::size_t
 #include <iostream>
 #include <stdexcept>
 #include <vector>
@@ -6,11 +8,13 @@
 ZouHePressureNodes::ZouHePressureNodes(LatticeModel &lm
   , CollisionModel &cm)
   : BoundaryNodes(false, false, lm),
-    nodes {},
+    corners {},
     cm_ (cm),
     beta1_ {},
     beta2_ {},
-    beta3_ {}
+    beta3_ {},
+    side_nodes_(4),
+    side_rho_(4)
 {
   const auto c = lm_.GetLatticeSpeed();
   const auto cs_sqr = c * c / 3.0;
@@ -37,91 +41,121 @@ void ZouHePressureNodes::AddNode(std::size_t x
   // adds a corner node
   if ((top || bottom) && (left || right)) {
     side = right * 1 + top * 2;
-    nodes.push_back(ValueNode(x, y, nx, rho_node, true, side));
-  }
-  // adds a side node
-  else {
-    nodes.push_back(ValueNode(x, y, nx, rho_node, false, side));
+    corners.push_back(ValueNode(x, y, nx, rho_node, true, side));
+    return;
   }
+  if (side < 0) throw std::runtime_error("Not a side");
+  // adds a side node, the nodes of a side are kept in ascending order
+  const auto n = y * nx + x;
+  auto &nodes = side_nodes_[side];
+  const auto k = std::upper_bound(begin(nodes), end(nodes), n) -
+      begin(nodes);
+  nodes.insert(begin(nodes) + k, n);
+  side_rho_[side].insert(begin(side_rho_[side]) + k, rho_node);
 }
 
-void ZouHePressureNodes::UpdateNodes(std::vector<std::vector<double>> &df
-  , bool is_modify_stream)
+void ZouHePressureNodes::UpdateNodes(LatticeField &df
+  , bool is_modify_stream
+  , std::size_t first_row
+  , std::size_t last_row)
 {
   if (!is_modify_stream) {
-    for (auto node : nodes) {
-      if (node.b1) {
+    for (auto side = 0u; side < side_nodes_.size(); ++side) {
+      ZouHePressureNodes::UpdateSide(df, side, first_row, last_row);
+    }  // side
+    for (auto &node : corners) {
+      if (node.y >= first_row && node.y < last_row) {
         ZouHePressureNodes::UpdateCorner(df, node);
       }
-      else {
-        ZouHePressureNodes::UpdateSide(df, node);
-      }
-    }  // n
+    }  // node
   }
 }
 
-void ZouHePressureNodes::UpdateSide(std::vector<std::vector<double>> &df
-  , ValueNode &node)
+void ZouHePressureNodes::UpdateSide(LatticeField &df
+  , std::size_t side
+  , std::size_t first_row
+  , std::size_t last_row)
+{
+  const auto nx = lm_.GetNumberOfColumns();
+  const auto &nodes = side_nodes_[side];
+  const std::size_t first = std::lower_bound(begin(nodes), end(nodes),
+      first_row * nx) - begin(nodes);
+  const std::size_t last = std::lower_bound(begin(nodes) + first, end(nodes),
+      last_row * nx) - begin(nodes);
+  if (!df.IsSinglePrecision() && df.IsPlainLayout()) {
+    Planes planes(df);
+    UpdateSideKernel(planes, side, first, last);
+  }
+  else {
+    UpdateSideKernel(df, side, first, last);
+  }
+}
+
+template <typename Field>
+void ZouHePressureNodes::UpdateSideKernel(Field &df
+  , std::size_t side
+  , std::size_t first
+  , std::size_t last)
 {
-  const auto n = node.n;
-  const auto rho_node = node.d1;
   const auto c = lm_.GetLatticeSpeed();
-  std::vector<double> vel = {0.0, 0.0};
-  switch (node.i1) {
+  const auto &nodes = side_nodes_[side];
+  const auto rho = side_rho_[side].data();
+  // the side is fixed for the whole loop so every node runs the same code
+  switch (side) {
     case 0: {  // right
-      vel[0] = -1.0 + (df[n][0] + df[n][N] + df[n][S] + 2.0 * (df[n][E] +
-          df[n][NE] + df[n][SE])) / rho_node;
-      vel[0] *= c;
-      const auto df_diff = 0.5 * (df[n][S] - df[n][N]);
-      for (auto &u : vel) u *= rho_node;
-      df[n][W] = df[n][E] - 2.0 * beta1_ * vel[0];
-      df[n][NW] = df[n][SE] + df_diff - beta3_ * vel[0];
-      df[n][SW] = df[n][NE] - df_diff - beta3_ * vel[0];
-//      df[n][W] = df[n][E] - 2.0 / 3.0 * vel[0];
-//      df[n][NW] = df[n][SE] + df_diff - vel[0] / 6.0;
-//      df[n][SW] = df[n][NE] - df_diff - vel[0] / 6.0;
+      for (auto k = first; k < last; ++k) {
+        const auto n = nodes[k];
+        auto u_n = -1.0 + (df(n, 0) + df(n, N) + df(n, S) + 2.0 * (df(n, E) +
+            df(n, NE) + df(n, SE))) / rho[k];
+        u_n *= c;
+        const auto df_diff = 0.5 * (df(n, S) - df(n, N));
+        u_n *= rho[k];
+        df(n, W) = df(n, E) - 2.0 * beta1_ * u_n;
+        df(n, NW) = df(n, SE) + df_diff - beta3_ * u_n;
+        df(n, SW) = df(n, NE) - df_diff - beta3_ * u_n;
+      }  // k
       break;
     }
     case 1: {  // top
-      vel[1] = -1.0 + (df[n][0] + df[n][E] + df[n][W] + 2.0 * (df[n][N] +
-          df[n][NE] + df[n][NW])) / rho_node;
-      vel[1] *= c;
-      const auto df_diff = 0.5 * (df[n][E] - df[n][W]);
-      for (auto &u : vel) u *= rho_node;
-      df[n][S] = df[n][N] - 2.0 *beta1_ * vel[1];
-      df[n][SW] = df[n][NE] + df_diff - beta3_ * vel[1];
-      df[n][SE] = df[n][NW] - df_diff - beta3_ * vel[1];
-//      df[n][S] = df[n][N] - 2.0 / 3.0 * vel[1];
-//      df[n][SW] = df[n][NE] + df_diff - vel[1] / 6.0;
-//      df[n][SE] = df[n][NW] - df_diff - vel[1] / 6.0;
+      for (auto k = first; k < last; ++k) {
+        const auto n = nodes[k];
+        auto u_n = -1.0 + (df(n, 0) + df(n, E) + df(n, W) + 2.0 * (df(n, N) +
+            df(n, NE) + df(n, NW))) / rho[k];
+        u_n *= c;
+        const auto df_diff = 0.5 * (df(n, E) - df(n, W));
+        u_n *= rho[k];
+        df(n, S) = df(n, N) - 2.0 * beta1_ * u_n;
+        df(n, SW) = df(n, NE) + df_diff - beta3_ * u_n;
+        df(n, SE) = df(n, NW) - df_diff - beta3_ * u_n;
+      }  // k
       break;
     }
     case 2: {  // left
-      vel[0] = 1.0 - (df[n][0] + df[n][N] + df[n][S] + 2.0 * (df[n][W] +
-          df[n][NW] + df[n][SW])) / rho_node;
-      vel[0] *= c;
-      const auto df_diff = 0.5 * (df[n][S] - df[n][N]);
-      for (auto &u : vel) u *= rho_node;
-      df[n][E] = df[n][W] + 2.0 *beta1_ * vel[0];
-      df[n][NE] = df[n][SW] + df_diff + beta3_ * vel[0];
-      df[n][SE] = df[n][NW] - df_diff + beta3_ * vel[0];
-//      df[n][E] = df[n][W] + 2.0 / 3.0 * vel[0];
-//      df[n][NE] = df[n][SW] + df_diff + vel[0] / 6.0;
-//      df[n][SE] = df[n][NW] - df_diff + vel[0] / 6.0;
+      for (auto k = first; k < last; ++k) {
+        const auto n = nodes[k];
+        auto u_n = 1.0 - (df(n, 0) + df(n, N) + df(n, S) + 2.0 * (df(n, W) +
+            df(n, NW) + df(n, SW))) / rho[k];
+        u_n *= c;
+        const auto df_diff = 0.5 * (df(n, S) - df(n, N));
+        u_n *= rho[k];
+        df(n, E) = df(n, W) + 2.0 * beta1_ * u_n;
+        df(n, NE) = df(n, SW) + df_diff + beta3_ * u_n;
+        df(n, SE) = df(n, NW) - df_diff + beta3_ * u_n;
+      }  // k
       break;
     }
     case 3: {  // bottom
-      vel[1] = 1.0 - (df[n][0] + df[n][E] + df[n][W] + 2.0 * (df[n][S] +
-          df[n][SW] + df[n][SE])) / rho_node;
-      vel[1] *= c;
-      const auto df_diff = 0.5 * (df[n][W] - df[n][E]);
-      for (auto &u : vel) u *= rho_node;
-      df[n][N] = df[n][S] + 2.0 * beta1_ * vel[1];
-      df[n][NE] = df[n][SW] + df_diff + beta3_ * vel[1];
-      df[n][NW] = df[n][SE] - df_diff + beta3_ * vel[1];
-//      df[n][N] = df[n][S] + 2.0 / 3.0 * vel[1];
-//      df[n][NE] = df[n][SW] + df_diff + vel[1] / 6.0;
-//      df[n][NW] = df[n][SE] - df_diff + vel[1] / 6.0;
+      for (auto k = first; k < last; ++k) {
+        const auto n = nodes[k];
+        auto u_n = 1.0 - (df(n, 0) + df(n, E) + df(n, W) + 2.0 * (df(n, S) +
+            df(n, SW) + df(n, SE))) / rho[k];
+        u_n *= c;
+        const auto df_diff = 0.5 * (df(n, W) - df(n, E));
+        u_n *= rho[k];
+        df(n, N) = df(n, S) + 2.0 * beta1_ * u_n;
+        df(n, NE) = df(n, SW) + df_diff + beta3_ * u_n;
+        df(n, NW) = df(n, SE) - df_diff + beta3_ * u_n;
+      }  // k
       break;
     }
     default: {
@@ -130,46 +164,46 @@ void ZouHePressureNodes::UpdateSide(std::vector<std::vector<double>> &df
   }
 }
 
-void ZouHePressureNodes::UpdateCorner(std::vector<std::vector<double>> &df
+void ZouHePressureNodes::UpdateCorner(LatticeField &df
     , ValueNode &node)
 {
   const auto n = node.n;
   const auto rho_node = node.d1;
   switch (node.i1) {
     case 0: {  // bottom-left
-      df[n][E] = df[n][W];
-      df[n][N] = df[n][S];
-      df[n][NE] = df[n][SW];
-      df[n][NW] = 0.5 * (rho_node - df[n][0] - df[n][E] - df[n][N] - df[n][W] -
-          df[n][S] - df[n][NE] - df[n][SW]);
-      df[n][SE] = df[n][NW];
+      df(n, E) = df(n, W);
+      df(n, N) = df(n, S);
+      df(n, NE) = df(n, SW);
+      df(n, NW) = 0.5 * (rho_node - df(n, 0) - df(n, E) - df(n, N) - df(n, W) -
+          df(n, S) - df(n, NE) - df(n, SW));
+      df(n, SE) = df(n, NW);
       break;
     }
     case 1: {  // bottom-right
-      df[n][W] = df[n][E];
-      df[n][N] = df[n][S];
-      df[n][NW] = df[n][SE];
-      df[n][NE] = 0.5 * (rho_node - df[n][0] - df[n][E] - df[n][N] - df[n][W] -
-          df[n][S] - df[n][NW] - df[n][SE]);
-      df[n][SW] = df[n][NE];
+      df(n, W) = df(n, E);
+      df(n, N) = df(n, S);
+      df(n, NW) = df(n, SE);
+      df(n, NE) = 0.5 * (rho_node - df(n, 0) - df(n, E) - df(n, N) - df(n, W) -
+          df(n, S) - df(n, NW) - df(n, SE));
+      df(n, SW) = df(n, NE);
       break;
     }
     case 2: {  // top-left
-      df[n][E] = df[n][W];
-      df[n][S] = df[n][N];
-      df[n][SE] = df[n][NW];
-      df[n][NE] = 0.5 * (rho_node - df[n][0] - df[n][E] - df[n][N] - df[n][W] -
-          df[n][S] - df[n][NW] - df[n][SE]);
-      df[n][SW] = df[n][NE];
+      df(n, E) = df(n, W);
+      df(n, S) = df(n, N);
+      df(n, SE) = df(n, NW);
+      df(n, NE) = 0.5 * (rho_node - df(n, 0) - df(n, E) - df(n, N) - df(n, W) -
+          df(n, S) - df(n, NW) - df(n, SE));
+      df(n, SW) = df(n, NE);
       break;
     }
     case 3: {  // top-right
-      df[n][W] = df[n][E];
-      df[n][S] = df[n][N];
-      df[n][SW] = df[n][NE];
-      df[n][NW] = 0.5 * (rho_node - df[n][0] - df[n][E] - df[n][N] - df[n][W] -
-          df[n][S] - df[n][NE] - df[n][SW]);
-      df[n][SE] = df[n][NW];
+      df(n, W) = df(n, E);
+      df(n, S) = df(n, N);
+      df(n, SW) = df(n, NE);
+      df(n, NW) = 0.5 * (rho_node - df(n, 0) - df(n, E) - df(n, N) - df(n, W) -
+          df(n, S) - df(n, NE) - df(n, SW));
+      df(n, SE) = df(n, NW);
       break;
     }
     default: {
@@ -177,3 +211,18 @@ void ZouHePressureNodes::UpdateCorner(std::vector<std::vector<double>> &df
     }
   }
 }
+
+std::vector<ValueNode> ZouHePressureNodes::GetNodes() const
+{
+  const auto nx = lm_.GetNumberOfColumns();
+  std::vector<ValueNode> nodes;
+  for (auto side = 0u; side < side_nodes_.size(); ++side) {
+    for (auto k = 0u; k < side_nodes_[side].size(); ++k) {
+      const auto n = side_nodes_[side][k];
+      nodes.push_back(ValueNode(n % nx, n / nx, nx, side_rho_[side][k], false,
+          side));
+    }  // k
+  }  // side
+  nodes.insert(end(nodes), begin(corners), end(corners));
+  return nodes;
+}
@@ -8,6 +8,7 @@ int main()
   return Unfit::RunOneSuite("TestFunctionality");
 //  return Unfit::RunOneSuite("TestSteadyState");
 //  return Unfit::RunOneSuite("TestAnalyticalSolutions");
+//  return Unfit::RunOneSuite("TestPerformance");
 //
 //  return Unfit::RunOneTest("AnalyticalDiffusion");
 //  return Unfit::RunOneTest("AnalyticalPoiseuille");
@@ -27,6 +28,7 @@ int main()
 //  return Unfit::RunOneTest("SimulateTaylorVortex");
 //  return Unfit::RunOneTest("SimulateTaylorVortexForce");
 //  return Unfit::RunOneTest("SimulateLidDrivenCavityFlow");
+//  return Unfit::RunOneTest("SimulateLidDrivenCavityFlowKBC");
 //  return Unfit::RunOneTest("SimulateKarmanVortex");
 //  return Unfit::RunOneTest("SimulateParticleMigration");
 //  return Unfit::RunOneTest("SimulateLinearShearFlow");
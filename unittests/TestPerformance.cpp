@@ -0,0 +1,841 @@
+#include <algorithm>  // std::max
+#include <chrono>
+#include <iostream>
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BouncebackNodes.hpp"
+#include "CollisionCD.hpp"
+#include "CollisionKBC.hpp"
+#include "CollisionLES.hpp"
+#include "CollisionModel.hpp"
+#include "CollisionMRT.hpp"
+#include "CollisionNS.hpp"
+#include "CollisionNSF.hpp"
+#include "CollisionTRT.hpp"
+#include "CoupledLatticeBoltzmannEngine.hpp"
+#include "LatticeBoltzmann.hpp"
+#include "LatticeBoltzmannEngine.hpp"
+#include "LatticeBoltzmannEnsemble.hpp"
+#include "LatticeBoltzmannMultiRate.hpp"
+#include "LatticeBoltzmannPipeline.hpp"
+#include "LatticeBoltzmannSpecies.hpp"
+#include "LatticeD2Q5.hpp"
+#include "LatticeD2Q9.hpp"
+#include "LatticeDescriptor.hpp"
+#include "LatticeField.hpp"
+#include "SimdKernels.hpp"
+#include "StreamD2Q9.hpp"
+#include "StreamPeriodic.hpp"
+#include "UnitTest++.h"
+#include "ZouHeNodes.hpp"
+#include "ZouHePressureNodes.hpp"
+
+SUITE(TestPerformance)
+{
+static const auto g_dx = 0.0316;
+static const auto g_dt = 0.001;
+static const auto g_k_visco = 0.2;
+static const auto g_d_coeff = 0.2;
+static const auto g_rho0 = 1.0;
+
+// million lattice updates per second of repeated calls of step, each of which
+// updates num_nodes nodes
+template <typename Step>
+double MeasureMlups(std::size_t num_nodes
+  , int time_steps
+  , Step step)
+{
+  step();
+  const auto start = std::chrono::steady_clock::now();
+  for (auto t = 0; t < time_steps; ++t) step();
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return static_cast<double>(num_nodes) * time_steps / elapsed.count() / 1e6;
+}
+
+TEST(BenchmarkCollisionSimd)
+{
+  std::size_t ny = 256;
+  std::size_t nx = 256;
+  auto time_steps = 20;
+  std::vector<double> u0 = {0.01, 0.02};
+  std::vector<std::vector<std::size_t>> src_pos = {{nx / 2, ny / 2}};
+  std::vector<std::vector<double>> src_str_f = {{1.0, 0.0}};
+  std::vector<double> src_str_g = {1.0};
+  LatticeD2Q9 lm(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  CollisionNS ns(lm
+    , g_k_visco
+    , g_rho0);
+  CollisionNSF nsf(lm
+    , src_pos
+    , src_str_f
+    , g_k_visco
+    , g_rho0);
+  CollisionCD cd(lm
+    , src_pos
+    , src_str_g
+    , g_d_coeff
+    , g_rho0
+    , false);
+  CollisionTRT trt(lm
+    , src_pos
+    , src_str_f
+    , g_k_visco
+    , 0.25
+    , g_rho0);
+  CollisionMRT mrt(lm
+    , src_pos
+    , src_str_f
+    , g_k_visco
+    , g_rho0);
+  CollisionLES les(lm
+    , src_pos
+    , src_str_f
+    , g_k_visco
+    , 0.17
+    , g_rho0);
+  CollisionKBC kbc(lm
+    , src_pos
+    , src_str_f
+    , g_k_visco
+    , g_rho0);
+  std::vector<CollisionModel*> models = {&ns, &nsf, &cd, &trt, &mrt, &les,
+      &kbc};
+  std::vector<std::string> names = {"NS", "NSF", "CD", "TRT", "MRT", "LES",
+      "KBC"};
+  const auto level = GetSimdLevel();
+  for (auto simd : {SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Avx512}) {
+    if (simd > GetSupportedSimdLevel()) continue;
+    SetSimdLevel(simd);
+    for (auto m = 0u; m < models.size(); ++m) {
+      auto df = models[m]->ComputeEqField();
+      const auto mlups = MeasureMlups(nx * ny, time_steps, [&]() {
+        models[m]->Collide(df);
+      });
+      std::cout << "Collide " << names[m] << " " << GetSimdLevelName(simd)
+                << ": " << mlups << " MLUPS" << std::endl;
+      CHECK(mlups > 0.0);
+    }  // m
+  }  // simd
+  SetSimdLevel(level);
+}
+
+TEST(BenchmarkCollisionLES)
+{
+  std::size_t ny = 256;
+  std::size_t nx = 256;
+  auto time_steps = 10;
+  std::vector<double> u0 = {0.01, 0.02};
+  std::vector<std::vector<std::size_t>> src_pos = {{nx / 2, ny / 2}};
+  std::vector<std::vector<double>> src_str_f = {{1.0, 0.0}};
+  LatticeD2Q9 lm(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  CollisionNSF nsf(lm
+    , src_pos
+    , src_str_f
+    , g_k_visco
+    , g_rho0);
+  CollisionLES les(lm
+    , src_pos
+    , src_str_f
+    , g_k_visco
+    , 0.17
+    , g_rho0);
+  StreamPeriodic sp(lm);
+  LatticeBoltzmann f_nsf(lm
+    , nsf
+    , sp);
+  LatticeBoltzmann f_les(lm
+    , les
+    , sp);
+  f_nsf.ToggleFusedKernel();
+  f_les.ToggleFusedKernel();
+  const auto mlups = MeasureMlups(nx * ny, time_steps, [&]() {
+    f_nsf.TakeStep();
+  });
+  const auto mlups_les = MeasureMlups(nx * ny, time_steps, [&]() {
+    f_les.TakeStep();
+  });
+  std::cout << "TakeStep fused BGK: " << mlups << " MLUPS, LES: " << mlups_les
+            << " MLUPS" << std::endl;
+  CHECK(mlups > 0.0);
+  CHECK(mlups_les > 0.0);
+}
+
+TEST(BenchmarkTakeStepThreads)
+{
+  std::size_t ny = 256;
+  std::size_t nx = 256;
+  auto time_steps = 10;
+  std::vector<double> u0 = {0.01, 0.02};
+  const auto max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  for (auto num_threads = 1u; num_threads <= max_threads; num_threads *= 2) {
+    LatticeD2Q9 lm(ny
+      , nx
+      , g_dx
+      , g_dt
+      , u0);
+    CollisionNS ns(lm
+      , g_k_visco
+      , g_rho0);
+    StreamPeriodic sp(lm);
+    LatticeBoltzmann f(lm
+      , ns
+      , sp
+      , num_threads);
+    for (auto is_fused : {false, true}) {
+      const auto mlups = MeasureMlups(nx * ny, time_steps, [&]() {
+        f.TakeStep();
+      });
+      std::cout << "TakeStep " << (is_fused ? "fused " : "") << num_threads
+                << " threads: " << mlups << " MLUPS" << std::endl;
+      CHECK(mlups > 0.0);
+      f.ToggleFusedKernel();
+    }  // is_fused
+  }  // num_threads
+}
+
+TEST(BenchmarkAdvanceTemporalBlocking)
+{
+  // channel with walls, large enough that the lattice does not fit in the
+  // private caches
+  std::size_t ny = 512;
+  std::size_t nx = 2048;
+  auto time_steps = 8;
+  std::vector<double> u0 = {0.01, 0.0};
+  LatticeD2Q9 lm(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  CollisionNS ns(lm
+    , g_k_visco
+    , g_rho0);
+  StreamD2Q9 sd(lm);
+  BouncebackNodes hwbb(lm
+    , &sd);
+  for (auto x = 0u; x < nx; ++x) {
+    hwbb.AddNode(x, 0);
+    hwbb.AddNode(x, ny - 1);
+  }  // x
+  LatticeBoltzmann f(lm
+    , ns
+    , sd);
+  f.AddBoundaryNodes(&hwbb);
+  f.ToggleFusedKernel();
+  for (auto depth : {1u, 4u, 8u}) {
+    f.SetTemporalBlocking(depth, 0);
+    const auto mlups = MeasureMlups(nx * ny, 1, [&]() {
+      f.Advance(time_steps);
+    }) * time_steps;
+    std::cout << "Advance depth " << depth << ": " << mlups << " MLUPS"
+              << std::endl;
+    CHECK(mlups > 0.0);
+  }  // depth
+}
+
+TEST(BenchmarkSparseLattice)
+{
+  // porous medium, square obstacles cover three quarters of the lattice
+  std::size_t ny = 512;
+  std::size_t nx = 512;
+  std::size_t pore = 4;
+  std::size_t grain = 28;
+  auto time_steps = 10;
+  std::vector<double> u0 = {0.01, 0.0};
+  LatticeD2Q9 lm(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  CollisionNS ns(lm
+    , g_k_visco
+    , g_rho0);
+  StreamPeriodic sp(lm);
+  BouncebackNodes fwbb(lm
+    , &ns);
+  for (auto y = 0u; y < ny; ++y) {
+    for (auto x = 0u; x < nx; ++x) {
+      if (x % (pore + grain) >= pore && y % (pore + grain) >= pore) {
+        fwbb.AddNode(x, y);
+      }
+    }  // x
+  }  // y
+  LatticeBoltzmann f(lm
+    , ns
+    , sp);
+  f.AddBoundaryNodes(&fwbb);
+  f.ToggleFusedKernel();
+  for (auto is_sparse : {false, true}) {
+    if (is_sparse) f.ToggleSparseLattice();
+    const auto mlups = MeasureMlups(nx * ny, time_steps, [&]() {
+      f.TakeStep();
+    });
+    std::cout << "TakeStep fused " << (is_sparse ? "sparse" : "dense")
+              << ": " << mlups << " MLUPS of the whole lattice" << std::endl;
+    CHECK(mlups > 0.0);
+  }  // is_sparse
+}
+
+TEST(BenchmarkSparseSource)
+{
+  // a single point force and a single instantaneous point source, e.g., a
+  // stirrer and an injected dye
+  std::size_t ny = 512;
+  std::size_t nx = 512;
+  auto time_steps = 10;
+  std::vector<double> u0 = {0.01, 0.02};
+  std::vector<std::vector<std::size_t>> src_pos = {{nx / 2, ny / 2}};
+  std::vector<std::vector<double>> src_str_f = {{1.0, 0.0}};
+  std::vector<double> src_str_g = {1.0};
+  LatticeD2Q9 lm(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  CollisionNSF nsf(lm
+    , src_pos
+    , src_str_f
+    , g_k_visco
+    , g_rho0);
+  CollisionCD cd(lm
+    , src_pos
+    , src_str_g
+    , g_d_coeff
+    , g_rho0
+    , true);
+  StreamPeriodic sp(lm);
+  LatticeBoltzmann f(lm
+    , nsf
+    , sp);
+  LatticeBoltzmann g(lm
+    , cd
+    , sp);
+  for (auto is_fused : {false, true}) {
+    if (is_fused) {
+      f.ToggleFusedKernel();
+      g.ToggleFusedKernel();
+    }
+    for (auto is_sparse : {false, true}) {
+      if (is_sparse) {
+        nsf.ToggleSparseSource();
+        cd.ToggleSparseSource();
+      }
+      const auto mlups = MeasureMlups(nx * ny, time_steps, [&]() {
+        f.TakeStep();
+        g.TakeStep();
+      });
+      std::cout << "TakeStep NSF and CD " << (is_fused ? "fused " : "")
+                << (is_sparse ? "sparse" : "dense") << " source: " << mlups
+                << " MLUPS" << std::endl;
+      CHECK(mlups > 0.0);
+      if (is_sparse) {
+        nsf.ToggleSparseSource();
+        cd.ToggleSparseSource();
+      }
+    }  // is_sparse
+  }  // is_fused
+}
+
+TEST(BenchmarkCollisionCDD2Q5)
+{
+  std::size_t ny = 512;
+  std::size_t nx = 512;
+  auto time_steps = 10;
+  std::vector<double> u0 = {0.01, 0.02};
+  std::vector<std::vector<std::size_t>> src_pos = {{nx / 2, ny / 2}};
+  std::vector<double> src_str_g = {1.0};
+  LatticeD2Q9 lm(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  LatticeD2Q5 lm_d2q5(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  CollisionCD cd(lm
+    , src_pos
+    , src_str_g
+    , g_d_coeff
+    , g_rho0
+    , false);
+  CollisionCD cd_d2q5(lm_d2q5
+    , lm
+    , src_pos
+    , src_str_g
+    , g_d_coeff
+    , g_rho0
+    , false);
+  StreamPeriodic sp(lm);
+  StreamPeriodic sp_d2q5(lm_d2q5);
+  LatticeBoltzmann g(lm
+    , cd
+    , sp);
+  LatticeBoltzmann g_d2q5(lm_d2q5
+    , cd_d2q5
+    , sp_d2q5);
+  for (auto is_fused : {false, true}) {
+    if (is_fused) {
+      g.ToggleFusedKernel();
+      g_d2q5.ToggleFusedKernel();
+    }
+    const auto mlups = MeasureMlups(nx * ny, time_steps, [&]() {
+      g.TakeStep();
+    });
+    const auto mlups_d2q5 = MeasureMlups(nx * ny, time_steps, [&]() {
+      g_d2q5.TakeStep();
+    });
+    std::cout << "TakeStep CD " << (is_fused ? "fused " : "") << "D2Q9: "
+              << mlups << " MLUPS, D2Q5: " << mlups_d2q5 << " MLUPS"
+              << std::endl;
+    CHECK(mlups > 0.0);
+    CHECK(mlups_d2q5 > 0.0);
+  }  // is_fused
+}
+
+TEST(BenchmarkFrozenFlow)
+{
+  std::size_t ny = 512;
+  std::size_t nx = 512;
+  auto time_steps = 10;
+  std::vector<double> u0 = {0.01, 0.02};
+  std::vector<std::vector<std::size_t>> src_pos = {{nx / 2, ny / 2}};
+  std::vector<double> src_str_g = {1.0};
+  LatticeD2Q9 lm(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  CollisionNS ns(lm
+    , g_k_visco
+    , g_rho0);
+  CollisionCD cd(lm
+    , src_pos
+    , src_str_g
+    , g_d_coeff
+    , g_rho0
+    , false);
+  StreamPeriodic sp(lm);
+  LatticeBoltzmann f(lm
+    , ns
+    , sp);
+  LatticeBoltzmann g(lm
+    , cd
+    , sp);
+  for (auto is_fused : {false, true}) {
+    if (is_fused) {
+      f.ToggleFusedKernel();
+      g.ToggleFusedKernel();
+    }
+    const auto mlups_coupled = MeasureMlups(nx * ny, time_steps, [&]() {
+      f.TakeStep();
+      g.TakeStep();
+    });
+    cd.ToggleFrozenFlow();
+    const auto mlups_frozen = MeasureMlups(nx * ny, time_steps, [&]() {
+      g.TakeStep();
+    });
+    cd.ToggleFrozenFlow();
+    std::cout << "TakeStep NS and CD " << (is_fused ? "fused: " : ": ")
+              << mlups_coupled << " MLUPS, CD with frozen flow: "
+              << mlups_frozen << " MLUPS" << std::endl;
+    CHECK(mlups_coupled > 0.0);
+    CHECK(mlups_frozen > 0.0);
+  }  // is_fused
+}
+
+TEST(BenchmarkStaticEngine)
+{
+  std::size_t ny = 256;
+  std::size_t nx = 256;
+  auto time_steps = 10;
+  std::vector<double> u0 = {0.01, 0.0};
+  LatticeD2Q9 lm(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  CollisionNS ns(lm
+    , g_k_visco
+    , g_rho0);
+  StreamD2Q9 sd(lm);
+  BouncebackNodes hwbb(lm
+    , &sd);
+  for (auto x = 0u; x < nx; ++x) {
+    hwbb.AddNode(x, 0);
+    hwbb.AddNode(x, ny - 1);
+  }  // x
+  LatticeBoltzmann f(lm
+    , ns
+    , sd);
+  f.AddBoundaryNodes(&hwbb);
+  f.ToggleFusedKernel();
+  LatticeBoltzmannEngine<D2Q9, CollisionNS, StreamD2Q9, BouncebackNodes>
+      f_static(lm
+    , ns
+    , sd
+    , hwbb);
+  const auto mlups = MeasureMlups(nx * ny, time_steps, [&]() {
+    f.TakeStep();
+  });
+  const auto mlups_static = MeasureMlups(nx * ny, time_steps, [&]() {
+    f_static.TakeStep();
+  });
+  std::cout << "TakeStep fused virtual: " << mlups << " MLUPS, static: "
+            << mlups_static << " MLUPS" << std::endl;
+  CHECK(mlups > 0.0);
+  CHECK(mlups_static > 0.0);
+}
+
+TEST(BenchmarkCoupledEngine)
+{
+  std::size_t ny = 256;
+  std::size_t nx = 256;
+  auto time_steps = 10;
+  std::vector<double> u0 = {0.01, 0.0};
+  std::vector<std::vector<std::size_t>> src_pos = {{nx / 2, ny / 2}};
+  std::vector<std::vector<double>> src_str_f = {{1.0, 0.0}};
+  std::vector<double> src_str_g = {1.0};
+  LatticeD2Q9 lm(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  CollisionNSF nsf(lm
+    , src_pos
+    , src_str_f
+    , g_k_visco
+    , g_rho0);
+  CollisionCD cd(lm
+    , src_pos
+    , src_str_g
+    , g_d_coeff
+    , g_rho0
+    , false);
+  StreamPeriodic sp(lm);
+  LatticeBoltzmannEngine<D2Q9, CollisionNSF, StreamPeriodic> f(lm
+    , nsf
+    , sp);
+  LatticeBoltzmannEngine<D2Q9, CollisionCD, StreamPeriodic> g(lm
+    , cd
+    , sp);
+  CoupledLatticeBoltzmannEngine<decltype(f), decltype(g)> fg(f
+    , g);
+  const auto mlups = MeasureMlups(nx * ny, time_steps, [&]() {
+    f.TakeStep();
+    g.TakeStep();
+  });
+  const auto mlups_coupled = MeasureMlups(nx * ny, time_steps, [&]() {
+    fg.TakeStep();
+  });
+  std::cout << "TakeStep NS and CD sequential: " << mlups << " MLUPS, "
+            << "coupled: " << mlups_coupled << " MLUPS" << std::endl;
+  CHECK(mlups > 0.0);
+  CHECK(mlups_coupled > 0.0);
+}
+
+TEST(BenchmarkEnsemble)
+{
+  std::size_t ny = 64;
+  std::size_t nx = 64;
+  auto num_members = 8u;
+  auto time_steps = 10;
+  std::vector<double> u0 = {0.01, 0.0};
+  // a viscosity sweep, each member is an ordinary lattice
+  std::list<LatticeD2Q9> lms;
+  std::list<CollisionNS> nss;
+  std::list<StreamPeriodic> sps;
+  std::list<LatticeBoltzmann> fs;
+  LatticeBoltzmannEnsemble ensemble;
+  for (auto k = 0u; k < num_members; ++k) {
+    lms.emplace_back(ny, nx, g_dx, g_dt, u0);
+    nss.emplace_back(lms.back(), g_k_visco * (1.0 + 0.1 * k), g_rho0);
+    sps.emplace_back(lms.back());
+    fs.emplace_back(lms.back(), nss.back(), sps.back());
+    fs.back().ToggleFusedKernel();
+    ensemble.AddMember(fs.back(), nss.back());
+  }  // k
+  const auto mlups = MeasureMlups(num_members * nx * ny, time_steps, [&]() {
+    for (auto &f : fs) f.TakeStep();
+  });
+  const auto mlups_ensemble = MeasureMlups(num_members * nx * ny, time_steps,
+      [&]() {
+    ensemble.TakeStep();
+  });
+  std::cout << "TakeStep " << num_members << " members one by one: " << mlups
+            << " MLUPS, ensemble: " << mlups_ensemble << " MLUPS" << std::endl;
+  CHECK(mlups > 0.0);
+  CHECK(mlups_ensemble > 0.0);
+}
+
+TEST(BenchmarkMultiRate)
+{
+  std::size_t ny = 256;
+  std::size_t nx = 256;
+  auto scalar_rate = 4;
+  auto time_steps = 4 * scalar_rate;
+  std::vector<double> u0 = {0.01, 0.02};
+  std::vector<std::vector<std::size_t>> src_pos = {{nx / 2, ny / 2}};
+  std::vector<double> src_str_g = {1.0};
+  // a slow solute takes one step per scalar_rate steps of the flow
+  LatticeD2Q9 lm_f(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  LatticeD2Q9 lm_g(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  LatticeD2Q9 lm_slow(ny
+    , nx
+    , g_dx
+    , scalar_rate * g_dt
+    , u0);
+  CollisionNS ns(lm_f
+    , g_k_visco
+    , g_rho0);
+  CollisionCD cd(lm_g
+    , lm_f
+    , src_pos
+    , src_str_g
+    , g_d_coeff
+    , g_rho0
+    , false);
+  CollisionCD cd_slow(lm_slow
+    , src_pos
+    , src_str_g
+    , g_d_coeff
+    , g_rho0
+    , false);
+  StreamPeriodic sp_f(lm_f);
+  StreamPeriodic sp_g(lm_g);
+  StreamPeriodic sp_slow(lm_slow);
+  LatticeBoltzmann f(lm_f
+    , ns
+    , sp_f);
+  LatticeBoltzmann g(lm_g
+    , cd
+    , sp_g);
+  LatticeBoltzmann g_slow(lm_slow
+    , cd_slow
+    , sp_slow);
+  f.ToggleFusedKernel();
+  g.ToggleFusedKernel();
+  g_slow.ToggleFusedKernel();
+  LatticeBoltzmannMultiRate fg(f
+    , g_slow);
+  const auto mlups = MeasureMlups(nx * ny, time_steps, [&]() {
+    f.TakeStep();
+    g.TakeStep();
+  });
+  const auto mlups_multi_rate = MeasureMlups(nx * ny, time_steps /
+      scalar_rate, [&]() {
+    fg.TakeStep();
+  }) * scalar_rate;
+  std::cout << "TakeStep NS and CD same rate: " << mlups << " MLUPS, CD "
+            << scalar_rate << " times slower: " << mlups_multi_rate
+            << " MLUPS" << std::endl;
+  CHECK(mlups > 0.0);
+  CHECK(mlups_multi_rate > 0.0);
+}
+
+TEST(BenchmarkPipeline)
+{
+  std::size_t ny = 256;
+  std::size_t nx = 256;
+  auto time_steps = 10;
+  std::vector<double> u0 = {0.01, 0.02};
+  std::vector<std::vector<std::size_t>> src_pos = {{nx / 2, ny / 2}};
+  std::vector<std::vector<double>> src_str_f = {{1.0, 0.0}};
+  std::vector<double> src_str_g = {1.0};
+  LatticeD2Q9 lm_f(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  LatticeD2Q9 lm_g(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  CollisionNSF nsf(lm_f
+    , src_pos
+    , src_str_f
+    , g_k_visco
+    , g_rho0);
+  CollisionCD cd(lm_g
+    , src_pos
+    , src_str_g
+    , g_d_coeff
+    , g_rho0
+    , false);
+  StreamPeriodic sp(lm_f);
+  LatticeBoltzmann f(lm_f
+    , nsf
+    , sp);
+  LatticeBoltzmann g(lm_g
+    , cd
+    , sp);
+  f.ToggleFusedKernel();
+  g.ToggleFusedKernel();
+  LatticeBoltzmannPipeline fg(f
+    , g);
+  const auto mlups = MeasureMlups(nx * ny, time_steps, [&]() {
+    f.TakeStep();
+    g.TakeStep();
+  });
+  const auto mlups_pipelined = MeasureMlups(nx * ny, 1, [&]() {
+    fg.Advance(time_steps);
+  }) * time_steps;
+  std::cout << "TakeStep NS and CD sequential: " << mlups << " MLUPS, "
+            << "pipelined: " << mlups_pipelined << " MLUPS" << std::endl;
+  CHECK(mlups > 0.0);
+  CHECK(mlups_pipelined > 0.0);
+}
+
+TEST(BenchmarkZouHeNodes)
+{
+  // a tall inlet and outlet, only the boundary nodes are updated
+  std::size_t ny = 16384;
+  std::size_t nx = 4;
+  auto time_steps = 100;
+  std::vector<double> u0 = {0.01, 0.0};
+  LatticeD2Q9 lm(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  CollisionNS ns(lm
+    , g_k_visco
+    , g_rho0);
+  StreamPeriodic sp(lm);
+  LatticeBoltzmann f(lm
+    , ns
+    , sp);
+  ZouHeNodes inlet(lm
+    , ns);
+  ZouHePressureNodes outlet(lm
+    , ns);
+  for (auto y = 1u; y < ny - 1; ++y) {
+    inlet.AddNode(0, y, u0[0], u0[1]);
+    outlet.AddNode(nx - 1, y, g_rho0);
+  }  // y
+  const auto mlups_inlet = MeasureMlups(ny - 2, time_steps, [&]() {
+    inlet.UpdateNodes(f.df, false);
+  });
+  const auto mlups_outlet = MeasureMlups(ny - 2, time_steps, [&]() {
+    outlet.UpdateNodes(f.df, false);
+  });
+  // the three unknown values of each node copied from its known values
+  const auto mlups_copy = MeasureMlups(ny - 2, time_steps, [&]() {
+    for (auto y = 1u; y < ny - 1; ++y) {
+      const auto n = y * nx;
+      for (auto i : {1u, 5u, 8u}) f.df(n, i) = f.df(n, i + 2);
+    }  // y
+  });
+  std::cout << "UpdateNodes Zou/He velocity: " << mlups_inlet
+            << " MLUPS, pressure: " << mlups_outlet << " MLUPS, copy: "
+            << mlups_copy << " MLUPS" << std::endl;
+  CHECK(mlups_inlet > 0.0);
+  CHECK(mlups_outlet > 0.0);
+}
+
+TEST(BenchmarkHalfwayBounceback)
+{
+  // a wide channel between half-way bounceback walls, the walls are either
+  // reflected while streaming or saved before and patched after streaming
+  std::size_t ny = 64;
+  std::size_t nx = 4096;
+  auto time_steps = 20;
+  std::vector<double> u0 = {0.01, 0.0};
+  LatticeD2Q9 lm(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  CollisionNS ns(lm
+    , g_k_visco
+    , g_rho0);
+  StreamPeriodic sp(lm
+    , true
+    , false);
+  LatticeBoltzmann f(lm
+    , ns
+    , sp);
+  BouncebackNodes hwbb(lm
+    , &sp);
+  for (auto x = 0u; x < nx; ++x) {
+    hwbb.AddNode(x, 0);
+    hwbb.AddNode(x, ny - 1);
+  }  // x
+  f.AddBoundaryNodes(&hwbb);
+  const auto mlups_links = MeasureMlups(nx * ny, time_steps, [&]() {
+    f.TakeStep();
+  });
+  hwbb.link_wise = false;
+  const auto mlups_nodes = MeasureMlups(nx * ny, time_steps, [&]() {
+    f.TakeStep();
+  });
+  std::cout << "TakeStep half-way bounceback link-wise: " << mlups_links
+            << " MLUPS, before and after streaming: " << mlups_nodes
+            << " MLUPS" << std::endl;
+  CHECK(mlups_links > 0.0);
+  CHECK(mlups_nodes > 0.0);
+}
+
+TEST(BenchmarkSpecies)
+{
+  std::size_t ny = 256;
+  std::size_t nx = 256;
+  auto num_species = 8u;
+  auto time_steps = 10;
+  std::vector<double> u0 = {0.01, 0.02};
+  std::vector<std::vector<std::size_t>> src_pos = {{nx / 2, ny / 2}};
+  // the solutes of one flow field, each species is an ordinary lattice with
+  // its own diffusion coefficient and source
+  LatticeD2Q9 lm_f(ny
+    , nx
+    , g_dx
+    , g_dt
+    , u0);
+  std::list<LatticeD2Q9> lms;
+  std::list<CollisionCD> cds;
+  std::list<StreamPeriodic> sps;
+  std::list<LatticeBoltzmann> gs;
+  LatticeBoltzmannSpecies species;
+  for (auto k = 0u; k < num_species; ++k) {
+    lms.emplace_back(ny, nx, g_dx, g_dt, u0);
+    cds.emplace_back(lms.back(), lm_f, src_pos,
+        std::vector<double>{1.0 + k}, g_d_coeff * (1.0 + 0.1 * k), g_rho0,
+        false);
+    sps.emplace_back(lms.back());
+    gs.emplace_back(lms.back(), cds.back(), sps.back());
+    gs.back().ToggleFusedKernel();
+    species.AddSpecies(gs.back(), cds.back());
+  }  // k
+  const auto mlups = MeasureMlups(num_species * nx * ny, time_steps, [&]() {
+    for (auto &g : gs) g.TakeStep();
+  });
+  const auto mlups_species = MeasureMlups(num_species * nx * ny, time_steps,
+      [&]() {
+    species.TakeStep();
+  });
+  std::cout << "TakeStep " << num_species << " species one by one: " << mlups
+            << " MLUPS, together: " << mlups_species << " MLUPS" << std::endl;
+  CHECK(mlups > 0.0);
+  CHECK(mlups_species > 0.0);
+}
+}